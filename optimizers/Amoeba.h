@@ -20,6 +20,12 @@ namespace optimizers {
  * std::vector<double> of parameter values using the Nelder-Mead
  * algorithm implemented in NR.
  *
+ * With more than one thread, each step evaluates the reflection,
+ * expansion and both contraction points of the worst vertex
+ * concurrently, before deciding which of them to use, and the
+ * vertices of a shrunken simplex are also evaluated concurrently.
+ * The steps taken are those of the serial algorithm.
+ *
  * @author J. Chiang
  *
  * $Header$
@@ -30,8 +36,9 @@ class Amoeba {
 public:
 
    Amoeba(Functor & functor, const std::vector<double> & params,
-          double step=0.1, bool addstep=false) 
-      : m_functor(functor), m_npars(params.size()) {
+          double step=0.1, bool addstep=false)
+      : m_functor(functor), m_npars(params.size()), m_maxEval(5000),
+        m_nthreads(1), m_nevals(0) {
       buildSimplex(params, step, addstep);
    }
 
@@ -43,11 +50,38 @@ public:
    double findMin(std::vector<double> & params, double tol=1e-2,
                   bool abstol=true);
 
+   /// findMin throws std::runtime_error once the functor has been
+   /// evaluated this many times without converging.
+   void setMaxEval(int maxEval) {m_maxEval = maxEval;}
+   int maxEval() const {return m_maxEval;}
+
+   /// Number of threads used to evaluate the functor.  The default
+   /// of one runs the serial algorithm; zero means one per hardware
+   /// core.  More than one thread requires Functor::clone.
+   void setThreads(unsigned int nthreads) {m_nthreads = nthreads;}
+   unsigned int threads() const {return m_nthreads;}
+
+   /// Number of functor evaluations made by the last findMin.
+   int numEvals() const {return m_nevals;}
+
+   /// @return The lowest functor value among the simplex vertices,
+   /// e.g., after findMin has thrown.
+   /// @param params The parameter values of that vertex.
+   double bestVertex(std::vector<double> & params) const;
+
 private:
 
    Functor & m_functor;
    size_t m_npars;
-   std::vector< std::vector<double> > m_simplex;
+   int m_maxEval;
+   unsigned int m_nthreads;
+   int m_nevals;
+
+   /// The m_npars + 1 vertices, stored one after another.
+   std::vector<double> m_simplex;
+
+   /// The functor values at the vertices, once findMin has run.
+   std::vector<double> m_values;
 
    /// @param params An ndim vector of parameter values as a candidate
    /// starting point for the minimization.
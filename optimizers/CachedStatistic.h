@@ -0,0 +1,136 @@
+/** 
+ * @file CachedStatistic.h
+ * @brief Declaration of a memoizing Statistic decorator
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#ifndef optimizers_CachedStatistic_h
+#define optimizers_CachedStatistic_h
+
+#include <vector>
+
+#include "optimizers/StatisticDecorator.h"
+
+namespace optimizers {
+
+/** 
+ * @class CachedStatistic
+ *
+ * @brief Wraps a Statistic and remembers its value and free
+ * derivatives at the most recently evaluated points, so that drivers
+ * which return to a point they have just visited (e.g., to restore
+ * the parameters after a finite-difference step) do not re-evaluate
+ * the Statistic there.
+ *
+ * Points are identified by an exact, bitwise match of all of the
+ * Parameter values of the innermost wrapped Statistic, together with
+ * which of them are free.  The cache keeps the last nentries points
+ * and is cleared whenever Parameters are changed through setParam or
+ * setParams.  Parameter values are read
+ * from and written to the wrapped Statistic.
+ *
+ */
+
+class CachedStatistic : public StatisticDecorator {
+
+public:
+
+   CachedStatistic(Statistic & stat, unsigned int nentries=4);
+
+   /// Copies own a clone of the wrapped Statistic and start with an
+   /// empty cache, so that they may be evaluated independently.
+   CachedStatistic(const CachedStatistic & rhs);
+
+   virtual double value() const;
+
+   virtual void getFreeDerivs(std::vector<double> & derivs) const;
+
+   virtual void getFreeDerivs(const Arg &, std::vector<double> & derivs) const {
+      getFreeDerivs(derivs);
+   }
+
+   virtual void valueAndFreeDerivs(const std::vector<double> & x,
+                                   double & f, std::vector<double> & g);
+
+   virtual Function * clone() const {
+      return new CachedStatistic(*this);
+   }
+
+   /// The number of points remembered.
+   unsigned int nentries() const {
+      return m_nentries;
+   }
+
+   /// Number of requests for a value or derivatives answered from
+   /// the cache.
+   unsigned long hits() const {
+      return m_hits;
+   }
+
+   /// Number of requests passed on to the wrapped Statistic.
+   unsigned long misses() const {
+      return m_misses;
+   }
+
+   void resetCounters() {
+      m_hits = 0;
+      m_misses = 0;
+   }
+
+   /// Forget all of the cached points.
+   void clear() {
+      m_entries.clear();
+   }
+
+protected:
+
+   /// Clears the cache, as well as refreshing the Parameters.
+   virtual void paramsChanged();
+
+   virtual double value(const Arg &) const {
+      return value();
+   }
+
+   virtual double fetchValueAndDerivs(const Arg & x, 
+                                      std::vector<double> & derivs,
+                                      bool getFree) const;
+
+private:
+
+   struct Entry {
+      std::vector<double> key;
+      bool hasValue;
+      double value;
+      bool hasDerivs;
+      std::vector<double> derivs;
+   };
+
+   unsigned int m_nentries;
+
+   /// Cached points, most recently used first.
+   mutable std::vector<Entry> m_entries;
+
+   /// Parameter values at the current point.
+   mutable std::vector<double> m_key;
+
+   mutable unsigned long m_hits;
+   mutable unsigned long m_misses;
+
+   /// Return the entry for the current point, moved to the front, or
+   /// zero if it is not cached.
+   Entry * find() const;
+
+   /// Add an empty entry for the current point at the front, evicting
+   /// the least recently used one if the cache is full.  Call only
+   /// after find() has failed.
+   Entry * insert() const;
+
+   double cachedValueAndFreeDerivs(std::vector<double> & derivs) const;
+
+};
+
+} // namespace optimizers
+
+#endif // optimizers_CachedStatistic_h
@@ -42,10 +42,21 @@ public:
    */
    ChiSq(const DataCont_t & domain, const DataCont_t & range, optimizers::Function * func);
 
+   /**
+    * @brief Copies share the data but own a clone of the function, so that copies may be
+    *        evaluated independently (e.g., in separate threads).
+   */
+   ChiSq(const ChiSq & rhs);
+
+   virtual ~ChiSq();
+
    virtual double value() const;
 
    virtual void getFreeDerivs(std::vector<double> & derivs) const;
 
+   virtual void valueAndFreeDerivs(const std::vector<double> & x, double & f,
+                                   std::vector<double> & g);
+
    virtual std::vector<double>::const_iterator setFreeParamValues_(std::vector<double>::const_iterator it);
 
    virtual optimizers::Function * clone() const;
@@ -62,11 +73,24 @@ protected:
    virtual void getFreeDerivs(const optimizers::Arg &, std::vector<double> & derivs) const;
 
 private:
+   /// Compute the derivatives wrt the free parameters given the model values at the data points.
+   void accumulateFreeDerivs(const DataCont_t & model, std::vector<double> & derivs) const;
+
    const DataCont_t * m_domain;
    const DataCont_t * m_range;
    optimizers::Function * m_func;
+   bool m_own_func;
    unsigned long m_dof;
 
+   // Scratch space for the model values and derivatives at the data points, reused across
+   // evaluations so that they do not allocate.
+   mutable DataCont_t m_model;
+   mutable DataCont_t m_funcDerivs;
+   mutable DataCont_t m_deviationPart;
+
+   // Disable assignment.
+   ChiSq & operator =(const ChiSq &);
+
 };
 
 } // namespace optimizers
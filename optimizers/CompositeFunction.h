@@ -76,6 +76,10 @@ protected:
    /// method to sync the m_parameter vector with those of the two Functions
    void syncParams();
 
+   /// Scratch space for the derivatives of m_b, reused across calls
+   /// so that evaluations do not allocate.
+   mutable std::vector<double> m_derivs;
+
 private:
 
    /// disable this since Parameters may no longer have unique names
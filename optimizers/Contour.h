@@ -0,0 +1,48 @@
+/**
+ * @file Contour.h
+ * @brief The points of a MINOS confidence contour for a pair of
+ * parameters.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#ifndef optimizers_Contour_h
+#define optimizers_Contour_h
+
+#include <utility>
+#include <vector>
+
+namespace optimizers {
+
+/**
+ * @class Contour
+ *
+ * @brief The (x, y) = (par1, par2) points on the contour where the
+ * profile log-likelihood is level/2 below its maximum, in order
+ * around the contour.
+ *
+ * $Header$
+ */
+
+class Contour {
+
+public:
+
+   Contour(unsigned int par1_=0, unsigned int par2_=0, double level_=1.)
+      : par1(par1_), par2(par2_), level(level_) {}
+
+   /// Free parameter numbers for the x and y coordinates.
+   unsigned int par1;
+   unsigned int par2;
+
+   /// Change in 2*log-likelihood, as for Optimizer::Minos.
+   double level;
+
+   std::vector< std::pair<double, double> > points;
+
+};
+
+} // namespace optimizers
+
+#endif // optimizers_Contour_h
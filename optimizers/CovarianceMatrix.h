@@ -0,0 +1,87 @@
+/**
+ * @file CovarianceMatrix.h
+ * @brief Covariance matrix of the free parameters of a fit, stored
+ * contiguously.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#ifndef optimizers_CovarianceMatrix_h
+#define optimizers_CovarianceMatrix_h
+
+#include <vector>
+
+namespace optimizers {
+
+/**
+ * @class CovarianceMatrix
+ *
+ * @brief A symmetric npars x npars matrix, stored row by row in a
+ * single array, e.g., for passing to numpy or to BLAS without
+ * copying.
+ *
+ * $Header$
+ */
+
+class CovarianceMatrix {
+
+public:
+
+   CovarianceMatrix() : m_npars(0) {}
+
+   explicit CovarianceMatrix(size_t npars)
+      : m_npars(npars), m_elements(npars*npars, 0) {}
+
+   /// From the rows of a square matrix, as returned by
+   /// Optimizer::covarianceMatrix.
+   explicit CovarianceMatrix(const std::vector< std::vector<double> > & rows);
+
+   /// From the packed upper triangle, by columns, as produced by
+   /// dpptri: element (i, j), i <= j, is packed[i + j*(j+1)/2].
+   void setPacked(size_t npars, const std::vector<double> & packed);
+
+   size_t size() const {
+      return m_npars;
+   }
+
+   bool empty() const {
+      return m_npars == 0;
+   }
+
+   double operator()(size_t i, size_t j) const {
+      return m_elements[i*m_npars + j];
+   }
+
+   double & operator()(size_t i, size_t j) {
+      return m_elements[i*m_npars + j];
+   }
+
+   /// The npars*npars elements, row by row.
+   const double * data() const {
+      return m_elements.empty() ? 0 : &m_elements[0];
+   }
+
+   const double * row(size_t i) const {
+      return data() + i*m_npars;
+   }
+
+   /// Square root of diagonal element i.
+   double uncertainty(size_t i) const;
+
+   /// Element (i, j) over the product of uncertainties i and j.
+   double correlation(size_t i, size_t j) const;
+
+   /// The rows as separate vectors.
+   std::vector< std::vector<double> > rows() const;
+
+private:
+
+   size_t m_npars;
+   std::vector<double> m_elements;
+
+};
+
+} // namespace optimizers
+
+#endif // optimizers_CovarianceMatrix_h
@@ -0,0 +1,81 @@
+/**
+ * @file FitsSampleSink.h
+ * @brief Declaration for a SampleSink that streams to a FITS binary
+ * table.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#ifndef optimizers_FitsSampleSink_h
+#define optimizers_FitsSampleSink_h
+
+#include <string>
+#include <vector>
+
+#include "optimizers/SampleSink.h"
+
+namespace optimizers {
+
+/**
+ * @class FitsSampleSink
+ * @brief Writes samples to a FITS binary table, one column per
+ * entry in columnNames.  Samples are buffered and written out in
+ * blocks of blockSize rows, so memory use is bounded independently
+ * of the length of the chain.  Columns are single precision unless
+ * doublePrecision is set.
+ *
+ * $Header$
+ */
+
+class FitsSampleSink : public SampleSink {
+
+public:
+
+   FitsSampleSink(const std::string & filename,
+                  const std::vector<std::string> & columnNames,
+                  bool doublePrecision=false,
+                  unsigned long blockSize=10000);
+
+   /// Flushes any buffered samples and closes the file.  Errors are
+   /// reported on stderr; call close() to have them thrown instead.
+   virtual ~FitsSampleSink();
+
+   virtual void write(const std::vector<double> & sample);
+
+   virtual void flush();
+
+   /// Flush the remaining samples and close the file.
+   void close();
+
+   /// Number of rows written to the file so far.
+   unsigned long nrows() const {
+      return m_nrows;
+   }
+
+private:
+
+   void * m_fptr;
+
+   size_t m_ncols;
+
+   bool m_doublePrecision;
+
+   unsigned long m_blockSize;
+
+   unsigned long m_nrows;
+
+   /// Buffered rows, stored row by row.
+   std::vector<double> m_buffer;
+
+   void checkStatus(int status) const;
+
+   // Disable copying, since the sink owns the open file.
+   FitsSampleSink(const FitsSampleSink &);
+   FitsSampleSink & operator=(const FitsSampleSink &);
+
+};
+
+} // namespace optimizers
+
+#endif // optimizers_FitsSampleSink_h
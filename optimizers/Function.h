@@ -35,6 +35,11 @@ class Arg;
  *
  * This class uses the Parameter and Arg classes.
  *
+ * Subclasses may keep scratch buffers that their const evaluation
+ * methods write to, so one instance must not be evaluated from
+ * several threads at once, even through const methods.  Give each
+ * thread its own clone(), as the parallel optimizers do.
+ *
  * @authors J. Chiang, P. Nolan
  *
  */
@@ -71,6 +76,23 @@ public:
    double derivByParam(const Arg & xarg,
                        const std::string & paramName) const;
 
+   /// Function derivative wrt the Parameter at position paramIndex
+   /// in the full Parameter list.  Uses template method so
+   /// non-virtual.
+   double derivByParamIndex(const Arg & xarg, unsigned int paramIndex) const;
+
+   /// Evaluate a Function of dArg at the n points x[0..n-1], writing
+   /// the results to out[0..n-1].  Uses template method so
+   /// non-virtual.
+   void values(const double * x, double * out, size_t n) const;
+
+   /// Evaluate the derivatives of a Function of dArg wrt the free
+   /// (getFree=true) or all Parameters at the n points x[0..n-1].
+   /// Results are stored one Parameter at a time: the derivative
+   /// wrt the j-th Parameter at x[i] is out[j*n + i].
+   void derivs(const double * x, double * out, size_t n,
+               bool getFree=true) const;
+
    void setScalingFunction(const Function & scalingFunction);
 
    const Function * scalingFunction() const;
@@ -99,6 +121,11 @@ public:
    /// @return non-const reference to named Parameter.
    virtual Parameter & parameter(const std::string & name);
 
+   /// @return Position of the named Parameter in the full Parameter
+   /// list.  Resolve this once and use the index-based accessors
+   /// to avoid repeated name comparisons.
+   unsigned int parameterIndex(const std::string & paramName) const;
+
    /// @return The parameter controlling the overall normalization.
    virtual Parameter & normPar();
    
@@ -134,6 +161,12 @@ public:
       params = m_parameter;
    }
 
+   /// Read-only view of the Parameter objects, which avoids the
+   /// copies made by getParams.
+   const std::vector<Parameter> & parameters() const {
+      return m_parameter;
+   }
+
    /// Return the number of free Parameters.
    virtual unsigned int getNumFreeParams() const;
 
@@ -169,6 +202,19 @@ public:
       fetchDerivs(x, derivs, true);
    }
 
+   /// Get the Function value and all of the derivatives in one call.
+   double getValueAndDerivs(const Arg & x, 
+                            std::vector<double> & derivs) const {
+      return fetchValueAndDerivs(x, derivs, false);
+   }
+
+   /// Get the Function value and the derivatives wrt the free
+   /// Parameters in one call.
+   double getValueAndFreeDerivs(const Arg & x, 
+                                std::vector<double> & derivs) const {
+      return fetchValueAndDerivs(x, derivs, true);
+   }
+
    /// Return the integral of function wrt data variable.
    virtual double integral(const Arg &, const Arg &) const {
      throw std::runtime_error("integral method not implemented for "
@@ -243,6 +289,20 @@ protected:
    virtual double derivByParamImp(const Arg & x,
                                   const std::string & paramName) const = 0;
 
+   /// Default implementation looks up the Parameter name and calls
+   /// derivByParamImp.  Subclasses should override this to avoid
+   /// the name lookup.
+   virtual double derivByParamIndexImp(const Arg & x,
+                                       unsigned int paramIndex) const;
+
+   /// Default implementations loop over value and
+   /// derivByParamIndexImp one point at a time.  Subclasses of dArg
+   /// should override these with contiguous loops.
+   virtual void valuesImp(const double * x, double * out, size_t n) const;
+
+   virtual void derivsImp(const double * x, double * out, size_t n,
+                          bool getFree) const;
+
    /// For subclass usage
    void addParam(const std::string & paramName, 
                  double paramValue, bool isFree=true);
@@ -254,9 +314,19 @@ protected:
 
    void fetchParamNames(std::vector<std::string> & names, bool getFree) const;
 
+   /// Number of entries in m_parameter, or of the free ones.
+   size_t numParams(bool getFree) const;
+
    virtual void fetchDerivs(const Arg & x ,std::vector<double> & derivs, 
                             bool getFree) const;
 
+   /// Default implementation calls operator() and fetchDerivs
+   /// separately.  Subclasses can override this to share intermediate
+   /// results between the value and the derivatives.
+   virtual double fetchValueAndDerivs(const Arg & x, 
+                                      std::vector<double> & derivs,
+                                      bool getFree) const;
+
    void setNormParName(const std::string & normParName);
 
    void setGenericName(const std::string & genericName);
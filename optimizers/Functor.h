@@ -32,6 +32,12 @@ public:
 
    virtual double operator()(std::vector<double> & x) = 0;
 
+   /// An independent copy for evaluation on another thread, or zero
+   /// if the function object cannot be copied.
+   virtual Functor * clone() const {
+      return 0;
+   }
+
 };
 
 } // namespace optimizers
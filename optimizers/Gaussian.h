@@ -41,12 +41,22 @@ protected:
 
    double derivByParamImp(const Arg &, const std::string & paramName) const;
 
+   double derivByParamIndexImp(const Arg &, unsigned int paramIndex) const;
+
+   void valuesImp(const double * x, double * out, size_t n) const;
+
+   void derivsImp(const double * x, double * out, size_t n,
+                  bool getFree) const;
+
 private:
 
    double erfcc(double x) const;
 
    mutable std::vector<double> m_xvalues;
 
+   /// Scratch space for derivsImp.
+   mutable std::vector<double> m_profile;
+
 };
 
 } // namespace optimizers
@@ -0,0 +1,119 @@
+/**
+ * @file Instrumentation.h
+ * @brief Call counts, cumulative time and latency histograms for
+ * Statistic evaluations and Optimizer phases.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#ifndef optimizers_Instrumentation_h
+#define optimizers_Instrumentation_h
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace optimizers {
+
+/**
+ * @class Instrumentation
+ *
+ * @brief Accumulates, for each kind of call, the number of calls,
+ * their total wall time and a histogram of the per-call latency.
+ *
+ * Latency bin k counts calls that took between 2^k and 2^(k+1)
+ * nanoseconds; the last bin also takes anything longer.  The
+ * counters are atomic so that one Instrumentation object may be
+ * shared by the clones of a Statistic that the Optimizer evaluates
+ * in several threads.  Phases may nest, e.g., find_min for
+ * NewMinuit includes its HESSE call, so the times of different
+ * phases need not add up.
+ *
+ * $Header$
+ */
+
+class Instrumentation {
+
+public:
+
+   enum Phase {VALUE, DERIVS, VALUE_AND_DERIVS, SET_PARAMS,
+               FIND_MIN, HESSIAN, MINOS, NPHASES};
+
+   static const unsigned int NBINS = 32;
+
+   Instrumentation();
+
+   /// Record one call of the given kind that took the given time.
+   void record(Phase phase, std::chrono::nanoseconds elapsed);
+
+   unsigned long calls(Phase phase) const {
+      return m_calls[phase];
+   }
+
+   /// Cumulative wall time in seconds.
+   double time(Phase phase) const {
+      return m_nanoseconds[phase]*1e-9;
+   }
+
+   /// Mean wall time per call in seconds, or zero if there were no calls.
+   double meanTime(Phase phase) const;
+
+   /// The latency histogram, NBINS entries.
+   std::vector<unsigned long> histogram(Phase phase) const;
+
+   void reset();
+
+   static const char * phaseName(Phase phase);
+
+   /// Print a table of the counts and times of the phases that
+   /// were called.
+   void report(std::ostream & out=std::cout) const;
+
+   /**
+    * @class Timer
+    *
+    * @brief Records the time between its construction and
+    * destruction.  Given a null Instrumentation pointer it does
+    * nothing, not even read the clock, so that uninstrumented
+    * code pays only for a test of the pointer.
+    */
+
+   class Timer {
+   public:
+      Timer(Instrumentation * instruments, Phase phase)
+         : m_instruments(instruments), m_phase(phase) {
+         if (m_instruments) {
+            m_start = std::chrono::steady_clock::now();
+         }
+      }
+      ~Timer() {
+         if (m_instruments) {
+            m_instruments->record(m_phase, std::chrono::steady_clock::now()
+                                  - m_start);
+         }
+      }
+   private:
+      Instrumentation * m_instruments;
+      Phase m_phase;
+      std::chrono::steady_clock::time_point m_start;
+      Timer(const Timer &);
+      Timer & operator=(const Timer &);
+   };
+
+private:
+
+   std::atomic<unsigned long> m_calls[NPHASES];
+   std::atomic<unsigned long long> m_nanoseconds[NPHASES];
+   std::atomic<unsigned long> m_histogram[NPHASES][NBINS];
+
+   // Disable copying.
+   Instrumentation(const Instrumentation &);
+   Instrumentation & operator=(const Instrumentation &);
+
+};
+
+} // namespace optimizers
+
+#endif // optimizers_Instrumentation_h
@@ -0,0 +1,88 @@
+/**
+ * @file InstrumentedStatistic.h
+ * @brief Declaration of a Statistic decorator that times evaluations
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#ifndef optimizers_InstrumentedStatistic_h
+#define optimizers_InstrumentedStatistic_h
+
+#include <vector>
+
+#include "optimizers/Instrumentation.h"
+#include "optimizers/StatisticDecorator.h"
+
+namespace optimizers {
+
+/**
+ * @class InstrumentedStatistic
+ *
+ * @brief Wraps a Statistic and records the calls to value,
+ * getFreeDerivs, valueAndFreeDerivs and setFreeParamValues, with
+ * their times, in an Instrumentation object.  Parameter values are
+ * read from and written to the wrapped Statistic.
+ *
+ */
+
+class InstrumentedStatistic : public StatisticDecorator {
+
+public:
+
+   InstrumentedStatistic(Statistic & stat, Instrumentation & instruments)
+      : StatisticDecorator("InstrumentedStatistic", stat),
+        m_instruments(&instruments) {}
+
+   /// Copies own a clone of the wrapped Statistic and record into
+   /// the same Instrumentation object.
+   InstrumentedStatistic(const InstrumentedStatistic & rhs)
+      : StatisticDecorator(rhs), m_instruments(rhs.m_instruments) {}
+
+   virtual double value() const;
+
+   virtual void getFreeDerivs(std::vector<double> & derivs) const;
+
+   virtual void getFreeDerivs(const Arg &, std::vector<double> & derivs) const {
+      getFreeDerivs(derivs);
+   }
+
+   virtual void valueAndFreeDerivs(const std::vector<double> & x,
+                                   double & f, std::vector<double> & g);
+
+   virtual std::vector<double>::const_iterator setParamValues_(
+      std::vector<double>::const_iterator it);
+
+   virtual std::vector<double>::const_iterator setFreeParamValues_(
+      std::vector<double>::const_iterator it);
+
+   virtual Function * clone() const {
+      return new InstrumentedStatistic(*this);
+   }
+
+   const Instrumentation & instruments() const {
+      return *m_instruments;
+   }
+
+protected:
+
+   virtual double value(const Arg &) const {
+      return value();
+   }
+
+   virtual void fetchDerivs(const Arg & x, std::vector<double> & derivs,
+                            bool getFree) const;
+
+   virtual double fetchValueAndDerivs(const Arg & x,
+                                      std::vector<double> & derivs,
+                                      bool getFree) const;
+
+private:
+
+   Instrumentation * m_instruments;
+
+};
+
+} // namespace optimizers
+
+#endif // optimizers_InstrumentedStatistic_h
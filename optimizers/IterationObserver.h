@@ -0,0 +1,73 @@
+/**
+ * @file IterationObserver.h
+ * @brief Interface for receiving the iteration history of an Optimizer.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#ifndef optimizers_IterationObserver_h
+#define optimizers_IterationObserver_h
+
+#include <vector>
+
+namespace optimizers {
+
+/**
+ * @class IterationRecord
+ * @brief The state of an Optimizer at an accepted step.
+ *
+ * Quantities that a backend does not compute are NaN.
+ *
+ * $Header$
+ */
+
+class IterationRecord {
+
+public:
+
+   IterationRecord() : iteration(0), value(0), gradNorm(0), stepLength(0),
+                       edm(0) {}
+
+   /// Zero for the starting point of each find_min call.
+   unsigned int iteration;
+
+   /// The free Parameter values.
+   std::vector<double> params;
+
+   /// The Statistic value, i.e., the quantity being maximized.
+   double value;
+
+   /// Euclidean norm of the gradient wrt the free Parameters, less
+   /// the components that push against an active bound.
+   double gradNorm;
+
+   /// Euclidean distance from the previously reported point.
+   double stepLength;
+
+   /// Estimated distance to the maximum, as computed by the backend.
+   double edm;
+
+};
+
+/**
+ * @class IterationObserver
+ * @brief Receives an IterationRecord at the start of each find_min
+ * and at each step accepted by the Optimizer.
+ *
+ * $Header$
+ */
+
+class IterationObserver {
+
+public:
+
+   virtual ~IterationObserver() {}
+
+   virtual void update(const IterationRecord & record) = 0;
+
+};
+
+} // namespace optimizers
+
+#endif // optimizers_IterationObserver_h
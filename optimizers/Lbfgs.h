@@ -14,6 +14,7 @@
 #include "optimizers/Statistic.h"
 #include "optimizers/f2c_types.h"
 #include <string>
+#include <vector>
 
 namespace optimizers {
   
@@ -24,6 +25,10 @@ namespace optimizers {
    * variable metric implementation of Byrd, Lu, Nocedal, & Zhu 1995,
    * SIAM, J. Sci. Comp., 16, 5 (http://www.netlib.org/opt/lbfgs_bcm.shar).
    *
+   * OptimizerFactory creates the C++ LbfgsB for "Lbfgs".  This class
+   * is kept for existing code that constructs it directly and as the
+   * reference that LbfgsB is checked and benchmarked against.
+   *
    * @author P. Nolan, J. Chiang
    * 
    * $Header$
@@ -63,7 +68,12 @@ namespace optimizers {
     
     virtual ~Lbfgs() {}
     
+    /// Number of variable metric corrections kept, i.e., the rank
+    /// of the limited-memory Hessian approximation.  Larger values
+    /// can save iterations at high dimension, at a cost in memory and
+    /// time per iteration of order m*nparams.
     void setMaxVarMetCorr(const int m);
+    int getMaxVarMetCorr() const {return m_maxVarMetCorr;}
     void setPgtol(const double pgtol);
     
     std::string getErrorString(void) const;
@@ -87,6 +97,16 @@ namespace optimizers {
     int m_numEvals;
     double m_val;
     std::string m_errorString;
+
+    //! Workspace for setulb_, kept between calls to find_min
+    std::vector<int> m_nbd;
+    std::vector<double> m_doubleWorkArray;
+    std::vector<int> m_intWorkArray;
+    std::vector<char> m_task;
+    std::vector<char> m_csave;
+    std::vector<logical> m_lsave;
+    std::vector<int> m_isave;
+    std::vector<double> m_dsave;
   };
   
   extern "C" {
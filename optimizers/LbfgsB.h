@@ -0,0 +1,204 @@
+/**
+ * @file LbfgsB.h
+ * @brief Native C++ implementation of the L-BFGS-B Optimizer.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#ifndef optimizers_LbfgsB_h
+#define optimizers_LbfgsB_h
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "optimizers/Optimizer.h"
+
+namespace optimizers {
+
+/**
+ * @class LbfgsB
+ *
+ * @brief The limited-memory BFGS algorithm for bound constrained
+ * problems of Byrd, Lu, Nocedal, & Zhu 1995, SIAM J. Sci. Comp., 16,
+ * 1190, with the subspace minimization of L-BFGS-B 3.0 (Morales &
+ * Nocedal 2011, ACM TOMS, 38, 7), written in C++.
+ *
+ * It has the interface of Lbfgs, and follows the steps, line search
+ * and stopping rules of the Fortran code that Lbfgs wraps, but
+ * without the reverse-communication driver.  The correction pairs
+ * are stored as contiguous vectors of length nparams, so that the
+ * O(m*nparams) work of each iteration is done in dot products and
+ * vector updates over them, and the inner products among them are
+ * kept up to date rather than recomputed.  Each instance owns all of
+ * its state, so that separate instances may run concurrently.
+ * OptimizerFactory creates it for both "LbfgsB" and "Lbfgs".
+ *
+ * The accessors below expose the state of the last (or current)
+ * find_min, e.g., for use by an IterationObserver.
+ *
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+class LbfgsB : public Optimizer {
+
+public:
+
+   LbfgsB(Statistic & stat)
+      : Optimizer(stat), m_maxVarMetCorr(5), m_pgtol(0), m_numEvals(0),
+        m_iter(0), m_nskip(0), m_val(0), m_theta(1), m_sbgnrm(0),
+        m_nfree(0), m_head(0), m_col(0) {}
+
+   virtual ~LbfgsB() {}
+
+   /// Number of variable metric corrections kept.
+   void setMaxVarMetCorr(const int m) {m_maxVarMetCorr = m;}
+   int getMaxVarMetCorr() const {return m_maxVarMetCorr;}
+
+   /// The fit converges once the largest component of the projected
+   /// gradient is at most pgtol.
+   void setPgtol(const double pgtol) {m_pgtol = pgtol;}
+
+   std::string getErrorString() const {return m_errorString;}
+
+   virtual int find_min(int verbose=0, double tol=1.e-5,
+                        int tolType=ABSOLUTE);
+
+   virtual int find_min_only(int verbose=0, double tol=1.e-5,
+                             int tolType=ABSOLUTE) {
+      return find_min(verbose, tol, tolType);
+   }
+
+   virtual std::ostream & put(std::ostream & s) const;
+
+   enum LbfgsReturnCodes {LBFGS_NORMAL, LBFGS_ABNO, LBFGS_ERROR,
+                          LBFGS_TOOMANY, LBFGS_UNKNOWN};
+
+   /// Number of Statistic evaluations.
+   int numEvals() const {return m_numEvals;}
+
+   /// Number of iterations, i.e., completed line searches.
+   int iterations() const {return m_iter;}
+
+   /// Number of updates skipped because s^T y was not positive.
+   int numSkipped() const {return m_nskip;}
+
+   /// Number of correction pairs currently stored.
+   int numCorrections() const {return m_col;}
+
+   /// Scaling theta = y^T y/s^T y of the approximate Hessian
+   /// B = theta*I - W M W^T.
+   double theta() const {return m_theta;}
+
+   /// Largest component of the projected gradient of -Statistic.
+   double projGradNorm() const {return m_sbgnrm;}
+
+   /// Number of variables free at the last generalized Cauchy point.
+   int numFree() const {return m_nfree;}
+
+   /// The i-th stored step s_i and gradient change y_i, oldest first.
+   void getCorrection(int i, std::vector<double> & sv,
+                      std::vector<double> & yv) const;
+
+private:
+
+   int m_maxVarMetCorr;
+   double m_pgtol;
+
+   int m_numEvals;
+   int m_iter;
+   int m_nskip;
+   double m_val;
+   double m_theta;
+   double m_sbgnrm;
+   int m_nfree;
+   std::string m_errorString;
+
+   /// The variables, their bounds, L-BFGS-B bound codes and status,
+   /// and the gradient of -Statistic.
+   std::vector<double> m_x;
+   std::vector<double> m_lower;
+   std::vector<double> m_upper;
+   std::vector<int> m_nbd;
+   std::vector<int> m_iwhere;
+   std::vector<double> m_grad;
+
+   /// Correction pairs in a ring of m_maxVarMetCorr slots of nparams
+   /// values each.  The oldest of the m_col pairs is in slot m_head.
+   std::vector<double> m_s;
+   std::vector<double> m_y;
+   int m_head;
+   int m_col;
+
+   /// S^T S, S^T Y and Y^T Y, m x m, oldest pair first.
+   std::vector<double> m_ss;
+   std::vector<double> m_sy;
+   std::vector<double> m_yy;
+
+   /// LU factors of the middle matrix M^{-1} = [-D, L^T; L, theta*S^T S].
+   std::vector<double> m_middle;
+   std::vector<size_t> m_middlePivots;
+
+   /// Work arrays: the Cauchy point (then the subspace minimizer),
+   /// the search direction, the previous iterate and gradient, the
+   /// free variables followed by the fixed ones, and the 2m-vectors
+   /// of the Cauchy search.
+   std::vector<double> m_xcp;
+   std::vector<double> m_dir;
+   std::vector<double> m_xold;
+   std::vector<double> m_gold;
+   std::vector<double> m_work;
+   std::vector<size_t> m_index;
+   std::vector<double> m_p;
+   std::vector<double> m_c;
+   std::vector<double> m_v;
+   std::vector<double> m_wbp;
+   std::vector<double> m_kmat;
+   std::vector<size_t> m_kPivots;
+   std::vector< std::pair<double, size_t> > m_breaks;
+
+   /// Set f and m_grad to -Statistic and its gradient at m_x.
+   void evaluate(double & f, int verbose);
+
+   /// Set m_sbgnrm to the largest component of the projected
+   /// gradient, and return its Euclidean norm.
+   double projectedGradient();
+
+   void resetCorrections();
+
+   /// Store the pair held in m_xold and m_gold.
+   void addCorrection(double yy, double sy);
+
+   void fillMiddle(std::vector<double> & a) const;
+
+   bool formMiddle();
+
+   /// m_v = M*v
+   void middleTimes(const double * v);
+
+   /// The generalized Cauchy point along the projected gradient
+   /// path, in m_xcp, and c = W^T (xcp - x), in m_c.
+   void cauchy();
+
+   void freeVariables();
+
+   /// Move m_xcp to the minimizer of the quadratic model over the
+   /// free variables, subject to the bounds.  @return false if the
+   /// reduced system is singular.
+   bool subspaceMinimization(bool constrained);
+
+   const double * s(int i) const {
+      return &m_s[((m_head + i) % m_maxVarMetCorr)*m_x.size()];
+   }
+   const double * y(int i) const {
+      return &m_y[((m_head + i) % m_maxVarMetCorr)*m_x.size()];
+   }
+
+};
+
+} // namespace optimizers
+
+#endif // optimizers_LbfgsB_h
@@ -14,6 +14,12 @@
 #include "optimizers/Parameter.h"
 #include "optimizers/Function.h"
 #include "optimizers/Exception.h"
+#include "optimizers/SampleBuffer.h"
+#include "optimizers/SampleSink.h"
+
+namespace CLHEP {
+   class HepRandomEngine;
+}
 
 namespace optimizers {
 
@@ -38,6 +44,15 @@ namespace optimizers {
  * of other Function objects can be applied.  As with the Statistic
  * itself, these priors need not be normalized to unity.
  *
+ * generateChains runs several independent chains concurrently, each
+ * on its own thread with its own clone of the Function.  Besides the
+ * variable-at-a-time updates, the chains can use block updates with
+ * a Gaussian proposal whose widths are the transition widths, or an
+ * adaptive Gaussian proposal (Haario, Saksman & Tamminen 2001) whose
+ * covariance is seeded from the transition widths and then learned
+ * from the chain itself.  gelmanRubin computes the convergence
+ * diagnostic from the resulting chains.
+ *
  * @author J. Chiang
  *
  * $Header$
@@ -47,6 +62,9 @@ class Mcmc {
 
 public:
 
+   /// Proposal distributions used by generateChains
+   enum Proposal {VARIABLE_AT_A_TIME, BLOCK, ADAPTIVE};
+
    Mcmc(Function &stat, bool verbose=true);
 
    ~Mcmc() {}
@@ -55,9 +73,44 @@ public:
       m_priors = priors;
    }
 
+   /// Append nsamp samples to a contiguous buffer, which is
+   /// reserved up front so that sampling does not allocate.  This is
+   /// the native output format.
+   void generateSamples(SampleBuffer & samples, unsigned long nsamp=10000,
+                        bool clear=false);
+
+   /// Compatibility form, with one vector per sample.
    void generateSamples(std::vector< std::vector<double> > &samples,
                         unsigned long nsamp=10000, bool clear=false);
 
+   /// Stream nsamp samples to sink as they are generated, so that
+   /// long chains run in bounded memory.  The sink is flushed on
+   /// return.
+   void generateSamples(SampleSink & sink, unsigned long nsamp=10000);
+
+   /// Column names for the samples: the free Parameter names followed
+   /// by "Statistic" for the statistic value.
+   void getColumnNames(std::vector<std::string> & names) const;
+
+   /// Run nchains independent chains concurrently.  The first chain
+   /// starts at the current Parameter values and the others at
+   /// points drawn around them using the transition widths.  On
+   /// return, chains[k] contains the nsamp samples of chain k, in
+   /// the same format as generateSamples.
+   void generateChains(std::vector< std::vector< std::vector<double> > > 
+                       & chains, unsigned long nsamp=10000, 
+                       unsigned int nchains=4, 
+                       Proposal proposal=VARIABLE_AT_A_TIME,
+                       long seed=19780503);
+
+   /// Gelman-Rubin potential scale reduction factor for each free
+   /// Parameter, computed from the samples after the first burnIn
+   /// of each chain.  Throws an Exception if a Parameter does not
+   /// vary within any of the chains.
+   static std::vector<double> 
+   gelmanRubin(const std::vector< std::vector< std::vector<double> > > 
+               & chains, unsigned long burnIn=0);
+
    /// Set the transition probablity widths by hand
    void setTransitionWidths(std::vector<double> &transitionWidths) {
       m_transitionWidths = transitionWidths;
@@ -68,9 +121,14 @@ public:
       transitionWidths = m_transitionWidths;
    }
 
-   /// write samples to a FITS binary table
+   /// write samples to a FITS binary table; use a FitsSampleSink
+   /// with generateSamples to avoid holding the samples in memory
    void writeSamples(std::string filename, 
-                     std::vector< std::vector<double> > &samples) const;
+                     std::vector< std::vector<double> > &samples,
+                     bool doublePrecision=false) const;
+
+   void writeSamples(std::string filename, const SampleBuffer & samples,
+                     bool doublePrecision=false) const;
 
 private:
 
@@ -87,6 +145,11 @@ private:
    double drawValue(Parameter &param, double transitionWidth, 
                     double &transProbRatio);
 
+   void runChain(Function & stat, const std::vector<double> & startValues,
+                 unsigned long nsamp, Proposal proposal,
+                 CLHEP::HepRandomEngine * engine,
+                 SampleSink & sink, bool verbose=false) const;
+
 };
 
 } // namespace optimizers
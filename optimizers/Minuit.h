@@ -8,12 +8,16 @@
 #ifndef optimizers_MINUIT_H
 #define optimizers_MINUIT_H
 
+#include <memory>
+
 #include "optimizers/Optimizer.h"
 #include "optimizers/Statistic.h"
 #include "optimizers/f2c_types.h"
 
 namespace optimizers {
 
+  class NewMinuit;
+
   /** 
    * @class Minuit
    *
@@ -25,6 +29,18 @@ namespace optimizers {
    well-known package from CERN.  It uses only a few of Minuit's
    features.  It uses only the MIGRAD algorithm.  All variables
    are treated as bounded.  No user interaction is allowed.
+
+   The Fortran code keeps its state in COMMON blocks.  Each
+   instance keeps its own copy of that state, so that instances
+   may be used from different threads or interleaved in one.  The
+   Fortran code is not reentrant, however, and it evaluates the
+   Statistic from within each command, so a process-wide lock is
+   held for the whole of each call into it: fits by different
+   instances are serialized, not run concurrently.
+
+   For concurrent fits, setUseMinuit2(true) routes the fits, errors
+   and contours, and the commands passed to doCmd, through Minuit2
+   (by way of NewMinuit) instead, which has no global state.
    */
   
   // Doxygen the C file here so it can be left as nearly as
@@ -74,12 +90,23 @@ namespace optimizers {
      /// Access to the covariance matrix
      virtual std::vector< std::vector<double> > covarianceMatrix() const;
 
+     virtual CovarianceMatrix covariance() const {
+        return CovarianceMatrix(covarianceMatrix());
+     }
+
      /// Run a MINOS error analysis
     std::pair<double,double> Minos(unsigned int n, double level=1., bool numericDeriv=false);
 
     /// Run a MNCONTOUR dynamic CONTOUR analysis
     void MnContour(unsigned int par1, unsigned int par2,
 		   double level=1., unsigned int npts=20);
+
+    /// The Fortran MNCONT, which shares Minuit's global state, so
+    /// the contours are always computed one after another.
+    virtual std::vector<Contour> 
+    contours(const std::vector< std::pair<unsigned int, unsigned int> > & pairs,
+             const std::vector<double> & levels, unsigned int npts=20,
+             bool parallel=true);
      
     virtual std::ostream& put (std::ostream& s) const;
 
@@ -94,20 +121,77 @@ namespace optimizers {
         return m_strategy_value;
      }
 
+    /// MINOS errors from NewMinuit, computed concurrently if
+    /// parallel is true, when routed through Minuit2; otherwise,
+    /// Minos for each parameter in turn.
+    virtual std::vector< std::pair<double, double> > 
+    MinosAll(const std::vector<unsigned int> & pars, double level=1., 
+             bool parallel=true);
+
     //! Pass a command string to Minuit
     virtual int doCmd(std::string command, bool set_npar=false);
 
+    /// Route all of the calls through Minuit2 instead of the Fortran
+    /// code, so that fits by different instances run concurrently.
+    /// The return codes, quality and distance keep their meanings.
+    /// Minuit2 always uses the gradient of the Statistic, and it
+    /// throws if migrad does not converge or MINOS finds no limit.  doCmd then accepts the
+    /// commands that this class issues itself: MIGRAD or MINIMIZE
+    /// [maxcalls [tolerance]], HESSE, MINOS [maxcalls [par...]], and
+    /// SET PRINT, NOWARN, ERR, GRAD, NOGRAD and STRATEGY.  Other
+    /// commands return 3, as for an unknown command.
+    void setUseMinuit2(bool useMinuit2) {
+      m_useMinuit2 = useMinuit2;
+    }
+
+    bool useMinuit2() const {
+      return m_useMinuit2;
+    }
+
 
   private:
     
+    class StateGuard;
+
     int minimize(int verbose, double tol, int tolType, bool doHesse);
 
+    /// minimize, through Minuit2
+    int minimize2(int verbose, double tol, int tolType, bool doHesse);
+
+    /// Copy the quality, distance and uncertainties from Minuit2.
+    void getMinuit2Results();
+
+    /// doCmd, through Minuit2
+    int minuit2Cmd(const std::string & command);
+
+    /// The NewMinuit of the last fit through Minuit2.  Throws if
+    /// there has been none.
+    NewMinuit & minuit2(const std::string & routine) const;
+
+    /// This instance's copy of the Minuit COMMON blocks
+    mutable std::vector<char> m_commonState;
+
+    /// Number of free parameters passed to fcn
+    mutable int m_numPars;
+
+    /// True while this instance's state is loaded in the COMMON blocks
+    mutable bool m_active;
+
     int m_quality;
     double m_distance;
     double m_val;
 
     unsigned int m_strategy_value;
 
+    bool m_useMinuit2;
+
+    /// Shared by copies of this object, like the Statistic.
+    std::shared_ptr<NewMinuit> m_minuit2;
+
+    /// The SET PRINT level and SET ERR value passed to doCmd when
+    /// routed through Minuit2.
+    int m_printLevel;
+    double m_errorDef;
 
   };
   
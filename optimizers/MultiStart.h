@@ -0,0 +1,147 @@
+/**
+ * @file MultiStart.h
+ * @brief Global optimization by running a local Optimizer from many
+ * starting points.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#ifndef optimizers_MultiStart_h
+#define optimizers_MultiStart_h
+
+#include <string>
+#include <vector>
+
+#include "optimizers/Optimizer.h"
+
+namespace optimizers {
+
+/**
+ * @class MultiStart
+ *
+ * @brief Runs a local Optimizer, chosen by its OptimizerFactory name,
+ * from the current parameter values and from starting points drawn
+ * by Latin hypercube sampling within the Parameter bounds.  The fits
+ * run concurrently on clones of the Statistic.  Their results are
+ * grouped into distinct local maxima, and the Statistic is left at
+ * the best one.
+ *
+ * Parameters with infinite bounds, or with bounds of (0, 0), which
+ * mean unbounded, are sampled within max(|value|, 1) of their
+ * starting values.  The Fortran-based backends (Minuit, Drmngb,
+ * Drmnfb) share static storage, so their fits are run one at a time;
+ * NewMinuit, Lbfgs and LbfgsB (both the C++ L-BFGS-B), Powell,
+ * Simplex and Amoeba fits run concurrently.
+ *
+ * A start is cancelled if, after a few iterations, its value plus
+ * the improvement still expected from it (the EDM, or else ten times
+ * the last step's improvement) is more than the cancellation margin
+ * below the best value found so far.  This needs a backend that
+ * reports its iterations as it goes, i.e., all but the two Minuits,
+ * Simplex and Amoeba.  With any of those, including the default
+ * NewMinuit, every start runs to convergence whatever the margin.
+ *
+ * $Header$
+ */
+
+class MultiStart : public Optimizer {
+
+public:
+
+   /// A distinct local maximum and the number of starts that
+   /// converged to it.
+   class Minimum {
+   public:
+      Minimum() : value(0), nstarts(0), retCode(0) {}
+      std::vector<double> params;
+      double value;
+      unsigned int nstarts;
+      int retCode;
+   };
+
+   MultiStart(Statistic & stat,
+              const std::string & localOptimizer="NewMinuit");
+
+   virtual ~MultiStart() {}
+
+   virtual int find_min(int verbose=0, double tol=1e-5,
+                        int tolType=ABSOLUTE);
+
+   virtual int find_min_only(int verbose=0, double tol=1e-5,
+                             int tolType=ABSOLUTE) {
+      return find_min(verbose, tol, tolType);
+   }
+
+   virtual std::ostream & put(std::ostream & s) const;
+
+   const std::string & localOptimizer() const {
+      return m_localOptimizer;
+   }
+
+   /// Number of starting points, including the current parameter
+   /// values.  Zero means 10 per free parameter.
+   void setNumStarts(unsigned int nstarts) {m_nstarts = nstarts;}
+   unsigned int numStarts() const {return m_nstarts;}
+
+   /// Number of threads; zero means one per hardware core.
+   void setThreads(unsigned int nthreads) {m_nthreads = nthreads;}
+   unsigned int threads() const {return m_nthreads;}
+
+   void setSeed(long seed) {m_seed = seed;}
+
+   /// Two converged fits are the same local maximum if the distance
+   /// between them, in units of the sampling range of each
+   /// parameter, is less than tol.
+   void setClusterTolerance(double tol) {m_clusterTol = tol;}
+
+   /// Cancel starts that are more than margin below the best value
+   /// after minIterations iterations.  A margin <= 0 disables this.
+   /// It has no effect with a local Optimizer that does not report
+   /// its iterations as it goes (see above); find_min says so if
+   /// verbose.
+   void setCancellation(double margin, unsigned int minIterations=5) {
+      m_cancelMargin = margin;
+      m_cancelIterations = minIterations;
+   }
+
+   /// The distinct local maxima from the last find_min, best first.
+   const std::vector<Minimum> & minima() const {return m_minima;}
+
+   unsigned int numCancelled() const {return m_ncancelled;}
+   unsigned int numFailed() const {return m_nfailed;}
+
+private:
+
+   std::string m_localOptimizer;
+   unsigned int m_nstarts;
+   unsigned int m_nthreads;
+   long m_seed;
+   double m_clusterTol;
+   double m_cancelMargin;
+   unsigned int m_cancelIterations;
+
+   std::vector<Minimum> m_minima;
+   unsigned int m_ncancelled;
+   unsigned int m_nfailed;
+
+   /// Sampling range for each free parameter.
+   void samplingRanges(std::vector<double> & lower,
+                       std::vector<double> & upper) const;
+
+   /// Latin hypercube sample of nstarts - 1 points within the
+   /// ranges, preceded by the current parameter values.
+   void drawStarts(const std::vector<double> & lower,
+                   const std::vector<double> & upper,
+                   std::vector< std::vector<double> > & starts) const;
+
+   /// Group the fits into distinct maxima, best first.
+   void cluster(const std::vector<Minimum> & fits,
+                const std::vector<double> & lower,
+                const std::vector<double> & upper);
+
+};
+
+} // namespace optimizers
+
+#endif // optimizers_MultiStart_h
@@ -8,6 +8,7 @@
 #ifndef optimizers_NEWMINUIT_H
 #define optimizers_NEWMINUIT_H
 
+#include <string>
 #include <vector>
 #include "optimizers/Optimizer.h"
 #include "optimizers/Statistic.h"
@@ -38,6 +39,7 @@ namespace optimizers {
     virtual std::vector<double> Gradient(const std::vector<double> &) const;
     virtual bool CheckGradient() const {return false;}
     virtual void SetErrorDef(double level) {m_level=level;}
+    void setStatistic(Statistic & stat) {m_stat = &stat;}
   private:
     Statistic * m_stat;
     double m_level;
@@ -65,6 +67,10 @@ namespace optimizers {
     NewMinuit(const NewMinuit & x);
     virtual int find_min(int verbose=0, double tole = 1e-5, int tolType = ABSOLUTE);
     virtual int find_min_only(int verbose=0, double tole = 1e-5, int tolType = ABSOLUTE);
+    virtual void setEvaluationCache(unsigned int nentries) {
+       Optimizer::setEvaluationCache(nentries);
+       m_FCN.setStatistic(*m_stat);
+    }
     void setStrategy(unsigned int strat = 1) {
        m_strategy_value = strat;
        m_strategy=ROOT::Minuit2::MnStrategy(strat);
@@ -73,6 +79,25 @@ namespace optimizers {
         return m_strategy_value;
      }
 
+    /// In warm-start mode, migrad is seeded with the covariance
+    /// from the previous fit (or from a state read by readState),
+    /// so that refits of the same model skip the first iterations.
+    /// The fit starts from the Statistic's current parameter values.
+    /// Step sizes are taken from that covariance or, failing that,
+    /// from Parameter::error().  If the free parameters have changed
+    /// since the seed was saved, the fit starts cold.
+    void setWarmStart(bool warmStart) {m_warmStart = warmStart;}
+    bool warmStart() const {return m_warmStart;}
+
+    /// Write the free parameter names, values and covariance from
+    /// the last fit to a text file.
+    void writeState(const std::string & filename) const;
+
+    /// Read a state written by writeState, set the free parameter
+    /// values of the Statistic and use the covariance to seed the
+    /// next warm-started fit.
+    void readState(const std::string & filename);
+
 
     const ROOT::Minuit2::MnUserParameterState& userState() const;
     const ROOT::Minuit2::MinimumError& minuitError() const;
@@ -108,6 +133,9 @@ namespace optimizers {
     double getDistance(void) const {return m_distance;};
     virtual const std::vector<double> & getUncertainty(bool useBase = false);
     virtual std::vector<std::vector<double> > covarianceMatrix() const;
+    virtual CovarianceMatrix covariance() const {
+       return CovarianceMatrix(covarianceMatrix());
+    }
     
 
     virtual std::ostream& put (std::ostream& s) const;
@@ -120,9 +148,34 @@ namespace optimizers {
      double minos_upper_error(unsigned int n, double level=1.,
                               double tol=1e-3);
 
+     /// Compute both MINOS errors for each parameter in pars (all of
+     /// the free parameters if pars is empty).  If parallel is true,
+     /// each side of each parameter is a separate task, run by one
+     /// thread per hardware core, each with its own clone of the
+     /// Statistic; otherwise, minos_lower_error and minos_upper_error
+     /// are called in turn.
+     virtual std::vector< std::pair<double, double> >
+     MinosAll(const std::vector<unsigned int> & pars, double level=1.,
+              bool parallel=true) {
+        return MinosAll(pars, level, parallel, 1e-3);
+     }
+     std::vector< std::pair<double, double> >
+     MinosAll(const std::vector<unsigned int> & pars, double level,
+              bool parallel, double tol);
+
     /// Run a MNCONTOUR dynamic CONTOUR analysis
     void MnContour(unsigned int par1, unsigned int par2,
 		   double level=1., unsigned int npts=20);
+
+    /// Contour points are the crossings of the level along npts
+    /// rays from the minimum, evenly spaced in angle, so unlike
+    /// MnContour, no point depends on another and all are computed
+    /// concurrently, each thread with its own clone of the Statistic.
+    /// Rays that do not cross the level are omitted.
+    virtual std::vector<Contour> 
+    contours(const std::vector< std::pair<unsigned int, unsigned int> > & pairs,
+             const std::vector<double> & levels, unsigned int npts=20,
+             bool parallel=true);
   private:
     myFCN m_FCN;
     double m_distance;
@@ -132,9 +185,22 @@ namespace optimizers {
 
      unsigned int m_strategy_value;
 
+    bool m_warmStart;
+
+    /// The seed for warm starts: free parameter names and values
+    /// and the packed upper triangle of their covariance, which is
+    /// empty if there was none.
+    std::vector<std::string> m_seedNames;
+    std::vector<double> m_seedValues;
+    std::vector<double> m_seedCovariance;
+
+    void saveSeed();
+    bool seedMatches(const std::vector<Parameter> & params) const;
+
     void setTolerance(double tol, int tolType);
     void hesse(int verbose = 0);
     int checkResults();
+    void notifyMigradStates();
 
      void checkParValues(unsigned int n, std::vector<double> & parValues) const;
   };
@@ -10,17 +10,32 @@
 #ifndef optimizers_Optimizer_h
 #define optimizers_Optimizer_h
 
+#include <memory>
+#include <utility>
 #include <vector>
 #include <valarray>
 #include <iostream>
 
+#include "optimizers/CachedStatistic.h"
+#include "optimizers/Contour.h"
+#include "optimizers/CovarianceMatrix.h"
 #include "optimizers/Exception.h"
+#include "optimizers/Instrumentation.h"
+#include "optimizers/InstrumentedStatistic.h"
+#include "optimizers/IterationObserver.h"
 #include "optimizers/Statistic.h"
 
 namespace optimizers {
 
 enum TOLTYPE {RELATIVE, ABSOLUTE};
 
+class SparseHessian;
+
+/// How the rows of the finite-difference Hessian are assigned to
+/// threads: STATIC deals them out round-robin; DYNAMIC lets each
+/// thread take the next unfinished row.
+enum HessianSchedule {STATIC, DYNAMIC};
+
 /** 
  * @class Optimizer
  *
@@ -34,7 +49,9 @@ public:
     
    Optimizer(Statistic & stat) : m_stat(&stat), 
                                  m_maxEval(100*m_stat->getNumParams()), 
-				 m_numericDeriv(false) {}
+				 m_numericDeriv(false),
+                                 m_hessianThreads(1),
+                                 m_hessianSchedule(DYNAMIC), m_observer(0) {}
 
    virtual ~Optimizer() {}
 
@@ -45,9 +62,15 @@ public:
    /// assuming that the statistic is a log-likelihood.
    virtual const std::vector<double> & getUncertainty(bool useBase=false);
 
-   /// Returns the covariance matrix
+   /// Returns the covariance matrix of the free parameters from the
+   /// last call to getUncertainty or, for Drmngb, Drmnfb and
+   /// ModNewton, from the last find_min that computed the
+   /// uncertainties.
    virtual std::vector<std::vector<double> > covarianceMatrix() const;
 
+   /// The same matrix in contiguous storage.
+   virtual CovarianceMatrix covariance() const;
+
    /// MINOS error analysis for parameter #n.  Valid only for the
    /// two flavors of Minuit.
    virtual std::pair<double,double> Minos(unsigned int n, double level=1., bool numericDeriv=false) {
@@ -55,6 +78,14 @@ public:
       return std::pair<double,double>(0., 0.);
    }
 
+   /// MINOS errors, as (lower, upper) pairs, for each parameter
+   /// number in pars, or for all of the free parameters if pars is
+   /// empty.  This implementation calls Minos for each in turn;
+   /// NewMinuit computes the errors concurrently if parallel is true.
+   virtual std::vector< std::pair<double, double> > 
+   MinosAll(const std::vector<unsigned int> & pars, double level=1., 
+            bool parallel=true);
+
    /// MINOS CONTOUR analysis for parameters #par1 et #par2.  Valid
    /// only for the two flavors of Minuit. Defaults must be set here
    /// in order for them to be propagated to the subclasses
@@ -64,6 +95,17 @@ public:
       throw Exception("MnContour function is not enabled for this optimizer");
       return ;
    }
+
+   /// MINOS contours for each pair of free parameter numbers at each
+   /// level, with npts points apiece, returned in the order
+   /// pairs[0] at each level, pairs[1] at each level, etc.  Valid
+   /// only for the two flavors of Minuit; NewMinuit computes the
+   /// points concurrently if parallel is true.
+   virtual std::vector<Contour> 
+   contours(const std::vector< std::pair<unsigned int, unsigned int> > &,
+            const std::vector<double> &, unsigned int=20, bool=true) {
+      throw Exception("contours are not enabled for this optimizer");
+   }
    
    virtual void setStrategy(unsigned int strat=1) {
       throw Exception("setStrategy is only enabled for Minuit and NewMinuit");
@@ -83,12 +125,73 @@ public:
       throw Exception("minos_lower_error is only enabled for NewMinuit");
    }
 
+   /// The Statistic being optimized (not the evaluation cache or
+   /// the instrumentation wrapper, if either is enabled).
    Statistic & stat() {
-      return *m_stat;
+      if (m_instrumented) {
+         return m_instrumented->wrapped();
+      }
+      return m_cache ? m_cache->wrapped() : *m_stat;
    }
 
    const Statistic & stat() const {
-      return *m_stat;
+      if (m_instrumented) {
+         return m_instrumented->wrapped();
+      }
+      return m_cache ? m_cache->wrapped() : *m_stat;
+   }
+
+   /// Evaluate the Statistic through a CachedStatistic that remembers
+   /// the last nentries points visited.  Zero disables the cache.
+   virtual void setEvaluationCache(unsigned int nentries);
+
+   /// The evaluation cache, for its hit and miss counts, or zero if
+   /// none is enabled.
+   const CachedStatistic * evaluationCache() const {
+      return m_cache.get();
+   }
+
+   CachedStatistic * evaluationCache() {
+      return m_cache.get();
+   }
+
+   /// Forget the points in the evaluation cache, if any, e.g., after
+   /// changing the Statistic's Parameters directly.  find_min does
+   /// this on entry.
+   void clearEvaluationCache() {
+      if (m_cache) {
+         m_cache->clear();
+      }
+   }
+
+   /// Record the number and time of the Statistic evaluations and
+   /// of the find_min, Hessian and MINOS phases.  With an evaluation
+   /// cache enabled, only the evaluations that miss the cache are
+   /// recorded.  Disabling discards the records.
+   void setInstrumentation(bool enable);
+
+   /// The records, or zero if instrumentation is disabled.
+   const Instrumentation * instrumentation() const {
+      return m_instruments.get();
+   }
+
+   /// Zero the records, e.g., between fits.
+   void resetInstrumentation() {
+      if (m_instruments) {
+         m_instruments->reset();
+      }
+   }
+
+   /// Report the starting point and each accepted step of find_min
+   /// to observer, which is not owned.  Zero disables the reports.
+   /// Minuit reports only the starting and final points, and
+   /// NewMinuit reports its iterations once migrad has finished.
+   void setObserver(IterationObserver * observer) {
+      m_observer = observer;
+   }
+
+   IterationObserver * observer() const {
+      return m_observer;
    }
 
    void setMaxEval(const int maxEval) {m_maxEval = maxEval;}
@@ -96,6 +199,18 @@ public:
    int getRetCode() const {return m_retCode;}
    bool getNumericDerivFlag() const { return m_numericDeriv; }
    void setNumericDerivFlag(bool val) { m_numericDeriv = val; }
+
+   /// Number of threads used to compute the finite-difference
+   /// Hessian for getUncertainty.  Each thread works on its own
+   /// clone of the Statistic.  Zero means one thread per hardware
+   /// core; the default of one thread uses the Statistic directly.
+   void setHessianThreads(unsigned int nthreads, 
+                          HessianSchedule schedule=DYNAMIC) {
+      m_hessianThreads = nthreads;
+      m_hessianSchedule = schedule;
+   }
+   unsigned int getHessianThreads() const {return m_hessianThreads;}
+   HessianSchedule getHessianSchedule() const {return m_hessianSchedule;}
   
    virtual std::ostream& put (std::ostream& s) const = 0;
    
@@ -109,26 +224,107 @@ protected:
    int m_maxEval;
    void setRetCode(const int & code) {m_retCode = code;}
 
+   /// For Instrumentation::Timer in the subclasses: zero if
+   /// instrumentation is disabled.
+   Instrumentation * instruments() const {
+      return m_instruments.get();
+   }
+
    /// A vector to contain the estimated uncertainties of the free 
    /// parameters.
    std::vector<double> m_uncertainty;
 
+   /// The covariance matrix that goes with m_uncertainty, or empty if
+   /// it was not formed.
+   CovarianceMatrix m_covariance;
+
+   /// Set m_covariance and m_uncertainty from the covariance matrix
+   /// packed as by dpptri.
+   void setPackedCovariance(int npars, const std::vector<double> & packed);
+
+   /// Start numbering the reported iterations from zero.
+   void beginIterations() {
+      m_iteration.iteration = 0;
+      m_iteration.params.clear();
+   }
+
+   /// Report a point to the observer, if there is one.  A point that
+   /// repeats the last one reported is skipped.
+   void notifyIteration(const std::vector<double> & params, double value,
+                        double gradNorm, double edm);
+
+   /// For the PORT drivers (Drmngb, Drmnfb): report the point from
+   /// which each new iteration starts, when iv shows that one has
+   /// begun.  niter holds the last iteration number seen.
+   void notifyPortIteration(const std::vector<int> & iv,
+                            const std::vector<double> & v,
+                            int & niter);
+
    /// @param hess The Hessian matrix for the free parameters.
    /// @param eps The fractional step size used for computing the
    ///        finite difference approximations to the partial second 
    ///        derivatives.
    void computeHessian(std::valarray<double> &hess, double eps = 1e-5);
 
+   /// The finite-difference steps for each free parameter: the
+   /// fraction eps of its value (eps if it is zero), reversed if
+   /// the step would cross a bound.
+   void hessianSteps(const std::vector<double> & params, double eps,
+                     std::vector<double> & deltas) const;
+
+   /// Fill hess, whose pattern is that of the Statistic, with one
+   /// gradient evaluation per group of columns, using the threads
+   /// set by setHessianThreads.
+   void computeSparseHessian(SparseHessian & hess, double eps=1e-5);
+
+   /// Compute one row of the finite-difference Hessian, stepping the
+   /// free parameter irow by delta.
+   static void hessianRow(Statistic & stat, 
+                          const std::vector<double> & params,
+                          size_t irow, double delta,
+                          const std::vector<double> & firstDerivs,
+                          double * row);
+
+   /// Compute all of the rows of the Hessian using nthreads threads,
+   /// each with its own clone of m_stat.
+   void computeHessianRows(std::valarray<double> & hess,
+                           const std::vector<double> & params,
+                           const std::vector<double> & deltas,
+                           const std::vector<double> & firstDerivs,
+                           unsigned int nthreads);
+
    /// @param hess Any symmetric, positive-definite square matrix.
    ///        On return, this matrix is replaced by the Cholesky 
    ///        decomposition and made fully symmetric.
    void choleskyDecompose(std::valarray<double> &hess);
 
+   /// @param hess The output of choleskyDecompose.  On return, it
+   ///        is replaced by the inverse of the original matrix.
+   void choleskyInvert(std::valarray<double> &hess);
+
 private:
 
    int m_retCode;
   
    bool m_numericDeriv;
+
+   unsigned int m_hessianThreads;
+
+   HessianSchedule m_hessianSchedule;
+
+   IterationObserver * m_observer;
+   IterationRecord m_iteration;
+   std::vector<double> m_portParams;
+
+   /// Shared by copies of the Optimizer, like m_stat itself.
+   std::shared_ptr<CachedStatistic> m_cache;
+
+   std::shared_ptr<Instrumentation> m_instruments;
+   std::shared_ptr<InstrumentedStatistic> m_instrumented;
+
+   /// The factored Hessian from getUncertainty for a Statistic with
+   /// a sparsity pattern, from which covarianceMatrix is formed.
+   std::shared_ptr<SparseHessian> m_sparseHessian;
    
 };
 
@@ -115,6 +115,10 @@ public:
    }
    std::pair<double, double> getBounds() const;
 
+   /// The bounds as an optimizer should apply them: bounds of (0, 0),
+   /// which setValue takes to mean unbounded, are (-inf, inf).
+   std::pair<double, double> effectiveBounds() const;
+
    /// free flag access
    virtual void setFree(bool free) {
       if (m_alwaysFixed) {
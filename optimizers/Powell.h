@@ -14,6 +14,15 @@ Warning: This does not implement bounds for the parameters.
 If a search ventures into non-phyisical realms of parameter space,
 there might be fatal math errors.
 
+With more than one thread (setThreads), each iteration starts with
+the line minimizations along all of the directions performed
+concurrently, each from the same point and on its own clone of the
+Statistic, followed by a line minimization along the sum of their
+steps.  When that gains too little, the iteration continues with a
+serial sweep, which also updates the direction set and is needed to
+converge.  The speedup is largest when the parameters are only
+weakly correlated.
+
  */
 
 #ifndef POWELL_H
@@ -27,7 +36,7 @@ namespace optimizers {
 
   class Powell : public Optimizer {
   public:
-    Powell(Statistic &stat) : Optimizer(stat) {}
+    Powell(Statistic &stat) : Optimizer(stat), m_nthreads(1) {}
     virtual ~Powell() {}
     virtual int find_min(int verbose=0, double tol=1e-8, int tolType=ABSOLUTE);
     virtual int find_min_only(int verbose=0, double tol=1e-8, int tolType=ABSOLUTE);
@@ -36,11 +45,25 @@ namespace optimizers {
     void set_xicom(const std::vector<double> &xi) {m_xicom = xi;}
     virtual std::ostream& put(std::ostream&) const;
     double value(std::vector<double> &pval);
+    /// Called by powell with the point reached after each set of
+    /// line minimizations, and its function value.
+    void acceptStep(const std::vector<double> &p, double fret);
+    /// Number of threads for the concurrent line minimizations.
+    /// The default of one runs the serial method; zero means one
+    /// per hardware core.
+    void setThreads(unsigned int nthreads) {m_nthreads = nthreads;}
+    unsigned int threads() const {return m_nthreads;}
   private:
     std::vector<double> m_pcom;
     std::vector<double> m_xicom;
+    std::vector<double> m_xt;
     int m_iter;
     double m_fret;
+    unsigned int m_nthreads;
+    int parallelPowell(std::vector<double> &p, 
+                       std::vector<std::vector<double> > &xi,
+                       const double ftol, int tolType, int maxit,
+                       unsigned int nthreads);
   };
 
   //! Functions lifted from Numerical Recipes, although with some modifications
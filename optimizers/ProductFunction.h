@@ -37,6 +37,11 @@ protected:
    void fetchDerivs(const Arg & x, 
                     std::vector<double> & derivs, bool getFree) const;
 
+   double derivByParamIndexImp(const Arg & x, unsigned int paramIndex) const;
+
+   double fetchValueAndDerivs(const Arg & x, std::vector<double> & derivs,
+                              bool getFree) const;
+
 };
 
 } // namespace optimizers
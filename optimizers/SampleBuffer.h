@@ -0,0 +1,107 @@
+/**
+ * @file SampleBuffer.h
+ * @brief Contiguous column-major storage for Mcmc samples.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#ifndef optimizers_SampleBuffer_h
+#define optimizers_SampleBuffer_h
+
+#include <vector>
+
+#include "optimizers/SampleSink.h"
+
+namespace optimizers {
+
+/**
+ * @class SampleBuffer
+ * @brief Stores samples as a structure of arrays: the values of each
+ * column (free Parameter or statistic value) are contiguous, with
+ * column j starting at data() + j*capacity().  Storage grows
+ * geometrically, so appending samples does not allocate per row once
+ * enough capacity has been reserved.
+ *
+ * $Header$
+ */
+
+class SampleBuffer : public SampleSink {
+
+public:
+
+   SampleBuffer(size_t ncols=0) : m_ncols(ncols), m_size(0), m_capacity(0) {}
+
+   /// Number of values in each sample.
+   size_t ncols() const {
+      return m_ncols;
+   }
+
+   /// Number of samples stored.
+   size_t size() const {
+      return m_size;
+   }
+
+   bool empty() const {
+      return m_size == 0;
+   }
+
+   /// Number of samples that can be stored without reallocation.
+   size_t capacity() const {
+      return m_capacity;
+   }
+
+   /// Change the number of columns.  Existing samples are discarded.
+   void setNcols(size_t ncols);
+
+   void reserve(size_t capacity);
+
+   /// New samples are zero-filled.
+   void resize(size_t size);
+
+   void clear() {
+      m_size = 0;
+   }
+
+   /// Value of column j for sample i.
+   double operator()(size_t i, size_t j) const {
+      return m_data[j*m_capacity + i];
+   }
+
+   double & operator()(size_t i, size_t j) {
+      return m_data[j*m_capacity + i];
+   }
+
+   /// Pointer to the size() contiguous values of column j.
+   const double * column(size_t j) const {
+      return m_data.empty() ? 0 : &m_data[0] + j*m_capacity;
+   }
+
+   double * column(size_t j) {
+      return m_data.empty() ? 0 : &m_data[0] + j*m_capacity;
+   }
+
+   /// Copy sample i into row, which is resized to ncols().
+   void getSample(size_t i, std::vector<double> & row) const;
+
+   /// Append a sample, setting the number of columns on first use.
+   virtual void write(const std::vector<double> & sample);
+
+   /// Append the samples, one vector per sample, to samples.
+   void appendTo(std::vector< std::vector<double> > & samples) const;
+
+private:
+
+   size_t m_ncols;
+
+   size_t m_size;
+
+   size_t m_capacity;
+
+   std::vector<double> m_data;
+
+};
+
+} // namespace optimizers
+
+#endif // optimizers_SampleBuffer_h
@@ -0,0 +1,65 @@
+/**
+ * @file SampleSink.h
+ * @brief Interface for consumers of Mcmc samples.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#ifndef optimizers_SampleSink_h
+#define optimizers_SampleSink_h
+
+#include <vector>
+
+namespace optimizers {
+
+/**
+ * @class SampleSink
+ * @brief Receives Mcmc samples one at a time as they are generated,
+ * so that chains need not be held in memory.  Each sample contains
+ * the free Parameter values followed by the statistic value.
+ *
+ * $Header$
+ */
+
+class SampleSink {
+
+public:
+
+   virtual ~SampleSink() {}
+
+   /// Consume one sample.
+   virtual void write(const std::vector<double> & sample) = 0;
+
+   /// Push any buffered samples to their destination.
+   virtual void flush() {}
+
+};
+
+/**
+ * @class VectorSampleSink
+ * @brief Appends samples to a vector of vectors.
+ *
+ * $Header$
+ */
+
+class VectorSampleSink : public SampleSink {
+
+public:
+
+   VectorSampleSink(std::vector< std::vector<double> > & samples)
+      : m_samples(samples) {}
+
+   virtual void write(const std::vector<double> & sample) {
+      m_samples.push_back(sample);
+   }
+
+private:
+
+   std::vector< std::vector<double> > & m_samples;
+
+};
+
+} // namespace optimizers
+
+#endif // optimizers_SampleSink_h
@@ -0,0 +1,84 @@
+/**
+ * @file Simplex.h
+ * @brief Nelder-Mead simplex Optimizer built on Amoeba.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#ifndef optimizers_Simplex_h
+#define optimizers_Simplex_h
+
+#include "optimizers/Optimizer.h"
+
+namespace optimizers {
+
+/**
+ * @class Simplex
+ *
+ * @brief Maximizes a Statistic with the Nelder-Mead simplex algorithm
+ * of Amoeba.  No derivatives are used.
+ *
+ * Bounded parameters are mapped onto unbounded internal variables, as
+ * in Minuit: x = lo + (hi - lo)*(sin(u) + 1)/2 for parameters with
+ * both bounds, and x = lo - 1 + sqrt(u*u + 1) or x = hi + 1 -
+ * sqrt(u*u + 1) for those with only one, so that every evaluation
+ * respects the bounds.  The initial simplex steps each internal
+ * variable by the fraction step of its value (or by step if it is
+ * zero).
+ *
+ * For ABSOLUTE tolerance, the fit converges once the values at the
+ * vertices of the simplex span less than tol; for RELATIVE, once
+ * that span is less than tol times the mean of their magnitudes.
+ * The evaluation budget is getMaxEval().  Only the starting and final
+ * points are reported to the IterationObserver.
+ *
+ * $Header$
+ */
+
+class Simplex : public Optimizer {
+
+public:
+
+   Simplex(Statistic & stat, double step=0.1)
+      : Optimizer(stat), m_step(step), m_nthreads(1), m_numEvals(0),
+        m_value(0) {}
+
+   virtual ~Simplex() {}
+
+   virtual int find_min(int verbose=0, double tol=1e-5,
+                        int tolType=ABSOLUTE);
+
+   virtual int find_min_only(int verbose=0, double tol=1e-5,
+                             int tolType=ABSOLUTE) {
+      return find_min(verbose, tol, tolType);
+   }
+
+   virtual std::ostream & put(std::ostream & s) const;
+
+   void setStep(double step) {m_step = step;}
+   double step() const {return m_step;}
+
+   /// Number of threads for Amoeba's concurrent evaluations, each
+   /// with its own clone of the Statistic.  Zero means one per
+   /// hardware core.
+   void setThreads(unsigned int nthreads) {m_nthreads = nthreads;}
+   unsigned int threads() const {return m_nthreads;}
+
+   /// Number of Statistic evaluations made by the last find_min.
+   int numEvals() const {return m_numEvals;}
+
+   enum SimplexReturnCodes {SIMPLEX_NORMAL, SIMPLEX_TOOMANY};
+
+private:
+
+   double m_step;
+   unsigned int m_nthreads;
+   int m_numEvals;
+   double m_value;
+
+};
+
+} // namespace optimizers
+
+#endif // optimizers_Simplex_h
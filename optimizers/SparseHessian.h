@@ -0,0 +1,138 @@
+/**
+ * @file SparseHessian.h
+ * @brief Symmetric matrix with a sparsity pattern, estimated from
+ * gradient differences and factored over its envelope.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#ifndef optimizers_SparseHessian_h
+#define optimizers_SparseHessian_h
+
+#include <vector>
+
+namespace optimizers {
+
+/**
+ * @class SparseHessian
+ *
+ * @brief A symmetric matrix, typically the Hessian of a Statistic
+ * wrt its free Parameters, whose nonzero elements lie in a given
+ * pattern.
+ *
+ * The columns are grouped as in Curtis, Powell & Reid 1974, J. Inst.
+ * Maths Applics, 13, 117, so that no two columns of a group have a
+ * nonzero element in the same row: stepping all of the parameters
+ * of a group at once, a single gradient difference gives all of
+ * their columns.  A banded matrix of bandwidth b needs 2b + 1 groups
+ * whatever its size.  A parameter coupled to all the others needs
+ * as many groups as there are columns, however.
+ *
+ * The Cholesky decomposition is done within the envelope (profile)
+ * of the rows, after a reverse Cuthill-McKee reordering if that
+ * reduces the envelope, since the fill-in is confined to it.  The
+ * diagonal of the inverse follows from the factor with the
+ * recurrences of Takahashi, Fagan & Chen 1973, without forming the
+ * rest of the inverse.
+ *
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+class SparseHessian {
+
+public:
+
+   /// @param pattern pattern[i] lists the columns j for which
+   ///        element (i, j) may be nonzero.  The pattern is made
+   ///        symmetric, and it always includes the diagonal.
+   SparseHessian(const std::vector< std::vector<size_t> > & pattern);
+
+   size_t size() const {
+      return m_adj.size();
+   }
+
+   /// Number of elements in the symmetric pattern.
+   size_t nonZeros() const;
+
+   /// Number of groups of columns, i.e., of gradient evaluations
+   /// (beyond the one at the reference point) needed to fill the
+   /// matrix.
+   size_t numGroups() const {
+      return m_groups.size();
+   }
+
+   /// The columns in group igroup.
+   const std::vector<size_t> & group(size_t igroup) const {
+      return m_groups[igroup];
+   }
+
+   /// Set the columns of group igroup from the change, diff, in the
+   /// gradient when each of its columns j is stepped by steps[j].
+   /// Each off-diagonal element is the mean of the values from its
+   /// row and its column.  Different groups may be set
+   /// concurrently.  Call choleskyDecompose again afterwards.
+   void setGroup(size_t igroup, const std::vector<double> & diff,
+                 const std::vector<double> & steps);
+
+   /// Element (i, j), which is zero outside of the pattern.
+   double operator()(size_t i, size_t j) const;
+
+   /// Factor the matrix as P A P^T = L L^T, with P the reordering.
+   /// Throws an Exception if it is not positive definite.
+   void choleskyDecompose();
+
+   /// Number of elements of L stored within the envelope.
+   size_t envelopeSize() const {
+      return m_env.size();
+   }
+
+   /// Overwrite b with the solution of A x = b, after
+   /// choleskyDecompose.
+   void solve(std::vector<double> & b) const;
+
+   /// The diagonal of the inverse, after choleskyDecompose.
+   void inverseDiagonal(std::vector<double> & diag) const;
+
+private:
+
+   /// The sorted columns of the pattern in each row, and the
+   /// estimates of the elements (adj[j][k], j) from column j.
+   std::vector< std::vector<size_t> > m_adj;
+   std::vector< std::vector<double> > m_est;
+
+   std::vector< std::vector<size_t> > m_groups;
+
+   /// m_perm[i] is the original index of row i of L; m_iperm is its
+   /// inverse.
+   std::vector<size_t> m_perm;
+   std::vector<size_t> m_iperm;
+
+   /// Row i of L holds columns m_first[i] through i, stored from
+   /// m_env[m_rowStart[i]].
+   std::vector<size_t> m_first;
+   std::vector<size_t> m_rowStart;
+   std::vector<double> m_env;
+   bool m_factored;
+
+   void colorColumns();
+
+   void order();
+
+   size_t envelope(const std::vector<size_t> & iperm) const;
+
+   double & env(size_t i, size_t j) {
+      return m_env[m_rowStart[i] + j - m_first[i]];
+   }
+
+   const double & env(size_t i, size_t j) const {
+      return m_env[m_rowStart[i] + j - m_first[i]];
+   }
+
+};
+
+} // namespace optimizers
+
+#endif // optimizers_SparseHessian_h
@@ -23,6 +23,10 @@ namespace optimizers {
  * convenient interface to use as objective functions, which take no
  * arguments.
  *
+ * As for any Function, value() and the derivative methods may use
+ * scratch buffers of the Statistic and of its model Functions, so
+ * concurrent evaluations need one clone per thread.
+ *
  */
 
 class Statistic : public Function {
@@ -39,6 +43,28 @@ public:
 
    virtual void getFreeDerivs(std::vector<double> &derivs) const = 0;
 
+   /// Set the free Parameter values and compute the Statistic value
+   /// and its derivatives wrt the free Parameters at that point.
+   /// Subclasses that can share work between value() and
+   /// getFreeDerivs() should override this.
+   virtual void valueAndFreeDerivs(const std::vector<double> & x,
+                                   double & f, std::vector<double> & g) {
+      setFreeParamValues(x);
+      f = value();
+      getFreeDerivs(g);
+   }
+
+   /// The sparsity pattern of the Hessian wrt the free Parameters:
+   /// pattern[i] lists the free Parameters j for which the second
+   /// derivative wrt i and j may be nonzero.  Returns false, as here,
+   /// if the Hessian should be treated as dense.  Optimizer uses the
+   /// pattern to compute the Hessian with fewer gradient evaluations.
+   virtual bool getFreeHessianPattern(
+      std::vector< std::vector<size_t> > & pattern) const {
+      (void)(pattern);
+      return false;
+   }
+
 protected:
 
    Statistic() : Function("Statistic", 0, "", "", None) {}
@@ -0,0 +1,149 @@
+/**
+ * @file StatisticDecorator.h
+ * @brief Declaration of a base class for Statistics that wrap another
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#ifndef optimizers_StatisticDecorator_h
+#define optimizers_StatisticDecorator_h
+
+#include <string>
+#include <vector>
+
+#include "optimizers/Statistic.h"
+
+namespace optimizers {
+
+/**
+ * @class StatisticDecorator
+ *
+ * @brief Wraps a Statistic and forwards all of the evaluations and
+ * Parameter accesses to it.  Subclasses override the calls they
+ * modify, e.g., to cache or time them.  Parameter values are read
+ * from and written to the wrapped Statistic; this object's own
+ * copies of the Parameters are refreshed from it whenever they are
+ * set through here.
+ *
+ */
+
+class StatisticDecorator : public Statistic {
+
+public:
+
+   StatisticDecorator(const std::string & genericName, Statistic & stat);
+
+   /// Copies own a clone of the wrapped Statistic, so that they may
+   /// be evaluated independently.
+   StatisticDecorator(const StatisticDecorator & rhs);
+
+   virtual ~StatisticDecorator();
+
+   virtual double value() const {
+      return m_stat->value();
+   }
+
+   virtual void getFreeDerivs(std::vector<double> & derivs) const {
+      m_stat->getFreeDerivs(derivs);
+   }
+
+   virtual void getFreeDerivs(const Arg &, std::vector<double> & derivs) const {
+      getFreeDerivs(derivs);
+   }
+
+   virtual void valueAndFreeDerivs(const std::vector<double> & x,
+                                   double & f, std::vector<double> & g) {
+      m_stat->valueAndFreeDerivs(x, f, g);
+   }
+
+   virtual void setParam(const std::string & paramName, double paramValue);
+
+   virtual void setParam(const Parameter & param);
+
+   virtual double getParamValue(const std::string & paramName) const {
+      return m_stat->getParamValue(paramName);
+   }
+
+   virtual const Parameter & getParam(const std::string & paramName) const {
+      return m_stat->getParam(paramName);
+   }
+
+   virtual std::vector<double>::const_iterator setParamValues_(
+      std::vector<double>::const_iterator it);
+
+   virtual void setParams(const std::vector<Parameter> & params);
+
+   virtual unsigned int getNumFreeParams() const {
+      return m_stat->getNumFreeParams();
+   }
+
+   virtual std::vector<double>::const_iterator setFreeParamValues_(
+      std::vector<double>::const_iterator it);
+
+   virtual void getFreeParams(std::vector<Parameter> & params) const {
+      m_stat->getFreeParams(params);
+   }
+
+   virtual bool getFreeHessianPattern(
+      std::vector< std::vector<size_t> > & pattern) const {
+      return m_stat->getFreeHessianPattern(pattern);
+   }
+
+   /// The Statistic being wrapped.
+   Statistic & wrapped() {
+      return *m_stat;
+   }
+
+   const Statistic & wrapped() const {
+      return *m_stat;
+   }
+
+   /// The Statistic at the bottom of a chain of decorators.
+   const Statistic & innermost() const;
+
+protected:
+
+   Statistic * m_stat;
+
+   /// Called after the Parameters of the wrapped Statistic have been
+   /// set through setParam, setParams or setParamValues_.  Refreshes
+   /// this object's copies of them.
+   virtual void paramsChanged();
+
+   virtual double value(const Arg &) const {
+      return value();
+   }
+
+   virtual double derivByParamImp(const Arg & x,
+                                  const std::string & paramName) const {
+      return m_stat->derivByParam(x, paramName);
+   }
+
+   virtual double derivByParamIndexImp(const Arg & x,
+                                       unsigned int paramIndex) const {
+      return m_stat->derivByParamIndex(x, paramIndex);
+   }
+
+   virtual void fetchParamValues(std::vector<double> & values,
+                                 bool getFree) const;
+
+   virtual void fetchDerivs(const Arg & x, std::vector<double> & derivs,
+                            bool getFree) const;
+
+   virtual double fetchValueAndDerivs(const Arg & x,
+                                      std::vector<double> & derivs,
+                                      bool getFree) const;
+
+private:
+
+   bool m_own_stat;
+
+   // Disable assignment.
+   StatisticDecorator & operator=(const StatisticDecorator &);
+
+};
+
+} // namespace optimizers
+
+#endif // optimizers_StatisticDecorator_h
@@ -0,0 +1,97 @@
+/**
+ * @file TraceWriter.h
+ * @brief An IterationObserver that writes the iteration history to a
+ * compact binary file.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#ifndef optimizers_TraceWriter_h
+#define optimizers_TraceWriter_h
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "optimizers/IterationObserver.h"
+
+namespace optimizers {
+
+/**
+ * @class TraceWriter
+ *
+ * @brief Writes each IterationRecord as raw doubles, without any
+ * text formatting, so that the trace can be recorded in the inner
+ * loop of a fit and analyzed offline.
+ *
+ * The file starts with a 16 byte header: the characters "OPTTRACE",
+ * a 32-bit format version (1) and the 32-bit number of free
+ * Parameters, npar.  Each record that follows is 6 + npar native
+ * doubles: the iteration number, the Statistic value, the gradient
+ * norm, the step length, the EDM, the wall time in seconds since the
+ * start of the find_min call (i.e., since the last record with
+ * iteration 0), and the Parameter values.  With numpy, for example,
+ *
+ *    numpy.fromfile(file, dtype='f8', offset=16).reshape(-1, 6 + npar)
+ *
+ * Several fits may be traced to the same file, provided they have
+ * the same number of free Parameters.
+ *
+ * $Header$
+ */
+
+class TraceWriter : public IterationObserver {
+
+public:
+
+   /// @param filename The output file, which is overwritten.
+   /// @param blockSize The number of records to buffer before writing.
+   TraceWriter(const std::string & filename, size_t blockSize=256);
+
+   virtual ~TraceWriter() throw();
+
+   virtual void update(const IterationRecord & record);
+
+   /// Write any buffered records.
+   void flush();
+
+   /// Flush and close the file.  Further records are ignored.
+   void close();
+
+   size_t nrecords() const {
+      return m_nrecords;
+   }
+
+   /// Read all of the records in a trace file, one vector of
+   /// 6 + npar values per record.
+   static void read(const std::string & filename,
+                    std::vector< std::vector<double> > & records,
+                    unsigned int & npar);
+
+   static const unsigned int s_version = 1;
+
+   static const unsigned int s_nfields = 6;
+
+private:
+
+   std::string m_filename;
+   std::ofstream m_file;
+   size_t m_blockSize;
+   int m_npar;
+   size_t m_nrecords;
+   std::vector<double> m_buffer;
+   std::chrono::steady_clock::time_point m_start;
+
+   void writeHeader(unsigned int npar);
+
+   // Disable copying.
+   TraceWriter(const TraceWriter &);
+   TraceWriter & operator=(const TraceWriter &);
+
+};
+
+} // namespace optimizers
+
+#endif // optimizers_TraceWriter_h
@@ -2,22 +2,36 @@
 %module optimizers
 %{
 #include "../optimizers/Arg.h"
+#include "../optimizers/CachedStatistic.h"
 #include "../optimizers/CompositeFunction.h"
+#include "../optimizers/Contour.h"
+#include "../optimizers/CovarianceMatrix.h"
 #include "../optimizers/Drmngb.h"
 #include "../optimizers/Exception.h"
+#include "../optimizers/FitsSampleSink.h"
 #include "../optimizers/Function.h"
 #include "../optimizers/FunctionTest.h"
 #include "../optimizers/FunctionFactory.h"
+#include "../optimizers/Instrumentation.h"
+#include "../optimizers/InstrumentedStatistic.h"
+#include "../optimizers/IterationObserver.h"
 #include "../optimizers/Lbfgs.h"
+#include "../optimizers/LbfgsB.h"
 #include "../optimizers/Mcmc.h"
 #include "../optimizers/Minuit.h"
+#include "../optimizers/MultiStart.h"
 #include "../optimizers/Optimizer.h"
 #include "../optimizers/OutOfBounds.h"
 #include "../optimizers/Parameter.h"
 #include "../optimizers/ParameterNotFound.h"
 #include "../optimizers/ProductFunction.h"
+#include "../optimizers/SampleBuffer.h"
+#include "../optimizers/Simplex.h"
+#include "../optimizers/SampleSink.h"
 #include "../optimizers/Statistic.h"
+#include "../optimizers/StatisticDecorator.h"
 #include "../optimizers/SumFunction.h"
+#include "../optimizers/TraceWriter.h"
 #include "../optimizers/dArg.h"
 #include "../src/AbsEdge.h"
 #include "../src/Gaussian.h"
@@ -41,11 +55,45 @@
 %include ../optimizers/SumFunction.h
 %include ../optimizers/FunctionTest.h
 %include ../optimizers/Statistic.h
+%include ../optimizers/StatisticDecorator.h
+%include ../optimizers/CachedStatistic.h
+%include ../optimizers/Instrumentation.h
+%include ../optimizers/InstrumentedStatistic.h
+%include ../optimizers/SampleSink.h
+%include ../optimizers/FitsSampleSink.h
+%include ../optimizers/SampleBuffer.h
+%extend optimizers::SampleBuffer {
+// Zero-copy view of column j as a memoryview of doubles, e.g., for
+// numpy.asarray.  The view is only valid while the buffer is alive
+// and is not resized.
+   PyObject * columnView(size_t j) {
+      if (j >= self->ncols()) {
+         PyErr_SetString(PyExc_IndexError, "column index out of range");
+         return NULL;
+      }
+      PyObject * bytes 
+         = PyMemoryView_FromMemory(reinterpret_cast<char *>(self->column(j)),
+                                   self->size()*sizeof(double), PyBUF_WRITE);
+      if (bytes == NULL) {
+         return NULL;
+      }
+      PyObject * view = PyObject_CallMethod(bytes, "cast", "s", "d");
+      Py_DECREF(bytes);
+      return view;
+   }
+}
 %include ../optimizers/Mcmc.h
+%include ../optimizers/Contour.h
+%include ../optimizers/CovarianceMatrix.h
+%include ../optimizers/IterationObserver.h
+%include ../optimizers/TraceWriter.h
 %include ../optimizers/Optimizer.h
 %include ../optimizers/Lbfgs.h
+%include ../optimizers/LbfgsB.h
 %include ../optimizers/Minuit.h
 %include ../optimizers/Drmngb.h
+%include ../optimizers/MultiStart.h
+%include ../optimizers/Simplex.h
 %include ../src/AbsEdge.h
 %include ../src/Gaussian.h
 %include ../src/MyFun.h
@@ -54,6 +102,8 @@
 %include ../src/Rosen.h
 %include ../optimizers/FunctionFactory.h
 %template(DoubleVector) std::vector<double>;
+%template(ULongVector) std::vector<unsigned long>;
 %template(DoubleVectorVector) std::vector< std::vector<double> >;
 %template(StringVector) std::vector<std::string>;
 %template(ParameterVector) std::vector<optimizers::Parameter>;
+%template(ContourVector) std::vector<optimizers::Contour>;
@@ -31,8 +31,7 @@ double AbsEdge::value(const Arg & xarg) const {
 
    enum ParamTypes {Tau0, E0, Index};
 
-   std::vector<Parameter> my_params;
-   getParams(my_params);
+   const std::vector<Parameter> & my_params(m_parameter);
 
    if (x < my_params[E0].getTrueValue()) {
       return 1;
@@ -44,21 +43,16 @@ double AbsEdge::value(const Arg & xarg) const {
 
 double AbsEdge::derivByParamImp(const Arg & xarg, 
                                 const std::string & paramName) const {
+   return derivByParamIndexImp(xarg, parameterIndex(paramName));
+}
+
+double AbsEdge::derivByParamIndexImp(const Arg & xarg,
+                                     unsigned int iparam) const {
    double x = dynamic_cast<const dArg &>(xarg).getValue();
 
    enum ParamTypes {Tau0, E0, Index};
 
-   std::vector<Parameter> my_params;
-   getParams(my_params);
-
-   int iparam = -1;
-   for (unsigned int i = 0; i < my_params.size(); i++) {
-      if (paramName == my_params[i].getName()) iparam = i;
-   }
-
-   if (iparam == -1) {
-      throw ParameterNotFound(paramName, getName(), "AbsEdge::derivByParam");
-   }
+   const std::vector<Parameter> & my_params(m_parameter);
 
    if (x > my_params[E0].getTrueValue()) {
       double my_value;
@@ -85,4 +79,63 @@ double AbsEdge::derivByParamImp(const Arg & xarg,
    return 0;
 }
 
+void AbsEdge::valuesImp(const double * x, double * out, size_t n) const {
+   enum ParamTypes {Tau0, E0, Index};
+
+   double tau0 = m_parameter[Tau0].getTrueValue();
+   double e0 = m_parameter[E0].getTrueValue();
+   double index = m_parameter[Index].getTrueValue();
+
+   for (size_t i = 0; i < n; i++) {
+      out[i] = x[i] < e0 ? 1 : exp(-tau0*pow(x[i]/e0, index));
+   }
+}
+
+void AbsEdge::derivsImp(const double * x, double * out, size_t n,
+                        bool getFree) const {
+   enum ParamTypes {Tau0, E0, Index};
+
+   double tau0 = m_parameter[Tau0].getTrueValue();
+   double e0 = m_parameter[E0].getTrueValue();
+   double index = m_parameter[Index].getTrueValue();
+
+// Product of the optical depth and the transmission above the edge,
+// and zero at or below it.
+   std::vector<double> & tau_trans(m_tauTrans);
+   tau_trans.assign(n, 0);
+   for (size_t i = 0; i < n; i++) {
+      if (x[i] > e0) {
+         double tau = tau0*pow(x[i]/e0, index);
+         tau_trans[i] = tau*exp(-tau);
+      }
+   }
+
+   for (unsigned int iparam = 0; iparam < m_parameter.size(); iparam++) {
+      if (getFree && !m_parameter[iparam].isFree()) {
+         continue;
+      }
+      double scale = m_parameter[iparam].getScale();
+      switch (iparam) {
+      case Tau0:
+         for (size_t i = 0; i < n; i++) {
+            out[i] = -tau_trans[i]/tau0*scale;
+         }
+         break;
+      case E0:
+         for (size_t i = 0; i < n; i++) {
+            out[i] = tau_trans[i]*index/e0*scale;
+         }
+         break;
+      case Index:
+         for (size_t i = 0; i < n; i++) {
+            out[i] = x[i] > e0 ? -tau_trans[i]*log(x[i]/e0)*scale : 0;
+         }
+         break;
+      default:
+         break;
+      }
+      out += n;
+   }
+}
+
 } // namespace optimizers
@@ -39,6 +39,19 @@ protected:
    double derivByParamImp(const Arg & xarg,
                           const std::string & paramName) const;
 
+   double derivByParamIndexImp(const Arg & xarg,
+                               unsigned int paramIndex) const;
+
+   void valuesImp(const double * x, double * out, size_t n) const;
+
+   void derivsImp(const double * x, double * out, size_t n,
+                  bool getFree) const;
+
+private:
+
+   /// Scratch space for derivsImp.
+   mutable std::vector<double> m_tauTrans;
+
 };
 
 } // namespace optimizers
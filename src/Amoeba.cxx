@@ -1,4 +1,4 @@
-/** 
+/**
  * @file Amoeba.cxx
  * @brief Use Nelder-Mead to minimize a function object.
  * @author J. Chiang
@@ -8,131 +8,306 @@
 
 #include <cmath>
 
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
 
 #include "optimizers/Amoeba.h"
+#include "optimizers/Exception.h"
+
+#include "Parallel.h"
 
 namespace {
 
-void print_p(const std::vector< std::vector<double> > & p, 
-             const std::vector<double> & yvals) {
-   for (size_t i(0); i < p.size(); i++) {
-      for (size_t j(0); j < p.at(i).size(); j++) {
-//         std::cout << p.at(i).at(j) << "  ";
+/**
+ * @class Evaluator
+ *
+ * @brief Evaluates the functor at a batch of points.  With more than
+ * one thread, the calling thread and a pool of workers, each with its
+ * own clone of the functor, share the points of each batch.  The
+ * workers wait between batches, so that the threads are created once
+ * per minimization rather than once per step.
+ */
+
+class Evaluator {
+
+public:
+
+   Evaluator(optimizers::Functor & func, size_t ndim, unsigned int nthreads);
+
+   ~Evaluator();
+
+   /// values[k] = func(points[k*ndim], ..., points[k*ndim + ndim - 1])
+   void operator()(const double * points, size_t npoints, double * values);
+
+   int nevals() const {
+      return m_nevals;
+   }
+
+private:
+
+   optimizers::Functor & m_func;
+   size_t m_ndim;
+   int m_nevals;
+
+   std::vector< std::unique_ptr<optimizers::Functor> > m_clones;
+   std::vector< std::vector<double> > m_x;
+   std::vector<std::thread> m_threads;
+
+   std::mutex m_mutex;
+   std::condition_variable m_start;
+   std::condition_variable m_done;
+   unsigned long m_batch;
+   unsigned int m_busy;
+   bool m_stop;
+
+   const double * m_points;
+   size_t m_npoints;
+   double * m_values;
+   std::atomic<size_t> m_next;
+   std::exception_ptr m_failure;
+
+   void work(unsigned int ithread);
+   void evaluateShare(unsigned int ithread);
+
+};
+
+Evaluator::Evaluator(optimizers::Functor & func, size_t ndim,
+                     unsigned int nthreads)
+   : m_func(func), m_ndim(ndim), m_nevals(0), m_x(nthreads),
+     m_batch(0), m_busy(0), m_stop(false), m_points(0), m_npoints(0),
+     m_values(0), m_next(0) {
+   for (unsigned int ithread = 1; ithread < nthreads; ithread++) {
+      optimizers::Functor * clone(func.clone());
+      if (clone == 0) {
+         throw optimizers::Exception("Amoeba: evaluating with more than "
+                                     "one thread needs Functor::clone.");
+      }
+      m_clones.push_back(std::unique_ptr<optimizers::Functor>(clone));
+   }
+   for (unsigned int ithread = 1; ithread < nthreads; ithread++) {
+      m_threads.push_back(std::thread(&Evaluator::work, this, ithread));
+   }
+}
+
+Evaluator::~Evaluator() {
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+   }
+   m_start.notify_all();
+   for (size_t i = 0; i < m_threads.size(); i++) {
+      m_threads[i].join();
+   }
+}
+
+void Evaluator::operator()(const double * points, size_t npoints,
+                           double * values) {
+   m_nevals += npoints;
+   m_points = points;
+   m_npoints = npoints;
+   m_values = values;
+   m_next = 0;
+   if (m_threads.empty() || npoints == 1) {
+      evaluateShare(0);
+   } else {
+      {
+         std::lock_guard<std::mutex> lock(m_mutex);
+         m_busy = m_threads.size();
+         m_batch++;
+      }
+      m_start.notify_all();
+      evaluateShare(0);
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_done.wait(lock, [this]() {return m_busy == 0;});
+   }
+   if (m_failure) {
+      std::exception_ptr failure(m_failure);
+      m_failure = std::exception_ptr();
+      std::rethrow_exception(failure);
+   }
+}
+
+void Evaluator::work(unsigned int ithread) {
+   unsigned long batch(0);
+   while (true) {
+      {
+         std::unique_lock<std::mutex> lock(m_mutex);
+         m_start.wait(lock, [&]() {return m_stop || m_batch != batch;});
+         if (m_stop) {
+            return;
          }
-//      std::cout << yvals.at(i) << ";  ";
+         batch = m_batch;
+      }
+      evaluateShare(ithread);
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (--m_busy == 0) {
+         m_done.notify_one();
+      }
    }
-//   std::cout << std::endl;
 }
 
-double amotry(std::vector< std::vector<double> > & p,
-              std::vector<double> & y,
-              std::vector<double> & psum,
-              int ndim, optimizers::Functor & func, int ihi, double fac) {
-   std::vector<double> ptry(ndim, 0);
-   double fac1((1. - fac)/float(ndim));
-   double fac2(fac1 - fac);
-   for (int j = 0; j < ndim; j++) {
-      ptry.at(j) = psum.at(j)*fac1 - p.at(ihi).at(j)*fac2;
-   }
-   double ytry(func(ptry));
-   if (ytry < y.at(ihi)) {
-      y.at(ihi) = ytry;
-      for (int j = 0; j < ndim; j++) {
-         psum.at(j) += ptry.at(j) - p.at(ihi).at(j);
-         p.at(ihi).at(j) = ptry.at(j);
-      }
-   }
-   print_p(p, y);
-   return ytry;
+void Evaluator::evaluateShare(unsigned int ithread) {
+   optimizers::Functor & func(ithread == 0 ? m_func : *m_clones[ithread - 1]);
+   std::vector<double> & x(m_x[ithread]);
+   size_t k;
+   while ((k = m_next++) < m_npoints) {
+      try {
+         x.assign(m_points + k*m_ndim, m_points + (k + 1)*m_ndim);
+         m_values[k] = func(x);
+      } catch (...) {
+         std::lock_guard<std::mutex> lock(m_mutex);
+         if (!m_failure) {
+            m_failure = std::current_exception();
+         }
+         m_next = m_npoints;
+      }
+   }
 }
 
-void swap(double & a, double & b) {
-   double tmp(a);
-   a = b;
-   b = tmp;
+/// Replace vertex ihi of the simplex p with ptry, updating the vertex
+/// sums psum.
+void replaceVertex(std::vector<double> & p, std::vector<double> & y,
+                   std::vector<double> & psum, size_t ndim, size_t ihi,
+                   const double * ptry, double ytry) {
+   double * vertex(&p[ihi*ndim]);
+   y[ihi] = ytry;
+   for (size_t j = 0; j < ndim; j++) {
+      psum[j] += ptry[j] - vertex[j];
+      vertex[j] = ptry[j];
+   }
 }
 
-void amoeba(std::vector< std::vector<double> > & p,
-            std::vector<double> & y, int ndim, double ftol,
-            optimizers::Functor & func, int & nfunc,
-            bool abstol=true) {
-   static int nmax(5000);
-   int mpts(ndim + 1);
+void amoeba(std::vector<double> & p, std::vector<double> & y,
+            size_t ndim, double ftol, Evaluator & func, int nmax,
+            bool speculate, bool abstol=true) {
+   size_t mpts(ndim + 1);
    std::vector<double> psum(ndim, 0);
-   nfunc = 0;
-   for (int j = 0; j < ndim; j++) {
-      double sum(0);
-      for (int i = 0; i < mpts; i++) {
-         sum += p.at(i).at(j);
+   for (size_t i = 0; i < mpts; i++) {
+      for (size_t j = 0; j < ndim; j++) {
+         psum[j] += p[i*ndim + j];
       }
-      psum.at(j) = sum;
    }
+
+// The trial points of each step, as in NR amotry: the reflection
+// of the worst vertex through the centroid of the others, the
+// expansion beyond the reflection, and the contractions towards the
+// centroid from the reflection and from the worst vertex.
+   enum {REFLECT, EXPAND, CONTRACT_OUT, CONTRACT_IN, NTRIALS};
+   const double facs[NTRIALS] = {-1., -2., -0.5, 0.5};
+   std::vector<double> ptry(NTRIALS*ndim);
+   double ytry[NTRIALS];
+   bool evaluated[NTRIALS];
+   std::vector<double> centroid(ndim);
+   std::vector<double> shrunk(ndim*ndim);
+   std::vector<double> yshrunk(ndim);
+
    while(true) {
-      int ilo(0);
-      int inhi;
-      int ihi = y.at(0) > y.at(1) ? (inhi=1,0) : (inhi=0,1);
-      for (int i = 0; i < mpts; i++) {
-         if (y.at(i) <= y.at(ilo)) {
+      size_t ilo(0);
+      size_t inhi;
+      size_t ihi = y[0] > y[1] ? (inhi=1,0) : (inhi=0,1);
+      for (size_t i = 0; i < mpts; i++) {
+         if (y[i] <= y[ilo]) {
             ilo = i;
          }
-         if (y.at(i) > y.at(ihi)) {
+         if (y[i] > y[ihi]) {
             inhi = ihi;
             ihi = i;
-         } else if (y.at(i) > y.at(inhi) && i != ihi) {
+         } else if (y[i] > y[inhi] && i != ihi) {
             inhi = i;
          }
       }
-      double num(2.0*std::fabs(y.at(ihi) - y.at(ilo)));
-      double denom(std::fabs(y.at(ihi)) + std::fabs(y.at(ilo)));
+      double num(2.0*std::fabs(y[ihi] - y[ilo]));
+      double denom(std::fabs(y[ihi]) + std::fabs(y[ilo]));
       double rtol;
-//       std::cout << "num = " << num << "  "
-//                 << "denom = " << denom << "  ";
       if (abstol || denom == 0) {  /// treat the tolerance as absolute
          rtol = num/2.;
       } else {
          rtol = num/denom;
       }
-//      std::cout << "rtol = " << rtol << std::endl;
       if (rtol < ftol) {
-         swap(y.at(0), y.at(ilo));
-         for (int i = 0; i < ndim; i++) {
-            swap(p.at(0).at(i), p.at(ilo).at(i));
+         std::swap(y[0], y[ilo]);
+         for (size_t j = 0; j < ndim; j++) {
+            std::swap(p[j], p[ilo*ndim + j]);
          }
          break;
       }
-      if (nfunc >= nmax) {
+      if (func.nevals() >= nmax) {
          throw std::runtime_error("amoeba: nmax exceeded");
       }
-      nfunc += 2;
-      double ytry(amotry(p, y, psum, ndim, func, ihi, -1.0));
-      if (ytry <= y.at(ilo)) {
-         ytry = amotry(p, y, psum, ndim, func, ihi, 2.0);
-      } else if (ytry >= y.at(inhi)) {
-         double ysave(y.at(ihi));
-         ytry = amotry(p, y, psum, ndim, func, ihi, 0.5);
-         if (ytry >= ysave) {
-            for (int i = 0; i < mpts; i++) {
+      const double * worst(&p[ihi*ndim]);
+      for (size_t j = 0; j < ndim; j++) {
+         centroid[j] = (psum[j] - worst[j])/ndim;
+      }
+      for (size_t k = 0; k < NTRIALS; k++) {
+         for (size_t j = 0; j < ndim; j++) {
+            ptry[k*ndim + j] = centroid[j] + facs[k]*(worst[j] - centroid[j]);
+         }
+         evaluated[k] = speculate;
+      }
+      if (speculate) {
+         func(&ptry[0], NTRIALS, ytry);
+      }
+      auto trial = [&](size_t k) {
+         if (!evaluated[k]) {
+            func(&ptry[k*ndim], 1, &ytry[k]);
+            evaluated[k] = true;
+         }
+         return ytry[k];
+      };
+      bool reflected(false);
+      if (trial(REFLECT) < y[ihi]) {
+         replaceVertex(p, y, psum, ndim, ihi, &ptry[REFLECT*ndim],
+                       ytry[REFLECT]);
+         reflected = true;
+      }
+      if (ytry[REFLECT] <= y[ilo]) {
+         if (trial(EXPAND) < y[ihi]) {
+            replaceVertex(p, y, psum, ndim, ihi, &ptry[EXPAND*ndim],
+                          ytry[EXPAND]);
+         }
+      } else if (ytry[REFLECT] >= y[inhi]) {
+         double ysave(y[ihi]);
+         size_t contract(reflected ? CONTRACT_OUT : CONTRACT_IN);
+         if (trial(contract) < y[ihi]) {
+            replaceVertex(p, y, psum, ndim, ihi, &ptry[contract*ndim],
+                          ytry[contract]);
+         }
+         if (ytry[contract] >= ysave) {
+// Shrink the simplex towards the best vertex.
+            const double * best(&p[ilo*ndim]);
+            size_t k(0);
+            for (size_t i = 0; i < mpts; i++) {
+               if (i != ilo) {
+                  for (size_t j = 0; j < ndim; j++) {
+                     shrunk[k*ndim + j] = 0.5*(p[i*ndim + j] + best[j]);
+                  }
+                  k++;
+               }
+            }
+            func(&shrunk[0], ndim, &yshrunk[0]);
+            k = 0;
+            for (size_t i = 0; i < mpts; i++) {
                if (i != ilo) {
-                  for (int j = 0; j < ndim; j++) {
-                     p.at(i).at(j) = psum.at(j) = 
-                        0.5*(p.at(i).at(j) + p.at(ilo).at(j));
+                  for (size_t j = 0; j < ndim; j++) {
+                     p[i*ndim + j] = shrunk[k*ndim + j];
                   }
-                  y.at(i) = func(psum);
+                  y[i] = yshrunk[k];
+                  k++;
                }
             }
-            print_p(p, y);
-            nfunc += ndim;
-            for (int j = 0; j < ndim; j++) {
+            for (size_t j = 0; j < ndim; j++) {
                double sum(0);
-               for (int i = 0; i < mpts; i++) {
-                  sum += p.at(i).at(j);
+               for (size_t i = 0; i < mpts; i++) {
+                  sum += p[i*ndim + j];
                }
-               psum.at(j) = sum;
+               psum[j] = sum;
             }
-         } else {
-            --nfunc;
          }
       }
    }
@@ -143,34 +318,50 @@ void amoeba(std::vector< std::vector<double> > & p,
 namespace optimizers {
 
 double Amoeba::findMin(std::vector<double> & params, double tol, bool abstol) {
-   std::vector<double> yvalues;
-   yvalues.reserve(m_npars + 1);
-   for (size_t i = 0; i < m_npars + 1; i++) {
-      double yval(m_functor(m_simplex.at(i)));
-      yvalues.push_back(yval);
-   }
-   int nevals(0);
-   ::amoeba(m_simplex, yvalues, m_npars, tol, m_functor, nevals, abstol);
-   int imin(0);
-   double ymin(yvalues.at(imin));
-   for (size_t i = 1; i < m_npars + 1; i++) {
-      if (yvalues.at(i) < ymin) {
+   size_t mpts(m_npars + 1);
+// A step evaluates at most four trial points, or m_npars shrunken
+// vertices, at a time.
+   unsigned int nthreads(numThreads(std::max<size_t>(4, m_npars),
+                                    m_nthreads));
+   Evaluator func(m_functor, m_npars, nthreads);
+   m_values.resize(mpts);
+   func(&m_simplex[0], mpts, &m_values[0]);
+   try {
+      ::amoeba(m_simplex, m_values, m_npars, tol, func, m_maxEval,
+               nthreads > 1, abstol);
+   } catch (...) {
+      m_nevals = func.nevals();
+      throw;
+   }
+   m_nevals = func.nevals();
+   return bestVertex(params);
+}
+
+double Amoeba::bestVertex(std::vector<double> & params) const {
+   if (m_values.empty()) {
+      throw Exception("Amoeba::bestVertex: findMin has not been run.");
+   }
+   size_t imin(0);
+   double ymin(m_values[imin]);
+   for (size_t i = 1; i < m_values.size(); i++) {
+      if (m_values[i] < ymin) {
          imin = i;
-         ymin = yvalues.at(imin);
+         ymin = m_values[imin];
       }
    }
-   params = m_simplex.at(imin);
+   params.assign(m_simplex.begin() + imin*m_npars,
+                 m_simplex.begin() + (imin + 1)*m_npars);
    return ymin;
 }
 
 void Amoeba::buildSimplex(const std::vector<double> & params,
                           double frac, bool addfrac) {
    m_simplex.clear();
-   m_simplex.reserve(m_npars);
-   m_simplex.push_back(params);
+   m_simplex.reserve((m_npars + 1)*m_npars);
+   m_simplex.insert(m_simplex.end(), params.begin(), params.end());
    for (size_t i = 1; i < m_npars+1; i++) {
-      m_simplex.push_back(params);
-      double & value(m_simplex.back()[i-1]);
+      m_simplex.insert(m_simplex.end(), params.begin(), params.end());
+      double & value(m_simplex[i*m_npars + i - 1]);
       if (addfrac) {
          value += frac;
       } else {
@@ -34,8 +34,7 @@ double BrokenPowerLaw::value(const Arg & xarg) const {
 
    enum ParamTypes {Prefactor, Index1, Index2, BreakValue};
 
-   std::vector<Parameter> my_params;
-   getParams(my_params);
+   const std::vector<Parameter> & my_params(m_parameter);
 
    if (x < my_params[BreakValue].getTrueValue()) {
       return my_params[Prefactor].getTrueValue()
@@ -51,29 +50,21 @@ double BrokenPowerLaw::value(const Arg & xarg) const {
 
 double BrokenPowerLaw::derivByParamImp(const Arg & xarg, 
                                        const std::string & paramName) const {
+   return derivByParamIndexImp(xarg, parameterIndex(paramName));
+}
 
+double BrokenPowerLaw::derivByParamIndexImp(const Arg & xarg,
+                                            unsigned int iparam) const {
    double x = dynamic_cast<const dArg &>(xarg).getValue();
 
    enum ParamTypes {Prefactor, Index1, Index2, BreakValue};
 
-   std::vector<Parameter> my_params;
-   getParams(my_params);
+   const std::vector<Parameter> & my_params(m_parameter);
 
    double gam1 = -my_params[Index1].getTrueValue();
    double gam2 = -my_params[Index2].getTrueValue();
    double Eb = my_params[BreakValue].getTrueValue();
 
-   int iparam = -1;
-   for (unsigned int i = 0; i < my_params.size(); i++) {
-      if (paramName == my_params[i].getName()) iparam = i;
-   }
-
-   if (iparam == -1) {
-      throw ParameterNotFound(paramName, 
-                              getName(), 
-                              "BrokenPowerLaw::derivByParam");
-   }
-   
    switch (iparam) {
    case Prefactor:
       if (x < Eb) {
@@ -115,4 +106,66 @@ double BrokenPowerLaw::derivByParamImp(const Arg & xarg,
    return 0;
 }
 
+void BrokenPowerLaw::valuesImp(const double * x, double * out, 
+                               size_t n) const {
+   enum ParamTypes {Prefactor, Index1, Index2, BreakValue};
+
+   double f0 = m_parameter[Prefactor].getTrueValue();
+   double index1 = m_parameter[Index1].getTrueValue();
+   double index2 = m_parameter[Index2].getTrueValue();
+   double Eb = m_parameter[BreakValue].getTrueValue();
+
+   for (size_t i = 0; i < n; i++) {
+      out[i] = f0*std::pow(x[i]/Eb, x[i] < Eb ? index1 : index2);
+   }
+}
+
+void BrokenPowerLaw::derivsImp(const double * x, double * out, size_t n,
+                               bool getFree) const {
+   enum ParamTypes {Prefactor, Index1, Index2, BreakValue};
+
+   double f0 = m_parameter[Prefactor].getTrueValue();
+   double index1 = m_parameter[Index1].getTrueValue();
+   double index2 = m_parameter[Index2].getTrueValue();
+   double Eb = m_parameter[BreakValue].getTrueValue();
+
+   std::vector<double> & powers(m_powers);
+   powers.resize(n);
+   for (size_t i = 0; i < n; i++) {
+      powers[i] = std::pow(x[i]/Eb, x[i] < Eb ? index1 : index2);
+   }
+
+   for (unsigned int iparam = 0; iparam < m_parameter.size(); iparam++) {
+      if (getFree && !m_parameter[iparam].isFree()) {
+         continue;
+      }
+      double scale = m_parameter[iparam].getScale();
+      switch (iparam) {
+      case Prefactor:
+         for (size_t i = 0; i < n; i++) {
+            out[i] = powers[i]*scale;
+         }
+         break;
+      case Index1:
+         for (size_t i = 0; i < n; i++) {
+            out[i] = x[i] < Eb ? f0*powers[i]*std::log(x[i]/Eb)*scale : 0;
+         }
+         break;
+      case Index2:
+         for (size_t i = 0; i < n; i++) {
+            out[i] = x[i] < Eb ? 0 : f0*powers[i]*std::log(x[i]/Eb)*scale;
+         }
+         break;
+      case BreakValue:
+         for (size_t i = 0; i < n; i++) {
+            out[i] = -f0*powers[i]*(x[i] < Eb ? index1 : index2)/Eb*scale;
+         }
+         break;
+      default:
+         break;
+      }
+      out += n;
+   }
+}
+
 } // namespace optimizers
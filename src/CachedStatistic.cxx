@@ -0,0 +1,151 @@
+/** 
+ * @file CachedStatistic.cxx
+ * @brief Implementation of the memoizing Statistic decorator
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#include <cstring>
+
+#include <algorithm>
+
+#include "optimizers/CachedStatistic.h"
+#include "optimizers/Exception.h"
+#include "optimizers/dArg.h"
+
+namespace optimizers {
+
+CachedStatistic::CachedStatistic(Statistic & stat, unsigned int nentries)
+   : StatisticDecorator("CachedStatistic", stat), m_nentries(nentries),
+     m_hits(0), m_misses(0) {
+   if (m_nentries == 0) {
+      throw Exception("CachedStatistic: the number of entries must be "
+                      "positive.");
+   }
+}
+
+CachedStatistic::CachedStatistic(const CachedStatistic & rhs) 
+   : StatisticDecorator(rhs), m_nentries(rhs.m_nentries), m_hits(0),
+     m_misses(0) {}
+
+double CachedStatistic::value() const {
+   Entry * entry(find());
+   if (entry && entry->hasValue) {
+      m_hits++;
+      return entry->value;
+   }
+   m_misses++;
+   double value(m_stat->value());
+   if (!entry) {
+      entry = insert();
+   }
+   entry->value = value;
+   entry->hasValue = true;
+   return value;
+}
+
+void CachedStatistic::getFreeDerivs(std::vector<double> & derivs) const {
+   Entry * entry(find());
+   if (entry && entry->hasDerivs) {
+      m_hits++;
+      derivs = entry->derivs;
+      return;
+   }
+   m_misses++;
+   m_stat->getFreeDerivs(derivs);
+   if (!entry) {
+      entry = insert();
+   }
+   entry->derivs = derivs;
+   entry->hasDerivs = true;
+}
+
+void CachedStatistic::valueAndFreeDerivs(const std::vector<double> & x,
+                                         double & f, 
+                                         std::vector<double> & g) {
+   setFreeParamValues(x);
+   f = cachedValueAndFreeDerivs(g);
+}
+
+double CachedStatistic::
+cachedValueAndFreeDerivs(std::vector<double> & derivs) const {
+   Entry * entry(find());
+   if (entry && entry->hasValue && entry->hasDerivs) {
+      m_hits++;
+      derivs = entry->derivs;
+      return entry->value;
+   }
+   if (entry && entry->hasValue) {
+      getFreeDerivs(derivs);
+      return entry->value;
+   }
+   if (entry && entry->hasDerivs) {
+      derivs = entry->derivs;
+      return value();
+   }
+   m_misses++;
+   std::vector<double> x;
+   m_stat->getFreeParamValues(x);
+   double value;
+   m_stat->valueAndFreeDerivs(x, value, derivs);
+   entry = insert();
+   entry->value = value;
+   entry->hasValue = true;
+   entry->derivs = derivs;
+   entry->hasDerivs = true;
+   return value;
+}
+
+double CachedStatistic::fetchValueAndDerivs(const Arg & x, 
+                                            std::vector<double> & derivs,
+                                            bool getFree) const {
+   if (getFree) {
+      return cachedValueAndFreeDerivs(derivs);
+   }
+   return StatisticDecorator::fetchValueAndDerivs(x, derivs, getFree);
+}
+
+CachedStatistic::Entry * CachedStatistic::find() const {
+// The Parameters may be changed, fixed or freed directly through the
+// innermost Statistic, bypassing paramsChanged, so its free mask and
+// number of free Parameters are part of the key, with the values.
+   const Statistic & stat(innermost());
+   stat.getParamValues(m_key);
+   const std::vector<Parameter> & params(stat.parameters());
+   for (size_t i = 0; i < params.size(); i++) {
+      m_key.push_back(params[i].isFree() ? 1 : 0);
+   }
+   m_key.push_back(stat.getNumFreeParams());
+   size_t nbytes(m_key.size()*sizeof(double));
+   for (size_t i = 0; i < m_entries.size(); i++) {
+      if (m_entries[i].key.size() == m_key.size() &&
+          (nbytes == 0 || 
+           std::memcmp(&m_entries[i].key[0], &m_key[0], nbytes) == 0)) {
+         std::rotate(m_entries.begin(), m_entries.begin() + i, 
+                     m_entries.begin() + i + 1);
+         return &m_entries[0];
+      }
+   }
+   return 0;
+}
+
+CachedStatistic::Entry * CachedStatistic::insert() const {
+   if (m_entries.size() < m_nentries) {
+      m_entries.push_back(Entry());
+   }
+// Recycle the last entry, which is the least recently used.
+   std::rotate(m_entries.begin(), m_entries.end() - 1, m_entries.end());
+   Entry & entry(m_entries[0]);
+   entry.key = m_key;
+   entry.hasValue = false;
+   entry.hasDerivs = false;
+   return &entry;
+}
+
+void CachedStatistic::paramsChanged() {
+   StatisticDecorator::paramsChanged();
+   clear();
+}
+
+} // namespace optimizers
@@ -18,7 +18,7 @@
 namespace optimizers {
 
 ChiSq::ChiSq(const DataCont_t & domain, const DataCont_t & range, optimizers::Function * func):
-   m_domain(&domain), m_range(&range), m_func(func), m_dof(0) {
+   m_domain(&domain), m_range(&range), m_func(func), m_own_func(false), m_dof(0) {
    // Make sure function pointer is valid.
    if (0 == m_func) {
      throw std::logic_error("ChiSq::ChiSq(...): function pointer is NULL");
@@ -42,51 +42,96 @@ ChiSq::ChiSq(const DataCont_t & domain, const DataCont_t & range, optimizers::Fu
    m_func->getParams(m_parameter);
 }
 
+ChiSq::ChiSq(const ChiSq & rhs): Statistic(rhs), m_domain(rhs.m_domain), m_range(rhs.m_range),
+   m_func(rhs.m_func->clone()), m_own_func(true), m_dof(rhs.m_dof) {}
+
+ChiSq::~ChiSq() {
+   if (m_own_func) delete m_func;
+}
+
 double ChiSq::value() const {
    const DataCont_t & x(*m_domain);
    const DataCont_t & y(*m_range);
 
+   // Evaluate the model at all of the data points in one call.
+   DataCont_t & model(m_model);
+   model.resize(x.size());
+   m_func->values(x.data(), model.data(), x.size());
+
    double chi_sq = 0.;
 
    // Compute ChiSq for the current values of the function.
    // ChiSq == sum((y_actual - y_model) ^ 2 / y_model)
    for (DataCont_t::size_type domain_index = 0; domain_index != x.size(); ++domain_index) {
-      optimizers::dArg arg(x[domain_index]);
-//      double func_value = m_func->value(arg);
-      double func_value = m_func->operator()(arg);
-      double deviation = y[domain_index] - func_value;
-      chi_sq += deviation * deviation / func_value;
+      double deviation = y[domain_index] - model[domain_index];
+      chi_sq += deviation * deviation / model[domain_index];
    }
 
    return chi_sq;
 }
 
 void ChiSq::getFreeDerivs(std::vector<double> & derivs) const {
+   const DataCont_t & x(*m_domain);
+
+   m_model.resize(x.size());
+   m_func->values(x.data(), m_model.data(), x.size());
+
+   accumulateFreeDerivs(m_model, derivs);
+}
+
+void ChiSq::valueAndFreeDerivs(const std::vector<double> & params, double & f,
+                               std::vector<double> & derivs) {
+   setFreeParamValues(params);
+
    const DataCont_t & x(*m_domain);
    const DataCont_t & y(*m_range);
 
-   derivs.assign(m_func->getNumFreeParams(), 0.);
+   // Share the model values between the statistic and its derivatives.
+   DataCont_t & model(m_model);
+   model.resize(x.size());
+   m_func->values(x.data(), model.data(), x.size());
 
-   // Using chain rule on ChiSq:
-   // DerivByPar(ChiSq) == sum((1. - (y_actual / y_model) ^ 2) * DerivByPar(y_model))
-   // First compute the sum of terms.
+   f = 0.;
    for (DataCont_t::size_type domain_index = 0; domain_index != x.size(); ++domain_index) {
-      optimizers::dArg arg(x[domain_index]);
-      std::vector<double> func_deriv(derivs.size());
+      double deviation = y[domain_index] - model[domain_index];
+      f += deviation * deviation / model[domain_index];
+   }
 
-      // Get the functions derivatives wrt free parameters.
-      m_func->getFreeDerivs(arg, func_deriv);
+   accumulateFreeDerivs(model, derivs);
+}
 
-      // Precompute the part of the sum which does not depend on which derivative is being taken.
-      double ratio = y[domain_index] / m_func->operator()(arg);
-      double deviation_part = 1. - (ratio * ratio);
+void ChiSq::accumulateFreeDerivs(const DataCont_t & model, std::vector<double> & derivs) const {
+   const DataCont_t & x(*m_domain);
+   const DataCont_t & y(*m_range);
+   DataCont_t::size_type npts = x.size();
 
-      // Add terms to output array of derivatives.
-      for (std::vector<double>::size_type par_index = 0; par_index != derivs.size(); ++par_index) {
-         derivs[par_index] += deviation_part * func_deriv[par_index];
-      }
+   derivs.assign(m_func->getNumFreeParams(), 0.);
+
+   // Get the function's derivatives wrt free parameters at all data points,
+   // stored one parameter at a time.
+   DataCont_t & func_deriv(m_funcDerivs);
+   func_deriv.resize(derivs.size() * npts);
+   m_func->derivs(x.data(), func_deriv.data(), npts, true);
+
+   // Using chain rule on ChiSq:
+   // DerivByPar(ChiSq) == sum((1. - (y_actual / y_model) ^ 2) * DerivByPar(y_model))
+   // Precompute the part of the sum which does not depend on which derivative is being taken.
+   DataCont_t & deviation_part(m_deviationPart);
+   deviation_part.resize(npts);
+   for (DataCont_t::size_type domain_index = 0; domain_index != npts; ++domain_index) {
+      double ratio = y[domain_index] / model[domain_index];
+      deviation_part[domain_index] = 1. - (ratio * ratio);
    }
 
+   // Add terms to output array of derivatives.
+   for (std::vector<double>::size_type par_index = 0; par_index != derivs.size(); ++par_index) {
+      const double * row = func_deriv.data() + par_index * npts;
+      double sum = 0.;
+      for (DataCont_t::size_type domain_index = 0; domain_index != npts; ++domain_index) {
+         sum += deviation_part[domain_index] * row[domain_index];
+      }
+      derivs[par_index] = sum;
+   }
 }
 
 std::vector<double>::const_iterator ChiSq::setFreeParamValues_(std::vector<double>::const_iterator it) {
@@ -107,6 +152,9 @@ double ChiSq::derivByParamImp(const optimizers::Arg &, const std::string & param
 
    double chi_sq = 0.;
 
+   // Resolve the parameter name once rather than for every data point.
+   unsigned int param_index = m_func->parameterIndex(parameter_name);
+
    // Using chain rule on ChiSq:
    // DerivByPar(ChiSq) == sum((1 - (y_actual / y_model) ^ 2) * DerivByPar(y_model))
    for (DataCont_t::size_type domain_index = 0; domain_index != x.size(); ++domain_index) {
@@ -115,7 +163,7 @@ double ChiSq::derivByParamImp(const optimizers::Arg &, const std::string & param
       double ratio = y[domain_index] / m_func->operator()(arg);
 
       // Get the function's derivatives wrt the parameter.
-      double func_deriv = m_func->derivByParam(arg, parameter_name);
+      double func_deriv = m_func->derivByParamIndex(arg, param_index);
 
       // Add to the sum term.
       chi_sq += (1 - ratio * ratio) * func_deriv;
@@ -58,18 +58,9 @@ CompositeFunction::getParam(const std::string & paramName,
 }
 
 void CompositeFunction::syncParams() {
-   m_parameter.clear();
-   std::vector<Parameter> params;
-
-   m_a->getParams(params);
-   for (size_t i(0); i < params.size(); i++) {
-      m_parameter.push_back(params[i]);
-   }
-
-   m_b->getParams(params);
-   for (size_t i(0); i < params.size(); i++) {
-      m_parameter.push_back(params[i]);
-   }
+   m_parameter = m_a->parameters();
+   m_parameter.insert(m_parameter.end(), m_b->parameters().begin(),
+                      m_b->parameters().end());
 }
 
 } // namespace optimizers
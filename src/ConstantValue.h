@@ -46,6 +46,10 @@ protected:
       return m_parameter[0].getScale();
    }
 
+   double derivByParamIndexImp(const Arg &, unsigned int) const {
+      return m_parameter[0].getScale();
+   }
+
 };
 
 } // namespace optimizers
@@ -0,0 +1,60 @@
+/**
+ * @file CovarianceMatrix.cxx
+ * @brief Implementation of CovarianceMatrix.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#include <cmath>
+
+#include "optimizers/CovarianceMatrix.h"
+#include "optimizers/Exception.h"
+
+namespace optimizers {
+
+CovarianceMatrix::
+CovarianceMatrix(const std::vector< std::vector<double> > & rows)
+   : m_npars(rows.size()) {
+   m_elements.reserve(m_npars*m_npars);
+   for (size_t i = 0; i < m_npars; i++) {
+      if (rows[i].size() != m_npars) {
+         throw Exception("CovarianceMatrix: matrix is not square");
+      }
+      m_elements.insert(m_elements.end(), rows[i].begin(), rows[i].end());
+   }
+}
+
+void CovarianceMatrix::setPacked(size_t npars,
+                                 const std::vector<double> & packed) {
+   if (packed.size() < npars*(npars + 1)/2) {
+      throw Exception("CovarianceMatrix::setPacked: too few elements");
+   }
+   m_npars = npars;
+   m_elements.resize(npars*npars);
+   size_t indx(0);
+   for (size_t j = 0; j < npars; j++) {
+      for (size_t i = 0; i <= j; i++, indx++) {
+         m_elements[i*npars + j] = packed[indx];
+         m_elements[j*npars + i] = packed[indx];
+      }
+   }
+}
+
+double CovarianceMatrix::uncertainty(size_t i) const {
+   return std::sqrt((*this)(i, i));
+}
+
+double CovarianceMatrix::correlation(size_t i, size_t j) const {
+   return (*this)(i, j)/std::sqrt((*this)(i, i)*(*this)(j, j));
+}
+
+std::vector< std::vector<double> > CovarianceMatrix::rows() const {
+   std::vector< std::vector<double> > matrix;
+   for (size_t i = 0; i < m_npars; i++) {
+      matrix.push_back(std::vector<double>(row(i), row(i) + m_npars));
+   }
+   return matrix;
+}
+
+} // namespace optimizers
@@ -37,6 +37,9 @@ namespace optimizers {
   }
 
   int Drmnfb::find_min(int verbose, double tol, int tolType) {
+    clearEvaluationCache();
+    Instrumentation::Timer timer(instruments(), Instrumentation::FIND_MIN);
+    beginIterations();
 
     /// Unpack model parameters into the arrays needed by Drmnfb
     
@@ -77,9 +80,12 @@ namespace optimizers {
 
     /// Call the optimizing function in an infinite loop.
     double oldVal = 1.e+30;
+    int niter = 0;
+    bool absoluteConvergence = false;
     for (;;) {
       drmnfb_(&paramBounds[0], &scale[0], &funcVal, &iv[0], 
 	      &liv, &lv, &nparams, &v[0], &paramVals[0]);
+      notifyPortIteration(iv, v, niter);
       int rcode = iv[0];
       if (rcode == 1 || rcode == 2) { /// request for a function value
 	try {m_stat->setFreeParamValues(paramVals);}
@@ -100,6 +106,7 @@ namespace optimizers {
 	    fabs(funcVal-oldVal) < tol) {
 	  // check after a successful line search
 	  setRetCode(6);
+	  absoluteConvergence = true;
 	  if (verbose != 0)
 	    std::cout << "***** ABSOLUTE FUNCTION CONVERGENCE *****" 
 		      << std::endl;
@@ -116,6 +123,11 @@ namespace optimizers {
       }
     }
 
+    /// Report the final point.  Unless the loop was cut short, the
+    /// driver has returned its best point, with its value in v(F).
+    notifyIteration(paramVals, absoluteConvergence ? -funcVal : -v[9],
+                    v[0], v[5]);
+
     /// Get parameter values and put them back into the Function
     m_stat->setFreeParamValues(paramVals);
 
@@ -140,12 +152,9 @@ namespace optimizers {
 	throw Exception("DPPTRI: Zero diagonal element in Cholesky factor",
 			info);
       
-      /// Extract the diagonal elements of the covariance matrix.
-      /// Their square roots are the parameter uncertainties.
-      m_uncertainty.clear();
-      for (int i = 0; i < nparams; i++) {
-	m_uncertainty.push_back(sqrt(hess[i*(i+3)/2]));
-      }
+      /// Keep the covariance matrix.  The square roots of its
+      /// diagonal elements are the parameter uncertainties.
+      setPackedCovariance(nparams, hess);
     }
     return getRetCode();
   } // End of find_min
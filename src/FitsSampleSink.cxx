@@ -0,0 +1,141 @@
+/**
+ * @file FitsSampleSink.cxx
+ * @brief Implementation of a SampleSink that streams samples to a
+ * FITS binary table in fixed-size blocks of rows.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#include <cstdio>
+
+#include <iostream>
+
+#include "fitsio.h"
+
+#include "optimizers/Exception.h"
+#include "optimizers/FitsSampleSink.h"
+
+namespace optimizers {
+
+FitsSampleSink::FitsSampleSink(const std::string & filename,
+                               const std::vector<std::string> & columnNames,
+                               bool doublePrecision,
+                               unsigned long blockSize)
+   : m_fptr(0), m_ncols(columnNames.size()), 
+     m_doublePrecision(doublePrecision), 
+     m_blockSize(blockSize > 0 ? blockSize : 1), m_nrows(0) {
+   if (m_ncols == 0) {
+      throw Exception("FitsSampleSink: no columns given.");
+   }
+   m_buffer.reserve(m_blockSize*m_ncols);
+
+// Create the file.
+   fitsfile * fptr(0);
+   int status(0);
+   remove(filename.c_str());
+   fits_create_file(&fptr, filename.c_str(), &status);
+   checkStatus(status);
+   m_fptr = fptr;
+
+// Create an empty binary table, with the labels identifying the
+// content of each column.  Rows are added as blocks are flushed.
+   std::vector<std::string> tforms(m_ncols, doublePrecision ? "1D" : "1E");
+   std::vector<std::string> tunits(m_ncols, "None");
+   std::vector<char *> ttype, tform, tunit;
+   for (size_t i = 0; i < m_ncols; i++) {
+      ttype.push_back(const_cast<char *>(columnNames[i].c_str()));
+      tform.push_back(const_cast<char *>(tforms[i].c_str()));
+      tunit.push_back(const_cast<char *>(tunits[i].c_str()));
+   }
+   fits_create_tbl(fptr, BINARY_TBL, 0, static_cast<int>(m_ncols), 
+                   &ttype[0], &tform[0], &tunit[0], "Mcmc data", &status);
+   if (status != 0) {
+      int close_status(0);
+      fits_close_file(fptr, &close_status);
+      m_fptr = 0;
+      checkStatus(status);
+   }
+}
+
+FitsSampleSink::~FitsSampleSink() {
+   try {
+      close();
+   } catch (std::exception & eObj) {
+      std::cerr << eObj.what() << std::endl;
+   }
+}
+
+void FitsSampleSink::write(const std::vector<double> & sample) {
+   if (sample.size() != m_ncols) {
+      throw Exception("FitsSampleSink::write: sample size does not match "
+                      "the number of columns.");
+   }
+   m_buffer.insert(m_buffer.end(), sample.begin(), sample.end());
+   if (m_buffer.size() >= m_blockSize*m_ncols) {
+      flush();
+   }
+}
+
+void FitsSampleSink::flush() {
+   if (m_fptr == 0) {
+      throw Exception("FitsSampleSink::flush: file is closed.");
+   }
+   long nrows = static_cast<long>(m_buffer.size()/m_ncols);
+   if (nrows == 0) {
+      return;
+   }
+   fitsfile * fptr = static_cast<fitsfile *>(m_fptr);
+   int status(0);
+   std::vector<double> dcol;
+   std::vector<float> fcol;
+
+// cfitsio extends the table as needed when writing past its end.
+   for (size_t i = 0; i < m_ncols; i++) {
+      if (m_doublePrecision) {
+         dcol.resize(nrows);
+         for (long j = 0; j < nrows; j++) {
+            dcol[j] = m_buffer[j*m_ncols + i];
+         }
+         fits_write_col(fptr, TDOUBLE, static_cast<int>(i + 1), m_nrows + 1,
+                        1, nrows, &dcol[0], &status);
+      } else {
+         fcol.resize(nrows);
+         for (long j = 0; j < nrows; j++) {
+            fcol[j] = m_buffer[j*m_ncols + i];
+         }
+         fits_write_col(fptr, TFLOAT, static_cast<int>(i + 1), m_nrows + 1,
+                        1, nrows, &fcol[0], &status);
+      }
+      checkStatus(status);
+   }
+   m_nrows += nrows;
+   m_buffer.clear();
+}
+
+void FitsSampleSink::close() {
+   if (m_fptr == 0) {
+      return;
+   }
+   fitsfile * fptr = static_cast<fitsfile *>(m_fptr);
+   int status(0);
+   try {
+      flush();
+   } catch (...) {
+      fits_close_file(fptr, &status);
+      m_fptr = 0;
+      throw;
+   }
+   fits_close_file(fptr, &status);
+   m_fptr = 0;
+   checkStatus(status);
+}
+
+void FitsSampleSink::checkStatus(int status) const {
+   if (status != 0) {
+      fits_report_error(stderr, status);
+      throw Exception("FitsSampleSink: cfitsio errors.");
+   }
+}
+
+} // namespace optimizers
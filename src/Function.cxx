@@ -13,6 +13,7 @@
 #include "optimizers/Dom.h"
 #include "optimizers/Function.h"
 #include "optimizers/ParameterNotFound.h"
+#include "optimizers/dArg.h"
 
 namespace optimizers {
 
@@ -82,6 +83,66 @@ double Function::derivByParam(const Arg & xarg,
    return my_deriv;
 }
 
+double Function::derivByParamIndex(const Arg & xarg,
+                                   unsigned int paramIndex) const {
+   double my_deriv(derivByParamIndexImp(xarg, paramIndex));
+   if (m_scalingFunction) {
+      my_deriv *= m_scalingFunction->operator()(xarg);
+   }
+   return my_deriv;
+}
+
+double Function::derivByParamIndexImp(const Arg & xarg,
+                                      unsigned int paramIndex) const {
+   return derivByParamImp(xarg, m_parameter.at(paramIndex).getName());
+}
+
+void Function::values(const double * x, double * out, size_t n) const {
+   valuesImp(x, out, n);
+   if (m_scalingFunction) {
+      std::vector<double> scale(n);
+      m_scalingFunction->values(x, scale.data(), n);
+      for (size_t i = 0; i < n; i++) {
+         out[i] *= scale[i];
+      }
+   }
+}
+
+void Function::derivs(const double * x, double * out, size_t n,
+                      bool getFree) const {
+   derivsImp(x, out, n, getFree);
+   if (m_scalingFunction) {
+      std::vector<double> scale(n);
+      m_scalingFunction->values(x, scale.data(), n);
+      size_t npars(getFree ? getNumFreeParams() : getNumParams());
+      for (size_t j = 0; j < npars; j++) {
+         double * row(out + j*n);
+         for (size_t i = 0; i < n; i++) {
+            row[i] *= scale[i];
+         }
+      }
+   }
+}
+
+void Function::valuesImp(const double * x, double * out, size_t n) const {
+   for (size_t i = 0; i < n; i++) {
+      out[i] = value(dArg(x[i]));
+   }
+}
+
+void Function::derivsImp(const double * x, double * out, size_t n,
+                         bool getFree) const {
+   for (unsigned int j = 0; j < m_parameter.size(); j++) {
+      if (getFree && !m_parameter[j].isFree()) {
+         continue;
+      }
+      for (size_t i = 0; i < n; i++) {
+         out[i] = derivByParamIndexImp(dArg(x[i]), j);
+      }
+      out += n;
+   }
+}
+
 void Function::setScalingFunction(const Function & scalingFunction) {
    m_scalingFunction = scalingFunction.clone();
 }
@@ -108,6 +169,15 @@ const Parameter & Function::getParam(const std::string &paramName) const {
    throw ParameterNotFound(paramName, getName(), "getParam");
 }
 
+unsigned int Function::parameterIndex(const std::string & paramName) const {
+   for (unsigned int i = 0; i < m_parameter.size(); i++) {
+      if (paramName == m_parameter[i].getName()) {
+         return i;
+      }
+   }
+   throw ParameterNotFound(paramName, getName(), "parameterIndex");
+}
+
 void Function::setParamValues(const std::vector<double> &paramVec) {
    if (paramVec.size() != m_parameter.size()) {
       std::ostringstream errorMessage;
@@ -237,15 +307,29 @@ void Function::addParam(const Parameter &param) {
 
 void Function::fetchParamValues(std::vector<double> &values,
                                 bool getFree) const {
-   if (!values.empty()) values.clear();
+// Resizing reuses the caller's storage, so this does not allocate
+// when the same vector is passed on each call.
+   values.resize(numParams(getFree));
 
+   size_t j(0);
    for (unsigned int i = 0; i < m_parameter.size(); i++) {
       if (!getFree || m_parameter[i].isFree()) {
-         values.push_back(m_parameter[i].getValue());
+         values[j++] = m_parameter[i].getValue();
       }
    }
 }
 
+size_t Function::numParams(bool getFree) const {
+   if (!getFree) {
+      return m_parameter.size();
+   }
+   size_t nfree(0);
+   for (unsigned int i = 0; i < m_parameter.size(); i++) {
+      nfree += m_parameter[i].isFree();
+   }
+   return nfree;
+}
+
 void Function::fetchParamNames(std::vector<std::string> &names,
                                bool getFree) const {
    if (!names.empty()) names.clear();
@@ -259,17 +343,23 @@ void Function::fetchParamNames(std::vector<std::string> &names,
 
 void Function::fetchDerivs(const Arg & x, std::vector<double> & derivs, 
                            bool getFree) const {
-   if (!derivs.empty()) {
-      derivs.clear();
-   }
+   derivs.resize(numParams(getFree));
 
+   size_t j(0);
    for (unsigned int i = 0; i < m_parameter.size(); i++) {
       if (!getFree || m_parameter[i].isFree()) {
-         derivs.push_back(derivByParam(x, m_parameter[i].getName()));
+         derivs[j++] = derivByParamIndex(x, i);
       }
    }
 }
 
+double Function::fetchValueAndDerivs(const Arg & x, 
+                                     std::vector<double> & derivs,
+                                     bool getFree) const {
+   fetchDerivs(x, derivs, getFree);
+   return operator()(x);
+}
+
 void Function::appendParamDomElements(DOMDocument * doc, DOMNode * node) {
    std::vector<Parameter>::iterator paramIt = m_parameter.begin();
    for ( ; paramIt != m_parameter.end(); ++paramIt) {
@@ -29,8 +29,7 @@ double Gaussian::integral(const Arg & xargmin, const Arg & xargmax) const {
    double xmin = dynamic_cast<const dArg &>(xargmin).getValue();
    double xmax = dynamic_cast<const dArg &>(xargmax).getValue();
 
-   std::vector<Parameter> my_params;
-   getParams(my_params);
+   const std::vector<Parameter> & my_params(m_parameter);
    enum ParamTypes {Prefactor, Mean, Sigma};
 
    double f0 = my_params[Prefactor].getTrueValue();
@@ -60,8 +59,7 @@ double Gaussian::value(const Arg & xarg) const {
 
    enum ParamTypes {Prefactor, Mean, Sigma};
 
-   std::vector<Parameter> my_params;
-   getParams(my_params);
+   const std::vector<Parameter> & my_params(m_parameter);
 
    return my_params[Prefactor].getTrueValue()/sqrt(2.*M_PI)
       /my_params[Sigma].getTrueValue()
@@ -71,24 +69,17 @@ double Gaussian::value(const Arg & xarg) const {
 
 double Gaussian::derivByParamImp(const Arg & xarg, 
                                  const std::string & paramName) const {
+   return derivByParamIndexImp(xarg, parameterIndex(paramName));
+}
+
+double Gaussian::derivByParamIndexImp(const Arg & xarg,
+                                      unsigned int iparam) const {
    double x = dynamic_cast<const dArg &>(xarg).getValue();
 
    enum ParamTypes {Prefactor, Mean, Sigma};
 
-   std::vector<Parameter> my_params;
-   getParams(my_params);
-
-   int iparam = -1;
-   for (unsigned int i = 0; i < my_params.size(); i++) {
-      if (paramName == my_params[i].getName()) {
-         iparam = i;
-      }
-   }
+   const std::vector<Parameter> & my_params(m_parameter);
 
-   if (iparam == -1) {
-      throw ParameterNotFound(paramName, getName(), "Gaussian::derivByParam");
-   }
-   
    switch (iparam) {
    case Prefactor:
       return my_params[Prefactor].getScale()/sqrt(2.*M_PI)
@@ -113,6 +104,66 @@ double Gaussian::derivByParamImp(const Arg & xarg,
    return 0;
 }
 
+void Gaussian::valuesImp(const double * x, double * out, size_t n) const {
+   enum ParamTypes {Prefactor, Mean, Sigma};
+
+   double f0 = m_parameter[Prefactor].getTrueValue();
+   double x0 = m_parameter[Mean].getTrueValue();
+   double sigma = m_parameter[Sigma].getTrueValue();
+   double norm = f0/sqrt(2.*M_PI)/sigma;
+
+   for (size_t i = 0; i < n; i++) {
+      double z = (x[i] - x0)/sigma;
+      out[i] = norm*exp(-z*z/2.);
+   }
+}
+
+void Gaussian::derivsImp(const double * x, double * out, size_t n,
+                         bool getFree) const {
+   enum ParamTypes {Prefactor, Mean, Sigma};
+
+   double f0 = m_parameter[Prefactor].getTrueValue();
+   double x0 = m_parameter[Mean].getTrueValue();
+   double sigma = m_parameter[Sigma].getTrueValue();
+
+// Unnormalized Gaussian profile shared by all of the derivatives.
+   std::vector<double> & profile(m_profile);
+   profile.resize(n);
+   double norm = 1./sqrt(2.*M_PI)/sigma;
+   for (size_t i = 0; i < n; i++) {
+      double z = (x[i] - x0)/sigma;
+      profile[i] = norm*exp(-z*z/2.);
+   }
+
+   for (unsigned int iparam = 0; iparam < m_parameter.size(); iparam++) {
+      if (getFree && !m_parameter[iparam].isFree()) {
+         continue;
+      }
+      double scale = m_parameter[iparam].getScale();
+      switch (iparam) {
+      case Prefactor:
+         for (size_t i = 0; i < n; i++) {
+            out[i] = profile[i]*scale;
+         }
+         break;
+      case Mean:
+         for (size_t i = 0; i < n; i++) {
+            out[i] = f0*profile[i]*(x[i] - x0)/(sigma*sigma)*scale;
+         }
+         break;
+      case Sigma:
+         for (size_t i = 0; i < n; i++) {
+            double z = (x[i] - x0)/sigma;
+            out[i] = f0*profile[i]/sigma*(z*z - 1.)*scale;
+         }
+         break;
+      default:
+         break;
+      }
+      out += n;
+   }
+}
+
 const std::vector<double> & Gaussian::xvalues(size_t nx) const {
    const double nsig(5);
 
@@ -0,0 +1,85 @@
+/**
+ * @file Instrumentation.cxx
+ * @brief Implementation of the evaluation and phase counters.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#include <iomanip>
+
+#include "optimizers/Instrumentation.h"
+
+namespace optimizers {
+
+Instrumentation::Instrumentation() {
+   reset();
+}
+
+void Instrumentation::record(Phase phase, std::chrono::nanoseconds elapsed) {
+   unsigned long long ns(elapsed.count() > 0 ? elapsed.count() : 0);
+   m_calls[phase]++;
+   m_nanoseconds[phase] += ns;
+   unsigned int bin(0);
+   while (ns >>= 1) {
+      bin++;
+   }
+   if (bin >= NBINS) {
+      bin = NBINS - 1;
+   }
+   m_histogram[phase][bin]++;
+}
+
+double Instrumentation::meanTime(Phase phase) const {
+   unsigned long ncalls(calls(phase));
+   if (ncalls == 0) {
+      return 0;
+   }
+   return time(phase)/ncalls;
+}
+
+std::vector<unsigned long> Instrumentation::histogram(Phase phase) const {
+   std::vector<unsigned long> counts(NBINS);
+   for (unsigned int k = 0; k < NBINS; k++) {
+      counts[k] = m_histogram[phase][k];
+   }
+   return counts;
+}
+
+void Instrumentation::reset() {
+   for (int phase = 0; phase < NPHASES; phase++) {
+      m_calls[phase] = 0;
+      m_nanoseconds[phase] = 0;
+      for (unsigned int k = 0; k < NBINS; k++) {
+         m_histogram[phase][k] = 0;
+      }
+   }
+}
+
+const char * Instrumentation::phaseName(Phase phase) {
+   static const char * names[NPHASES] = {"value", "getFreeDerivs",
+                                         "valueAndFreeDerivs",
+                                         "setFreeParamValues",
+                                         "find_min", "Hessian", "MINOS"};
+   return names[phase];
+}
+
+void Instrumentation::report(std::ostream & out) const {
+   out << std::setw(20) << std::left << "phase" << std::right
+       << std::setw(12) << "calls"
+       << std::setw(14) << "time (s)"
+       << std::setw(14) << "mean (s)" << "\n";
+   for (int i = 0; i < NPHASES; i++) {
+      Phase phase(static_cast<Phase>(i));
+      if (calls(phase) == 0) {
+         continue;
+      }
+      out << std::setw(20) << std::left << phaseName(phase) << std::right
+          << std::setw(12) << calls(phase)
+          << std::setw(14) << time(phase)
+          << std::setw(14) << meanTime(phase) << "\n";
+   }
+   out << std::flush;
+}
+
+} // namespace optimizers
@@ -0,0 +1,66 @@
+/**
+ * @file InstrumentedStatistic.cxx
+ * @brief Implementation of the timing Statistic decorator
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#include "optimizers/InstrumentedStatistic.h"
+
+namespace optimizers {
+
+double InstrumentedStatistic::value() const {
+   Instrumentation::Timer timer(m_instruments, Instrumentation::VALUE);
+   return m_stat->value();
+}
+
+void InstrumentedStatistic::getFreeDerivs(std::vector<double> & derivs) const {
+   Instrumentation::Timer timer(m_instruments, Instrumentation::DERIVS);
+   m_stat->getFreeDerivs(derivs);
+}
+
+void InstrumentedStatistic::valueAndFreeDerivs(const std::vector<double> & x,
+                                               double & f,
+                                               std::vector<double> & g) {
+   Instrumentation::Timer timer(m_instruments,
+                                Instrumentation::VALUE_AND_DERIVS);
+   m_stat->valueAndFreeDerivs(x, f, g);
+}
+
+std::vector<double>::const_iterator InstrumentedStatistic::setParamValues_(
+   std::vector<double>::const_iterator it) {
+   Instrumentation::Timer timer(m_instruments, Instrumentation::SET_PARAMS);
+   return StatisticDecorator::setParamValues_(it);
+}
+
+std::vector<double>::const_iterator
+InstrumentedStatistic::setFreeParamValues_(
+   std::vector<double>::const_iterator it) {
+   Instrumentation::Timer timer(m_instruments, Instrumentation::SET_PARAMS);
+   return StatisticDecorator::setFreeParamValues_(it);
+}
+
+void InstrumentedStatistic::fetchDerivs(const Arg & x,
+                                        std::vector<double> & derivs,
+                                        bool getFree) const {
+   if (getFree) {
+      getFreeDerivs(derivs);
+   } else {
+      Instrumentation::Timer timer(m_instruments, Instrumentation::DERIVS);
+      m_stat->getDerivs(x, derivs);
+   }
+}
+
+double InstrumentedStatistic::fetchValueAndDerivs(const Arg & x,
+                                                  std::vector<double> & derivs,
+                                                  bool getFree) const {
+   Instrumentation::Timer timer(m_instruments,
+                                Instrumentation::VALUE_AND_DERIVS);
+   if (getFree) {
+      return m_stat->getValueAndFreeDerivs(x, derivs);
+   }
+   return m_stat->getValueAndDerivs(x, derivs);
+}
+
+} // namespace optimizers
@@ -7,7 +7,9 @@
  */
 
 #include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <vector>
 
 #include "optimizers/Lbfgs.h"
@@ -15,6 +17,40 @@
 #include "optimizers/Exception.h"
 #include "optimizers/dArg.h"
 
+namespace {
+  /// Norm of the gradient of the minimized function, leaving out the
+  /// components that would carry a variable past an active bound.
+  double projectedGradientNorm(const std::vector<double> & x,
+                               const std::vector<double> & grad,
+                               const std::vector<double> & xmin,
+                               const std::vector<double> & xmax) {
+    double sum = 0;
+    for (size_t i = 0; i < x.size(); i++) {
+      if ((x[i] <= xmin[i] && grad[i] > 0) || 
+          (x[i] >= xmax[i] && grad[i] < 0)) {
+        continue;
+      }
+      sum += grad[i]*grad[i];
+    }
+    return std::sqrt(sum);
+  }
+
+  /// The L-BFGS-B code for a pair of bounds: 0 for none, 1 for a
+  /// lower bound only, 2 for both, 3 for an upper bound only.
+  int boundCode(double xmin, double xmax) {
+    bool lower = !std::isinf(xmin);
+    bool upper = !std::isinf(xmax);
+    if (lower && upper) {
+      return 2;
+    } else if (lower) {
+      return 1;
+    } else if (upper) {
+      return 3;
+    }
+    return 0;
+  }
+}
+
 namespace optimizers {
   
   void Lbfgs::setMaxVarMetCorr(const int m)
@@ -31,9 +67,13 @@ namespace optimizers {
   }
 
   int Lbfgs::find_min(int verbose, double tol, int tolType) {
+    clearEvaluationCache();
+    Instrumentation::Timer timer(instruments(), Instrumentation::FIND_MIN);
 
     m_numEvals = 0;
     m_errorString.erase();
+    beginIterations();
+    const double noEdm = std::numeric_limits<double>::quiet_NaN();
 
     // Unpack model parameters into the arrays needed by LBFGS
     
@@ -44,33 +84,36 @@ namespace optimizers {
     std::vector<double> paramVals(nparams);
     std::vector<double> paramMins(nparams);
     std::vector<double> paramMaxs(nparams);
+    m_nbd.resize(nparams);
     int i=0;
     for (std::vector<Parameter>::iterator p = params.begin();
 	 p != params.end(); p++, i++) {
       paramVals[i] = p->getValue();
-      paramMins[i] = p->getBounds().first;
-      paramMaxs[i] = p->getBounds().second;
+      paramMins[i] = p->effectiveBounds().first;
+      paramMaxs[i] = p->effectiveBounds().second;
+      m_nbd[i] = boundCode(paramMins[i], paramMaxs[i]);
     }
     
-    // Create the variables and arrays used by LBFGS
-    // These serve as storage between calls to setulb_,
-    // so they must be declared outside the loop.
-    // Most of them don't need to be initialized.
+    // Set up the arrays used by LBFGS.  These serve as storage
+    // between calls to setulb_, so they must be set up outside the
+    // loop.  They are kept from one find_min to the next, so that
+    // repeated fits of the same size do not reallocate them.
 
     double funcVal;
     std::vector<double> gradient(nparams);
-    std::vector<int> isave(44);
-    std::vector<logical> lsave(4);
-    std::vector<double> dsave(29);
-    std::vector<char> csave(60, ' ');  // Blank-filled
-    std::vector<int> intWorkArray(3*nparams);
+    m_isave.assign(44, 0);
+    m_lsave.assign(4, 0);
+    m_dsave.assign(29, 0.);
+    m_csave.assign(60, ' ');  // Blank-filled
+    m_intWorkArray.assign(3*nparams, 0);
     const int workSize = (2*m_maxVarMetCorr + 4) * nparams
       + 12 * m_maxVarMetCorr * (m_maxVarMetCorr + 12);
-    std::vector<double> doubleWorkArray(workSize);
+    m_doubleWorkArray.assign(workSize, 0.);
 
     // Fortran-style string used for communication with LBFGS
 
-    std::vector<char> task(60, ' '); // Blank-filled
+    std::vector<char> & task(m_task);
+    task.assign(60, ' '); // Blank-filled
     static const std::string strt("START");
     std::copy(strt.begin(), strt.end(), task.begin()); // Initialize
 
@@ -81,12 +124,11 @@ namespace optimizers {
     double oldVal = 0.;
     for (;;) {
       int iprint = verbose - 2;  
-      const std::vector<int> nbd(nparams, 2); // All params bounded for now
       setulb_(&nparams, &m_maxVarMetCorr, &paramVals[0], &paramMins[0], 
-	      &paramMaxs[0], &nbd[0], &funcVal, &gradient[0], 
-	      &factr, &m_pgtol, &doubleWorkArray[0], &intWorkArray[0], 
-	      &task[0], &iprint, &csave[0], &lsave[0], &isave[0], &dsave[0], 
-	      task.size(), csave.size());
+	      &paramMaxs[0], &m_nbd[0], &funcVal, &gradient[0], 
+	      &factr, &m_pgtol, &m_doubleWorkArray[0], &m_intWorkArray[0], 
+	      &task[0], &iprint, &m_csave[0], &m_lsave[0], &m_isave[0], 
+	      &m_dsave[0], task.size(), m_csave.size());
       std::string taskString(task.begin(), task.end());
       int taskLength = taskString.find_last_not_of(' ') + 1;
       taskString.erase(taskLength); // Strip trailing blanks
@@ -94,14 +136,18 @@ namespace optimizers {
       if (taskString.substr(0,2) == "FG") {
 	// Request for values of function and gradient.
 	// LBFGS is a minimizer, so we must flip the signs to maximize.
-	m_stat->setFreeParamValues(paramVals);
-	funcVal = -m_stat->value();
-	m_stat->getFreeDerivs(gradient);
+	m_stat->valueAndFreeDerivs(paramVals, funcVal, gradient);
+	funcVal = -funcVal;
 	for (int i = 0; i < nparams; i++) {
 	  gradient[i] = -gradient[i];
 	}
 	m_numEvals++;
 	m_val = funcVal;
+	if (m_numEvals == 1) {
+	  notifyIteration(paramVals, -funcVal, 
+			  projectedGradientNorm(paramVals, gradient, 
+						paramMins, paramMaxs), noEdm);
+	}
 	
 	if (verbose != 0) {
            std::cout << m_numEvals << "  "
@@ -116,7 +162,10 @@ namespace optimizers {
       }  // Don't break.  Call setulb_ again
       else if (taskString.substr(0, 5) == "NEW_X") {
 	// Ready to move to a new set of parameter values
-	if (isave[33] > m_maxEval) {
+	notifyIteration(paramVals, -funcVal, 
+			projectedGradientNorm(paramVals, gradient, 
+					      paramMins, paramMaxs), noEdm);
+	if (m_isave[33] > m_maxEval) {
 	  setRetCode(LBFGS_TOOMANY);
 	  m_errorString = "Exceeded Specified Number of Iterations";
 	  break;
@@ -130,6 +179,9 @@ namespace optimizers {
       }  // Otherwise don't break.  Call setulb_ again.
       else if (taskString.substr(0, 4) == "CONV") {
 	// Normal convergence
+	notifyIteration(paramVals, -funcVal, 
+			projectedGradientNorm(paramVals, gradient, 
+					      paramMins, paramMaxs), noEdm);
 	setRetCode(LBFGS_NORMAL);
 	m_errorString = taskString;
 	break;
@@ -0,0 +1,1068 @@
+/**
+ * @file LbfgsB.cxx
+ * @brief Implementation of the native C++ L-BFGS-B Optimizer.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#include <cmath>
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <limits>
+
+#include "optimizers/Exception.h"
+#include "optimizers/LbfgsB.h"
+#include "optimizers/Parameter.h"
+#include "optimizers/Statistic.h"
+
+namespace {
+
+   const double epsmch(std::numeric_limits<double>::epsilon());
+
+/// Kernels over contiguous arrays.  The dot product keeps four
+/// partial sums, so that it vectorizes without reassociating flags.
+   double dot(const double * a, const double * b, size_t n) {
+      double s0(0), s1(0), s2(0), s3(0);
+      size_t i(0);
+      for ( ; i + 4 <= n; i += 4) {
+         s0 += a[i]*b[i];
+         s1 += a[i + 1]*b[i + 1];
+         s2 += a[i + 2]*b[i + 2];
+         s3 += a[i + 3]*b[i + 3];
+      }
+      for ( ; i < n; i++) {
+         s0 += a[i]*b[i];
+      }
+      return (s0 + s1) + (s2 + s3);
+   }
+
+   void axpy(double alpha, const double * x, double * y, size_t n) {
+      for (size_t i = 0; i < n; i++) {
+         y[i] += alpha*x[i];
+      }
+   }
+
+/// The dot product over the elements listed in index.
+   double dot(const double * a, const double * b, const size_t * index,
+              size_t n) {
+      double sum(0);
+      for (size_t k = 0; k < n; k++) {
+         sum += a[index[k]]*b[index[k]];
+      }
+      return sum;
+   }
+
+   bool hasLower(int nbd) {
+      return nbd == 1 || nbd == 2;
+   }
+
+   bool hasUpper(int nbd) {
+      return nbd == 2 || nbd == 3;
+   }
+
+/// LU factorization, with partial pivoting, of the n x n row-major
+/// matrix a, in place.  @return false if a is singular.
+   bool luFactor(std::vector<double> & a, size_t n,
+                 std::vector<size_t> & pivots) {
+      pivots.resize(n);
+      for (size_t k = 0; k < n; k++) {
+         size_t ipiv(k);
+         for (size_t i = k + 1; i < n; i++) {
+            if (std::fabs(a[i*n + k]) > std::fabs(a[ipiv*n + k])) {
+               ipiv = i;
+            }
+         }
+         pivots[k] = ipiv;
+         if (a[ipiv*n + k] == 0) {
+            return false;
+         }
+         if (ipiv != k) {
+            std::swap_ranges(a.begin() + k*n, a.begin() + (k + 1)*n,
+                             a.begin() + ipiv*n);
+         }
+         for (size_t i = k + 1; i < n; i++) {
+            double factor(a[i*n + k] /= a[k*n + k]);
+            for (size_t j = k + 1; j < n; j++) {
+               a[i*n + j] -= factor*a[k*n + j];
+            }
+         }
+      }
+      return true;
+   }
+
+/// Overwrite b with the solution of a x = b, given the factors from
+/// luFactor.
+   void luSolve(const std::vector<double> & a, size_t n,
+                const std::vector<size_t> & pivots, double * b) {
+      for (size_t k = 0; k < n; k++) {
+         std::swap(b[k], b[pivots[k]]);
+      }
+      for (size_t k = 0; k < n; k++) {
+         for (size_t i = k + 1; i < n; i++) {
+            b[i] -= a[i*n + k]*b[k];
+         }
+      }
+      for (size_t k = n; k-- > 0; ) {
+         for (size_t j = k + 1; j < n; j++) {
+            b[k] -= a[k*n + j]*b[j];
+         }
+         b[k] /= a[k*n + k];
+      }
+   }
+
+/// The safeguarded step of MINPACK-2 dcstep: update the interval
+/// [stx, sty] that contains a step satisfying the strong Wolfe
+/// conditions, and choose the next trial step stp.
+   void dcstep(double & stx, double & fx, double & dx,
+               double & sty, double & fy, double & dy,
+               double & stp, double fp, double dp, bool & brackt,
+               double stpmin, double stpmax) {
+      double sgnd(dx == 0 ? 0 : (dx < 0 ? -dp : dp));
+      double stpf;
+      if (fp > fx) {
+// A higher function value: the minimum is bracketed.
+         double theta(3.*(fx - fp)/(stp - stx) + dx + dp);
+         double s(std::max(std::fabs(theta),
+                           std::max(std::fabs(dx), std::fabs(dp))));
+         double gamma(s*std::sqrt(std::max(0., (theta/s)*(theta/s)
+                                           - (dx/s)*(dp/s))));
+         if (stp < stx) {
+            gamma = -gamma;
+         }
+         double p((gamma - dx) + theta);
+         double q(((gamma - dx) + gamma) + dp);
+         double stpc(stx + p/q*(stp - stx));
+         double stpq(stx + ((dx/((fx - fp)/(stp - stx) + dx))/2.)
+                     *(stp - stx));
+         if (std::fabs(stpc - stx) < std::fabs(stpq - stx)) {
+            stpf = stpc;
+         } else {
+            stpf = stpc + (stpq - stpc)/2.;
+         }
+         brackt = true;
+      } else if (sgnd < 0) {
+// A lower function value and derivatives of opposite sign.
+         double theta(3.*(fx - fp)/(stp - stx) + dx + dp);
+         double s(std::max(std::fabs(theta),
+                           std::max(std::fabs(dx), std::fabs(dp))));
+         double gamma(s*std::sqrt(std::max(0., (theta/s)*(theta/s)
+                                           - (dx/s)*(dp/s))));
+         if (stp > stx) {
+            gamma = -gamma;
+         }
+         double p((gamma - dp) + theta);
+         double q(((gamma - dp) + gamma) + dx);
+         double stpc(stp + p/q*(stx - stp));
+         double stpq(stp + (dp/(dp - dx))*(stx - stp));
+         if (std::fabs(stpc - stp) > std::fabs(stpq - stp)) {
+            stpf = stpc;
+         } else {
+            stpf = stpq;
+         }
+         brackt = true;
+      } else if (std::fabs(dp) < std::fabs(dx)) {
+// A lower function value, derivatives of the same sign, and a
+// decreasing magnitude of the derivative.
+         double theta(3.*(fx - fp)/(stp - stx) + dx + dp);
+         double s(std::max(std::fabs(theta),
+                           std::max(std::fabs(dx), std::fabs(dp))));
+         double gamma(s*std::sqrt(std::max(0., (theta/s)*(theta/s)
+                                           - (dx/s)*(dp/s))));
+         if (stp > stx) {
+            gamma = -gamma;
+         }
+         double p((gamma - dp) + theta);
+         double q((gamma + (dx - dp)) + gamma);
+         double r(p/q);
+         double stpc;
+         if (r < 0 && gamma != 0) {
+            stpc = stp + r*(stx - stp);
+         } else if (stp > stx) {
+            stpc = stpmax;
+         } else {
+            stpc = stpmin;
+         }
+         double stpq(stp + (dp/(dp - dx))*(stx - stp));
+         if (brackt) {
+            if (std::fabs(stpc - stp) < std::fabs(stpq - stp)) {
+               stpf = stpc;
+            } else {
+               stpf = stpq;
+            }
+            if (stp > stx) {
+               stpf = std::min(stp + 0.66*(sty - stp), stpf);
+            } else {
+               stpf = std::max(stp + 0.66*(sty - stp), stpf);
+            }
+         } else {
+            if (std::fabs(stpc - stp) > std::fabs(stpq - stp)) {
+               stpf = stpc;
+            } else {
+               stpf = stpq;
+            }
+            stpf = std::max(stpmin, std::min(stpmax, stpf));
+         }
+      } else {
+// A lower function value, derivatives of the same sign, and no
+// decrease in the magnitude of the derivative.
+         if (brackt) {
+            double theta(3.*(fp - fy)/(sty - stp) + dy + dp);
+            double s(std::max(std::fabs(theta),
+                              std::max(std::fabs(dy), std::fabs(dp))));
+            double gamma(s*std::sqrt(std::max(0., (theta/s)*(theta/s)
+                                              - (dy/s)*(dp/s))));
+            if (stp > sty) {
+               gamma = -gamma;
+            }
+            double p((gamma - dp) + theta);
+            double q(((gamma - dp) + gamma) + dy);
+            stpf = stp + p/q*(sty - stp);
+         } else if (stp > stx) {
+            stpf = stpmax;
+         } else {
+            stpf = stpmin;
+         }
+      }
+      if (fp > fx) {
+         sty = stp;
+         fy = fp;
+         dy = dp;
+      } else {
+         if (sgnd < 0) {
+            sty = stx;
+            fy = fx;
+            dy = dx;
+         }
+         stx = stp;
+         fx = fp;
+         dx = dp;
+      }
+      stp = stpf;
+   }
+
+/**
+ * @class LineSearch
+ *
+ * @brief The line search of Moré & Thuente 1994, ACM TOMS, 20, 286,
+ * as in MINPACK-2 dcsrch, for a step satisfying the strong Wolfe
+ * conditions.  The caller evaluates the function and its directional
+ * derivative at each trial step proposed by next().
+ */
+   class LineSearch {
+   public:
+      enum Status {SEARCHING, CONVERGED, WARNING};
+
+      LineSearch(double ftol, double gtol, double xtol,
+                 double stpmin, double stpmax)
+         : m_ftol(ftol), m_gtol(gtol), m_xtol(xtol), m_stpmin(stpmin),
+           m_stpmax(stpmax) {}
+
+      /// @param f The function value at the step of zero.
+      /// @param g The (negative) directional derivative there.
+      /// @param stp The first trial step.
+      void start(double f, double g, double stp) {
+         m_brackt = false;
+         m_stage = 1;
+         m_finit = f;
+         m_ginit = g;
+         m_gtest = m_ftol*g;
+         m_width = m_stpmax - m_stpmin;
+         m_width1 = 2.*m_width;
+         m_stx = 0;
+         m_fx = f;
+         m_gx = g;
+         m_sty = 0;
+         m_fy = f;
+         m_gy = g;
+         m_stmin = 0;
+         m_stmax = stp + 4.*stp;
+      }
+
+      /// Given the function value and directional derivative at stp,
+      /// either accept stp or replace it with the next trial step.
+      Status next(double f, double g, double & stp) {
+         double ftest(m_finit + stp*m_gtest);
+         if (m_stage == 1 && f <= ftest && g >= 0) {
+            m_stage = 2;
+         }
+         if (f <= ftest && std::fabs(g) <= m_gtol*(-m_ginit)) {
+            return CONVERGED;
+         }
+         if ((m_brackt && (stp <= m_stmin || stp >= m_stmax))
+             || (m_brackt && m_stmax - m_stmin <= m_xtol*m_stmax)
+             || (stp == m_stpmax && f <= ftest && g <= m_gtest)
+             || (stp == m_stpmin && (f > ftest || g >= m_gtest))) {
+            return WARNING;
+         }
+         if (m_stage == 1 && f <= m_fx && f > ftest) {
+// Use the function modified to have a minimum at the sufficient
+// decrease line until the step has been bracketed.
+            double fm(f - stp*m_gtest);
+            double fxm(m_fx - m_stx*m_gtest);
+            double fym(m_fy - m_sty*m_gtest);
+            double gm(g - m_gtest);
+            double gxm(m_gx - m_gtest);
+            double gym(m_gy - m_gtest);
+            dcstep(m_stx, fxm, gxm, m_sty, fym, gym, stp, fm, gm, m_brackt,
+                   m_stmin, m_stmax);
+            m_fx = fxm + m_stx*m_gtest;
+            m_fy = fym + m_sty*m_gtest;
+            m_gx = gxm + m_gtest;
+            m_gy = gym + m_gtest;
+         } else {
+            dcstep(m_stx, m_fx, m_gx, m_sty, m_fy, m_gy, stp, f, g, m_brackt,
+                   m_stmin, m_stmax);
+         }
+         if (m_brackt) {
+            if (std::fabs(m_sty - m_stx) >= 0.66*m_width1) {
+               stp = m_stx + 0.5*(m_sty - m_stx);
+            }
+            m_width1 = m_width;
+            m_width = std::fabs(m_sty - m_stx);
+            m_stmin = std::min(m_stx, m_sty);
+            m_stmax = std::max(m_stx, m_sty);
+         } else {
+            m_stmin = stp + 1.1*(stp - m_stx);
+            m_stmax = stp + 4.*(stp - m_stx);
+         }
+         stp = std::max(m_stpmin, std::min(m_stpmax, stp));
+         if (m_brackt && (stp <= m_stmin || stp >= m_stmax
+                          || m_stmax - m_stmin <= m_xtol*m_stmax)) {
+            stp = m_stx;
+         }
+         return SEARCHING;
+      }
+
+   private:
+      double m_ftol;
+      double m_gtol;
+      double m_xtol;
+      double m_stpmin;
+      double m_stpmax;
+
+      bool m_brackt;
+      int m_stage;
+      double m_finit;
+      double m_ginit;
+      double m_gtest;
+      double m_width;
+      double m_width1;
+      double m_stx;
+      double m_fx;
+      double m_gx;
+      double m_sty;
+      double m_fy;
+      double m_gy;
+      double m_stmin;
+      double m_stmax;
+   };
+}
+
+namespace optimizers {
+
+int LbfgsB::find_min(int verbose, double tol, int tolType) {
+   clearEvaluationCache();
+   Instrumentation::Timer timer(instruments(), Instrumentation::FIND_MIN);
+
+   m_numEvals = 0;
+   m_iter = 0;
+   m_nskip = 0;
+   m_errorString.erase();
+   beginIterations();
+   const double noEdm = std::numeric_limits<double>::quiet_NaN();
+
+   std::vector<Parameter> params;
+   m_stat->getFreeParams(params);
+   const size_t n(params.size());
+   const int m(m_maxVarMetCorr);
+   if (n == 0 || m <= 0) {
+      setRetCode(LBFGS_ERROR);
+      m_errorString = n == 0 ? "ERROR: N .LE. 0" : "ERROR: M .LE. 0";
+      throw Exception(m_errorString, LBFGS_ERROR);
+   }
+
+// Start from the projection of the parameter values onto the bounds.
+   m_x.resize(n);
+   m_lower.resize(n);
+   m_upper.resize(n);
+   m_nbd.resize(n);
+   m_iwhere.resize(n);
+   bool constrained(false);
+   bool boxed(true);
+   for (size_t i = 0; i < n; i++) {
+      m_lower[i] = params[i].effectiveBounds().first;
+      m_upper[i] = params[i].effectiveBounds().second;
+      bool lower(!std::isinf(m_lower[i]));
+      bool upper(!std::isinf(m_upper[i]));
+      m_nbd[i] = lower ? (upper ? 2 : 1) : (upper ? 3 : 0);
+      m_x[i] = params[i].getValue();
+      if (lower) {
+         m_x[i] = std::max(m_x[i], m_lower[i]);
+      }
+      if (upper) {
+         m_x[i] = std::min(m_x[i], m_upper[i]);
+      }
+      if (m_nbd[i] == 0) {
+         m_iwhere[i] = -1;
+      } else if (m_nbd[i] == 2 && m_upper[i] - m_lower[i] <= 0) {
+         m_iwhere[i] = 3;
+      } else {
+         m_iwhere[i] = 0;
+      }
+      constrained = constrained || m_nbd[i] != 0;
+      boxed = boxed && m_nbd[i] == 2;
+   }
+
+// Workspace.  The sizes only change with nparams and m, so that
+// repeated fits of the same size do not reallocate.
+   m_grad.resize(n);
+   m_s.resize(m*n);
+   m_y.resize(m*n);
+   m_ss.assign(m*m, 0);
+   m_sy.assign(m*m, 0);
+   m_yy.assign(m*m, 0);
+   m_xcp.resize(n);
+   m_dir.resize(n);
+   m_xold.resize(n);
+   m_gold.resize(n);
+   m_work.resize(n);
+   m_p.resize(2*m);
+   m_c.resize(2*m);
+   m_v.resize(2*m);
+   m_wbp.resize(2*m);
+   resetCorrections();
+
+// The same convergence test on the relative reduction of the
+// function as Lbfgs passes to setulb_.
+   double factr(epsmch);
+   if (tolType == RELATIVE) {
+      factr *= tol;
+   }
+   const double reltol(factr*epsmch);
+
+   double f;
+   evaluate(f, verbose);
+   notifyIteration(m_x, -f, projectedGradient(), noEdm);
+   if (m_sbgnrm <= m_pgtol) {
+      setRetCode(LBFGS_NORMAL);
+      m_errorString = "CONVERGENCE: NORM_OF_PROJECTED_GRADIENT_<=_PGTOL";
+      m_stat->setFreeParamValues(m_x);
+      return getRetCode();
+   }
+
+   double oldVal(0);
+   for (;;) {
+// The search direction, to the minimizer of the quadratic model
+// along the projected gradient path, and then over the variables
+// that are still free there.  For unbounded problems the first of
+// these is skipped once there are corrections.
+      if (m_col > 0 && !formMiddle()) {
+         resetCorrections();
+         continue;
+      }
+      if (!constrained && m_col > 0) {
+         m_xcp = m_x;
+      } else {
+         cauchy();
+      }
+      freeVariables();
+      if (m_nfree > 0 && m_col > 0 && !subspaceMinimization(constrained)) {
+         resetCorrections();
+         continue;
+      }
+      for (size_t i = 0; i < n; i++) {
+         m_dir[i] = m_xcp[i] - m_x[i];
+      }
+
+// The longest step that stays within the bounds.
+      double stpmax(1e10);
+      if (constrained) {
+         if (m_iter == 0) {
+            stpmax = 1;
+         } else {
+            for (size_t i = 0; i < n; i++) {
+               double a1(m_dir[i]);
+               if (a1 < 0 && hasLower(m_nbd[i])) {
+                  double a2(m_lower[i] - m_x[i]);
+                  if (a2 >= 0) {
+                     stpmax = 0;
+                  } else if (a1*stpmax < a2) {
+                     stpmax = a2/a1;
+                  }
+               } else if (a1 > 0 && hasUpper(m_nbd[i])) {
+                  double a2(m_upper[i] - m_x[i]);
+                  if (a2 <= 0) {
+                     stpmax = 0;
+                  } else if (a1*stpmax > a2) {
+                     stpmax = a2/a1;
+                  }
+               }
+            }
+         }
+      }
+
+      m_xold.swap(m_x);
+      m_gold.swap(m_grad);
+      const double fold(f);
+      const double gdold(dot(&m_gold[0], &m_dir[0], n));
+      double stp(1);
+      bool failed(gdold >= 0 || stpmax <= 0);
+      if (!failed) {
+         if (m_iter == 0 && !boxed) {
+            stp = std::min(1./std::sqrt(dot(&m_dir[0], &m_dir[0], n)),
+                           stpmax);
+         }
+         stp = std::min(stp, stpmax);
+         LineSearch search(1e-3, 0.9, 0.1, 0, stpmax);
+         search.start(f, gdold, stp);
+         for (int ifun = 1; ; ifun++) {
+            if (ifun > 20) {
+               failed = true;
+               break;
+            }
+            if (stp == 1) {
+               m_x = m_xcp;
+            } else {
+               for (size_t i = 0; i < n; i++) {
+                  m_x[i] = m_xold[i] + stp*m_dir[i];
+// Guard against rounding just outside of the bounds.
+                  if (hasLower(m_nbd[i])) {
+                     m_x[i] = std::max(m_x[i], m_lower[i]);
+                  }
+                  if (hasUpper(m_nbd[i])) {
+                     m_x[i] = std::min(m_x[i], m_upper[i]);
+                  }
+               }
+            }
+            evaluate(f, verbose);
+            double gd(dot(&m_grad[0], &m_dir[0], n));
+            if (search.next(f, gd, stp) != LineSearch::SEARCHING) {
+               break;
+            }
+         }
+      }
+      if (failed) {
+// Return to the previous iterate, and try again with the steepest
+// descent direction unless that is what just failed.
+         m_x.swap(m_xold);
+         m_grad.swap(m_gold);
+         f = fold;
+         if (m_col == 0) {
+            m_iter++;
+            setRetCode(LBFGS_ABNO);
+            m_errorString = "ABNORMAL_TERMINATION_IN_LNSRCH";
+            m_val = f;
+            m_stat->setFreeParamValues(m_x);
+            throw Exception(m_errorString, LBFGS_ABNO);
+         }
+         resetCorrections();
+         continue;
+      }
+
+      m_iter++;
+      notifyIteration(m_x, -f, projectedGradient(), noEdm);
+      if (m_numEvals > m_maxEval) {
+         setRetCode(LBFGS_TOOMANY);
+         m_errorString = "Exceeded Specified Number of Iterations";
+         break;
+      }
+      if (tolType == ABSOLUTE && oldVal != 0. && std::fabs(f - oldVal) < tol) {
+         setRetCode(LBFGS_NORMAL);
+         m_errorString = "Absolute Convergence";
+         break;
+      }
+      oldVal = f;
+      if (m_sbgnrm <= m_pgtol) {
+         setRetCode(LBFGS_NORMAL);
+         m_errorString = "CONVERGENCE: NORM_OF_PROJECTED_GRADIENT_<=_PGTOL";
+         break;
+      }
+      double scale(std::max(std::max(std::fabs(fold), std::fabs(f)), 1.));
+      if (fold - f <= reltol*scale) {
+         setRetCode(LBFGS_NORMAL);
+         m_errorString = "CONVERGENCE: REL_REDUCTION_OF_F_<=_FACTR*EPSMCH";
+         break;
+      }
+
+// The new correction pair, in place of the previous point and
+// gradient.  It is skipped unless s^T y is sufficiently positive.
+      for (size_t i = 0; i < n; i++) {
+         m_xold[i] = m_x[i] - m_xold[i];
+         m_gold[i] = m_grad[i] - m_gold[i];
+      }
+      double dr(dot(&m_xold[0], &m_gold[0], n));
+      if (dr <= -epsmch*gdold*stp) {
+         m_nskip++;
+      } else {
+         addCorrection(dot(&m_gold[0], &m_gold[0], n), dr);
+      }
+   }
+
+   m_val = f;
+   m_stat->setFreeParamValues(m_x);
+   return getRetCode();
+}
+
+void LbfgsB::evaluate(double & f, int verbose) {
+// L-BFGS-B is a minimizer, so the signs are flipped to maximize.
+   m_stat->valueAndFreeDerivs(m_x, f, m_grad);
+   f = -f;
+   for (size_t i = 0; i < m_grad.size(); i++) {
+      m_grad[i] = -m_grad[i];
+   }
+   m_numEvals++;
+   m_val = f;
+   if (verbose != 0) {
+      std::cout << m_numEvals << "  " << f << std::endl;
+   }
+}
+
+double LbfgsB::projectedGradient() {
+   double sum(0);
+   m_sbgnrm = 0;
+   for (size_t i = 0; i < m_x.size(); i++) {
+      double gi(m_grad[i]);
+      if (gi < 0) {
+         if (hasUpper(m_nbd[i])) {
+            gi = std::max(m_x[i] - m_upper[i], gi);
+         }
+      } else if (hasLower(m_nbd[i])) {
+         gi = std::min(m_x[i] - m_lower[i], gi);
+      }
+      m_sbgnrm = std::max(m_sbgnrm, std::fabs(gi));
+      sum += gi*gi;
+   }
+   return std::sqrt(sum);
+}
+
+void LbfgsB::resetCorrections() {
+   m_head = 0;
+   m_col = 0;
+   m_theta = 1;
+}
+
+void LbfgsB::addCorrection(double yy, double sy) {
+   const size_t n(m_x.size());
+   const int m(m_maxVarMetCorr);
+   if (m_col < m) {
+      m_col++;
+   } else {
+// Drop the oldest pair.
+      m_head = (m_head + 1) % m;
+      for (int i = 0; i < m - 1; i++) {
+         for (int j = 0; j < m - 1; j++) {
+            m_ss[i*m + j] = m_ss[(i + 1)*m + j + 1];
+            m_sy[i*m + j] = m_sy[(i + 1)*m + j + 1];
+            m_yy[i*m + j] = m_yy[(i + 1)*m + j + 1];
+         }
+      }
+   }
+   int k(m_col - 1);
+   size_t slot((m_head + k) % m);
+   std::copy(m_xold.begin(), m_xold.end(), m_s.begin() + slot*n);
+   std::copy(m_gold.begin(), m_gold.end(), m_y.begin() + slot*n);
+   m_theta = yy/sy;
+   for (int j = 0; j <= k; j++) {
+      m_ss[k*m + j] = m_ss[j*m + k] = dot(s(k), s(j), n);
+      m_yy[k*m + j] = m_yy[j*m + k] = dot(y(k), y(j), n);
+      m_sy[k*m + j] = dot(s(k), y(j), n);
+      m_sy[j*m + k] = dot(s(j), y(k), n);
+   }
+}
+
+void LbfgsB::fillMiddle(std::vector<double> & a) const {
+   const size_t col(m_col);
+   const size_t col2(2*col);
+   const size_t m(m_maxVarMetCorr);
+   a.assign(col2*col2, 0);
+   for (size_t i = 0; i < col; i++) {
+      a[i*col2 + i] = -m_sy[i*m + i];
+      for (size_t j = 0; j < col; j++) {
+         if (j > i) {
+            a[i*col2 + col + j] = m_sy[j*m + i];
+         } else if (j < i) {
+            a[(col + i)*col2 + j] = m_sy[i*m + j];
+         }
+         a[(col + i)*col2 + col + j] = m_theta*m_ss[i*m + j];
+      }
+   }
+}
+
+bool LbfgsB::formMiddle() {
+   fillMiddle(m_middle);
+   return luFactor(m_middle, 2*m_col, m_middlePivots);
+}
+
+void LbfgsB::middleTimes(const double * v) {
+   std::copy(v, v + 2*m_col, m_v.begin());
+   luSolve(m_middle, 2*m_col, m_middlePivots, &m_v[0]);
+}
+
+void LbfgsB::cauchy() {
+   const size_t n(m_x.size());
+   const size_t col(m_col);
+   const size_t col2(2*col);
+   double * d(&m_dir[0]);
+
+// The projected steepest descent direction and the steps along it
+// at which variables reach their bounds.
+   m_xcp = m_x;
+   m_breaks.clear();
+   double f1(0);
+   bool bounded(true);
+   size_t nunbounded(0);
+   for (size_t i = 0; i < n; i++) {
+      double neggi(-m_grad[i]);
+      int nbd(m_nbd[i]);
+      double tl(0);
+      double tu(0);
+      if (m_iwhere[i] != 3 && m_iwhere[i] != -1) {
+         if (hasLower(nbd)) {
+            tl = m_x[i] - m_lower[i];
+         }
+         if (hasUpper(nbd)) {
+            tu = m_upper[i] - m_x[i];
+         }
+         m_iwhere[i] = 0;
+         if (hasLower(nbd) && tl <= 0) {
+            if (neggi <= 0) {
+               m_iwhere[i] = 1;
+            }
+         } else if (hasUpper(nbd) && tu <= 0) {
+            if (neggi >= 0) {
+               m_iwhere[i] = 2;
+            }
+         } else if (neggi == 0) {
+            m_iwhere[i] = -3;
+         }
+      }
+      if (m_iwhere[i] != 0 && m_iwhere[i] != -1) {
+         d[i] = 0;
+         continue;
+      }
+      d[i] = neggi;
+      f1 -= neggi*neggi;
+      if (hasLower(nbd) && neggi < 0) {
+         m_breaks.push_back(std::make_pair(tl/(-neggi), i));
+      } else if (hasUpper(nbd) && neggi > 0) {
+         m_breaks.push_back(std::make_pair(tu/neggi, i));
+      } else {
+         nunbounded++;
+         if (neggi != 0) {
+            bounded = false;
+         }
+      }
+   }
+   std::fill(m_c.begin(), m_c.begin() + col2, 0);
+   if (m_breaks.empty() && nunbounded == 0) {
+// The projected gradient is zero, and x is the Cauchy point.
+      return;
+   }
+
+// Search the piecewise linear path for the first local minimizer of
+// the quadratic model, with f1 and f2 its first and second
+// derivatives on the current segment, p = W^T d and c = W^T (xcp - x).
+   for (size_t j = 0; j < col; j++) {
+      m_p[j] = dot(y(j), d, n);
+      m_p[col + j] = m_theta*dot(s(j), d, n);
+   }
+   double f2(-m_theta*f1);
+   if (col > 0) {
+      middleTimes(&m_p[0]);
+      f2 -= dot(&m_v[0], &m_p[0], col2);
+   }
+   const double f2_org(f2);
+   double dtm(-f1/f2);
+   double tsum(0);
+   double tj0(0);
+   const size_t nbreak(m_breaks.size());
+   size_t nleft(nbreak);
+   bool allFixed(false);
+   std::greater< std::pair<double, size_t> > later;
+   std::make_heap(m_breaks.begin(), m_breaks.end(), later);
+   while (nleft > 0) {
+      std::pop_heap(m_breaks.begin(), m_breaks.begin() + nleft, later);
+      double tj(m_breaks[nleft - 1].first);
+      size_t ibp(m_breaks[nleft - 1].second);
+      double dt(tj - tj0);
+      if (dtm < dt) {
+         break;
+      }
+// Fix the variable at this breakpoint.
+      tsum += dt;
+      nleft--;
+      double dibp(d[ibp]);
+      d[ibp] = 0;
+      double zibp;
+      if (dibp > 0) {
+         zibp = m_upper[ibp] - m_x[ibp];
+         m_xcp[ibp] = m_upper[ibp];
+         m_iwhere[ibp] = 2;
+      } else {
+         zibp = m_lower[ibp] - m_x[ibp];
+         m_xcp[ibp] = m_lower[ibp];
+         m_iwhere[ibp] = 1;
+      }
+      if (nleft == 0 && nbreak == n) {
+         dtm = dt;
+         allFixed = true;
+         break;
+      }
+      double dibp2(dibp*dibp);
+      f1 += dt*f2 + dibp2 - m_theta*dibp*zibp;
+      f2 -= m_theta*dibp2;
+      if (col > 0) {
+         axpy(dt, &m_p[0], &m_c[0], col2);
+         for (size_t j = 0; j < col; j++) {
+            m_wbp[j] = y(j)[ibp];
+            m_wbp[col + j] = m_theta*s(j)[ibp];
+         }
+         middleTimes(&m_wbp[0]);
+         double wmc(dot(&m_c[0], &m_v[0], col2));
+         double wmp(dot(&m_p[0], &m_v[0], col2));
+         double wmw(dot(&m_wbp[0], &m_v[0], col2));
+         axpy(-dibp, &m_wbp[0], &m_p[0], col2);
+         f1 += dibp*wmc;
+         f2 += 2.*dibp*wmp - dibp2*wmw;
+      }
+      f2 = std::max(epsmch*f2_org, f2);
+      if (nleft > 0) {
+         dtm = -f1/f2;
+         tj0 = tj;
+      } else if (bounded) {
+         dtm = 0;
+      } else {
+         dtm = -f1/f2;
+      }
+   }
+   if (!allFixed) {
+      dtm = std::max(dtm, 0.);
+      tsum += dtm;
+      axpy(tsum, d, &m_xcp[0], n);
+   }
+   if (col > 0) {
+      axpy(dtm, &m_p[0], &m_c[0], col2);
+   }
+}
+
+void LbfgsB::freeVariables() {
+   const size_t n(m_x.size());
+   m_index.resize(n);
+   size_t nfree(0);
+   size_t iact(n);
+   for (size_t i = 0; i < n; i++) {
+      if (m_iwhere[i] <= 0) {
+         m_index[nfree++] = i;
+      } else {
+         m_index[--iact] = i;
+      }
+   }
+   m_nfree = nfree;
+}
+
+bool LbfgsB::subspaceMinimization(bool constrained) {
+   const size_t n(m_x.size());
+   const size_t nsub(m_nfree);
+   const bool all(nsub == n);
+   const size_t * index(&m_index[0]);
+   const size_t col(m_col);
+   const size_t col2(2*col);
+   const size_t m(m_maxVarMetCorr);
+
+// The reduced gradient of the quadratic model at the Cauchy point,
+// r = -Z^T (g + theta*(xcp - x) - W M c).  If all the variables are
+// free, it is indexed like x.
+   double * r(&m_work[0]);
+   if (!constrained) {
+      for (size_t i = 0; i < n; i++) {
+         r[i] = -m_grad[i];
+      }
+   } else {
+      for (size_t k = 0; k < nsub; k++) {
+         size_t i(index[k]);
+         r[k] = -m_theta*(m_xcp[i] - m_x[i]) - m_grad[i];
+      }
+      middleTimes(&m_c[0]);
+      for (size_t j = 0; j < col; j++) {
+         double a1(m_v[j]);
+         double a2(m_theta*m_v[col + j]);
+         const double * yj(y(j));
+         const double * sj(s(j));
+         if (all) {
+            axpy(a1, yj, r, n);
+            axpy(a2, sj, r, n);
+         } else {
+            for (size_t k = 0; k < nsub; k++) {
+               r[k] += yj[index[k]]*a1 + sj[index[k]]*a2;
+            }
+         }
+      }
+   }
+
+// The Newton step on the free variables, -B_Z^{-1} r, from the
+// Sherman-Morrison-Woodbury formula, r/theta + W_Z w/theta^2 with
+// (M^{-1} - W_Z^T W_Z/theta) w = W_Z^T r.
+   double * w(&m_p[0]);
+   for (size_t j = 0; j < col; j++) {
+      double ysum(0);
+      double ssum(0);
+      if (all) {
+         ysum = dot(y(j), r, n);
+         ssum = dot(s(j), r, n);
+      } else {
+         for (size_t k = 0; k < nsub; k++) {
+            ysum += y(j)[index[k]]*r[k];
+            ssum += s(j)[index[k]]*r[k];
+         }
+      }
+      w[j] = ysum;
+      w[col + j] = m_theta*ssum;
+   }
+   fillMiddle(m_kmat);
+   double * kmat(&m_kmat[0]);
+   for (size_t i = 0; i < col; i++) {
+      for (size_t j = 0; j < col; j++) {
+         kmat[i*col2 + j] -= m_yy[i*m + j]/m_theta;
+         kmat[i*col2 + col + j] -= m_sy[j*m + i];
+         kmat[(col + i)*col2 + j] -= m_sy[i*m + j];
+         kmat[(col + i)*col2 + col + j] -= m_theta*m_ss[i*m + j];
+      }
+   }
+   if (!all) {
+// Add back the inner products over the fixed variables, or, if
+// there are fewer free ones, start over from those.
+      bool fixed(2*nsub > n);
+      const size_t * set(fixed ? index + nsub : index);
+      size_t nset(fixed ? n - nsub : nsub);
+      if (!fixed) {
+         fillMiddle(m_kmat);
+      }
+      for (size_t i = 0; i < col; i++) {
+         for (size_t j = 0; j < col; j++) {
+            double yy(dot(y(i), y(j), set, nset));
+            double ys(dot(y(i), s(j), set, nset));
+            double sy(dot(s(i), y(j), set, nset));
+            double ss(dot(s(i), s(j), set, nset));
+            double sign(fixed ? 1. : -1.);
+            kmat[i*col2 + j] += sign*yy/m_theta;
+            kmat[i*col2 + col + j] += sign*ys;
+            kmat[(col + i)*col2 + j] += sign*sy;
+            kmat[(col + i)*col2 + col + j] += sign*m_theta*ss;
+         }
+      }
+   }
+   if (!luFactor(m_kmat, col2, m_kPivots)) {
+      return false;
+   }
+   luSolve(m_kmat, col2, m_kPivots, w);
+   for (size_t k = 0; k < nsub; k++) {
+      r[k] /= m_theta;
+   }
+   for (size_t j = 0; j < col; j++) {
+      double a1(w[j]/(m_theta*m_theta));
+      double a2(w[col + j]/m_theta);
+      const double * yj(y(j));
+      const double * sj(s(j));
+      if (all) {
+         axpy(a1, yj, r, n);
+         axpy(a2, sj, r, n);
+      } else {
+         for (size_t k = 0; k < nsub; k++) {
+            r[k] += yj[index[k]]*a1 + sj[index[k]]*a2;
+         }
+      }
+   }
+   if (!constrained) {
+      axpy(1., r, &m_xcp[0], n);
+      return true;
+   }
+
+// Project the step from the Cauchy point onto the bounds.  If that
+// does not give a descent direction from x, step from the Cauchy
+// point only as far as the first bound.
+   m_dir = m_xcp;
+   bool projected(false);
+   for (size_t k = 0; k < nsub; k++) {
+      size_t i(index[k]);
+      double xi(m_xcp[i] + r[k]);
+      if (hasLower(m_nbd[i]) && xi <= m_lower[i]) {
+         xi = m_lower[i];
+         projected = true;
+      } else if (hasUpper(m_nbd[i]) && xi >= m_upper[i]) {
+         xi = m_upper[i];
+         projected = true;
+      }
+      m_xcp[i] = xi;
+   }
+   if (!projected) {
+      return true;
+   }
+   double ddp(0);
+   for (size_t i = 0; i < n; i++) {
+      ddp += (m_xcp[i] - m_x[i])*m_grad[i];
+   }
+   if (ddp <= 0) {
+      return true;
+   }
+   m_xcp.swap(m_dir);
+   double alpha(1);
+   size_t ibd(nsub);
+   for (size_t k = 0; k < nsub; k++) {
+      size_t i(index[k]);
+      double dk(r[k]);
+      double step(alpha);
+      if (dk < 0 && hasLower(m_nbd[i])) {
+         double room(m_lower[i] - m_xcp[i]);
+         if (room >= 0) {
+            step = 0;
+         } else if (dk*alpha < room) {
+            step = room/dk;
+         }
+      } else if (dk > 0 && hasUpper(m_nbd[i])) {
+         double room(m_upper[i] - m_xcp[i]);
+         if (room <= 0) {
+            step = 0;
+         } else if (dk*alpha > room) {
+            step = room/dk;
+         }
+      }
+      if (step < alpha) {
+         alpha = step;
+         ibd = k;
+      }
+   }
+   if (alpha < 1) {
+      size_t i(index[ibd]);
+      if (r[ibd] > 0) {
+         m_xcp[i] = m_upper[i];
+      } else {
+         m_xcp[i] = m_lower[i];
+      }
+      r[ibd] = 0;
+   }
+   for (size_t k = 0; k < nsub; k++) {
+      m_xcp[index[k]] += alpha*r[k];
+   }
+   return true;
+}
+
+void LbfgsB::getCorrection(int i, std::vector<double> & sv,
+                           std::vector<double> & yv) const {
+   if (i < 0 || i >= m_col) {
+      throw Exception("LbfgsB::getCorrection: no such correction pair.");
+   }
+   sv.assign(s(i), s(i) + m_x.size());
+   yv.assign(y(i), y(i) + m_x.size());
+}
+
+std::ostream & LbfgsB::put(std::ostream & s) const {
+   s << "LBFGS-B returned a function value of " << m_val << std::endl;
+   s << "after " << m_numEvals << " evaluations and " << m_iter
+     << " iterations." << std::endl;
+   return s;
+}
+
+} // namespace optimizers
@@ -8,161 +8,477 @@
  */
 
 #include <cmath>
-#include <cstdio>
-#include <cstring>
 
 #include <algorithm>
+#include <exception>
 #include <iostream>
+#include <memory>
 #include <sstream>
+#include <thread>
 
+#include "CLHEP/Random/MTwistEngine.h"
 #include "CLHEP/Random/RandFlat.h"
 
 #include "optimizers/dArg.h"
 #include "optimizers/Exception.h"
+#include "optimizers/FitsSampleSink.h"
 #include "optimizers/Mcmc.h"
 
 using CLHEP::RandFlat;
 
-namespace optimizers {
+namespace {
+   using optimizers::Parameter;
+
+/// Uniform deviate from the chain's own engine, or from the CLHEP
+/// static engine if there is none.
+   double uniform(CLHEP::HepRandomEngine * engine) {
+      if (engine) {
+         return RandFlat::shoot(engine);
+      }
+      return RandFlat::shoot();
+   }
+
+/// Standard normal deviate by the Box-Muller method.  The second
+/// deviate is discarded so that no state is kept between calls.
+   double gaussian(CLHEP::HepRandomEngine * engine) {
+      double u1;
+      do {
+         u1 = uniform(engine);
+      } while (u1 <= 0);
+      double u2 = uniform(engine);
+      return std::sqrt(-2.*std::log(u1))*std::cos(2.*M_PI*u2);
+   }
+
+   double drawTopHat(const Parameter & param, double dx, 
+                     double & transProbRatio,
+                     CLHEP::HepRandomEngine * engine) {
+// Normalize the top-hat function (i.e., find the width) at the input
+// Parameter location given the Parameter bounds.
+
+      double xl = param.getBounds().first;
+      double xu = param.getBounds().second;
+      double x0 = param.getValue();
+      double width = std::min(xu, x0 + dx) - std::max(xl, x0 - dx);
+
+// Draw the trial value...
+      double drand = uniform(engine);
+      double y = drand*width + std::max(xl, x0 - dx);
+
+// and compute the ratio of the transition probability densities
+      transProbRatio = width/(std::min(xu, y + dx) - std::max(xl, y - dx));
+
+      return y;
+   }
+
+   bool withinBounds(const std::vector<Parameter> & params,
+                     const std::vector<double> & values) {
+      for (size_t i = 0; i < params.size(); i++) {
+         if (values[i] < params[i].getBounds().first ||
+             values[i] > params[i].getBounds().second) {
+            return false;
+         }
+      }
+      return true;
+   }
+
+/// Column names used when the samples do not correspond to the
+/// free Parameters of the statistic.
+   void genericColumnNames(size_t ncols, std::vector<std::string> & names) {
+      names.clear();
+      for (size_t i = 0; i < ncols; i++) {
+         std::ostringstream type;
+         type << "param" << i;
+         names.push_back(type.str());
+      }
+   }
+
+/// In-place Cholesky factorization of the n x n row-major matrix a
+/// into its lower triangle.  Returns false if a is not positive
+/// definite, in which case a is left partially overwritten.
+   bool cholesky(std::vector<double> & a, size_t n) {
+      for (size_t j = 0; j < n; j++) {
+         double sum = a[j*n + j];
+         for (size_t k = 0; k < j; k++) {
+            sum -= a[j*n + k]*a[j*n + k];
+         }
+         if (sum <= 0) {
+            return false;
+         }
+         a[j*n + j] = std::sqrt(sum);
+         for (size_t i = j + 1; i < n; i++) {
+            double sum_i = a[i*n + j];
+            for (size_t k = 0; k < j; k++) {
+               sum_i -= a[i*n + k]*a[j*n + k];
+            }
+            a[i*n + j] = sum_i/a[j*n + j];
+         }
+         for (size_t k = j + 1; k < n; k++) {
+            a[j*n + k] = 0;
+         }
+      }
+      return true;
+   }
+}
 
-#include "fitsio.h"
+namespace optimizers {
 
 Mcmc::Mcmc(Function &stat, bool verbose) : m_stat(&stat), m_verbose(verbose) {
    estimateTransWidths();
 }
 
+void Mcmc::generateSamples(SampleBuffer & samples, unsigned long nsamp,
+                           bool clear) {
+   std::vector<double> paramValues;
+   m_stat->getFreeParamValues(paramValues);
+   size_t ncols(paramValues.size() + 1);
+
+   if (clear || samples.ncols() != ncols) {
+      if (!clear && !samples.empty()) {
+         throw Exception("Mcmc::generateSamples: sample buffer has the "
+                         "wrong number of columns.");
+      }
+      samples.setNcols(ncols);
+   }
+// Variable-at-a-time updates may overrun nsamp by up to a sweep.
+   samples.reserve(samples.size() + nsamp + paramValues.size());
+   generateSamples(static_cast<SampleSink &>(samples), nsamp);
+}
+
 void Mcmc::generateSamples(std::vector< std::vector<double> > &samples, 
                            unsigned long nsamp, bool clear) {
-// Dummy Arg object required by Function methods:
-   dArg dummy(1.);
+   if (clear) {
+      samples.clear();
+   }
+// Variable-at-a-time updates may overrun nsamp by up to a sweep.
+   samples.reserve(samples.size() + nsamp + m_stat->getNumFreeParams());
+   VectorSampleSink sink(samples);
+   generateSamples(sink, nsamp);
+}
 
-// Get initial values of Parameters... 
+void Mcmc::generateSamples(SampleSink & sink, unsigned long nsamp) {
    std::vector<double> paramValues;
    m_stat->getFreeParamValues(paramValues);
 
-// and the Parameter objects themselves (for the bounds information)
+   if (m_verbose) {
+      std::cerr << "Mcmc generating samples";
+   }
+   runChain(*m_stat, paramValues, nsamp, VARIABLE_AT_A_TIME, 0, sink,
+            m_verbose);
+   sink.flush();
+   if (m_verbose) {
+      std::cerr << "!" << std::endl;
+   }
+}
+
+void Mcmc::getColumnNames(std::vector<std::string> & names) const {
    std::vector<Parameter> params;
    m_stat->getFreeParams(params);
+   names.clear();
+   for (size_t i = 0; i < params.size(); i++) {
+      names.push_back(params[i].getName());
+   }
+   names.push_back("Statistic");
+}
 
-   if (clear) {
-      samples.clear();
+void Mcmc::runChain(Function & stat, const std::vector<double> & startValues,
+                    unsigned long nsamp, Proposal proposal,
+                    CLHEP::HepRandomEngine * engine,
+                    SampleSink & sink, bool verbose) const {
+// Dummy Arg object required by Function methods:
+   dArg dummy(1.);
+
+// The Parameter objects themselves (for the bounds information)
+   std::vector<Parameter> params;
+   stat.getFreeParams(params);
+
+   std::vector<double> paramValues(startValues);
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setValue(paramValues[i]);
    }
 
-   if (m_verbose) {
-      std::cerr << "Mcmc generating samples";
+// The statistic value at the current point is cached, so each trial
+// needs only one evaluation, at the proposed point.
+   stat.setFreeParamValues(paramValues);
+   double statValue = stat(dummy);
+
+// Lower-triangular factor of the covariance of the Gaussian proposal
+// used for block updates, initially diagonal with widths scaled as
+// in Gelman, Roberts & Gilks (1996).
+   size_t npars(paramValues.size());
+   double scale(2.38*2.38/npars);
+   std::vector<double> chol(npars*npars, 0);
+   for (size_t i = 0; i < npars; i++) {
+      chol[i*npars + i] = std::sqrt(scale)*m_transitionWidths[i];
    }
+
+// Running mean and sum of squared deviations of the chain, for the
+// adaptive proposal.  Adaptation starts after adaptStart samples and
+// the proposal is updated every adaptInterval samples thereafter.
+   std::vector<double> mean(npars, 0);
+   std::vector<double> sumSq(npars*npars, 0);
+   const unsigned long adaptStart(std::max<size_t>(100, 10*npars));
+   const unsigned long adaptInterval(std::max<size_t>(10, npars));
+   const double adaptEps(1e-10);
+
+// Work space for the trial point, the Gaussian deviates and the
+// sample written to the sink, allocated once for the whole chain.
+   std::vector<double> trial(paramValues);
+   std::vector<double> z(npars);
+   std::vector<double> sample(npars + 1);
+
+   unsigned long dotInterval(std::max(1UL, nsamp/20));
    unsigned long sample_size(0);
    while (sample_size < nsamp) {
+      if (proposal == VARIABLE_AT_A_TIME) {
 // Loop over parameters, treating each update step as a trial
-      for (unsigned int i = 0; i < paramValues.size(); i++) {
-         if (m_verbose && (sample_size % int(nsamp/20.) == 0)) {
-            std::cerr << ".";
-         }
-         std::vector<double> newParamValues = paramValues;
-         double transProbRatio;
-         newParamValues[i] = drawValue(params[i], m_transitionWidths[i],
-                                       transProbRatio);
+         for (unsigned int i = 0; i < paramValues.size(); i++) {
+            if (verbose && (sample_size % dotInterval == 0)) {
+               std::cerr << ".";
+            }
+            double transProbRatio;
+            trial[i] = drawTopHat(params[i], m_transitionWidths[i],
+                                  transProbRatio, engine);
 // Hastings ratio
-         m_stat->setFreeParamValues(newParamValues);
-         double statValueNew = m_stat->operator()(dummy);
-         m_stat->setFreeParamValues(paramValues);
-         double statValue = m_stat->operator()(dummy);
-         double alpha = transProbRatio*exp(statValueNew - statValue);
+            stat.setFreeParamValues(trial);
+            double statValueNew = stat(dummy);
+            double alpha = transProbRatio*exp(statValueNew - statValue);
 // Metropolis rejection criterion
-         double drand = RandFlat::shoot();
-         if (drand < alpha) {
+            double drand = uniform(engine);
+            if (drand < alpha) {
 // Accept the new point in Parameter space
-            paramValues[i] = newParamValues[i];
-            params[i].setValue(paramValues[i]);
-         } else {
+               paramValues[i] = trial[i];
+               params[i].setValue(paramValues[i]);
+               statValue = statValueNew;
+            } else {
 // Retain the old one
-            newParamValues[i] = paramValues[i];
+               trial[i] = paramValues[i];
+            }
+// We always append the current point after the update step,
+// followed by the objective function value
+            std::copy(paramValues.begin(), paramValues.end(), sample.begin());
+            sample[npars] = -statValue;
+            sink.write(sample);
+            sample_size++;
+         }
+         continue;
+      }
+
+// Block update of all of the Parameters with a symmetric Gaussian
+// proposal.  Trial points outside the bounds have zero probability
+// and are rejected without evaluating the statistic.
+      for (size_t i = 0; i < npars; i++) {
+         z[i] = gaussian(engine);
+      }
+      for (size_t i = 0; i < npars; i++) {
+         trial[i] = paramValues[i];
+         for (size_t k = 0; k <= i; k++) {
+            trial[i] += chol[i*npars + k]*z[k];
+         }
+      }
+      if (withinBounds(params, trial)) {
+         stat.setFreeParamValues(trial);
+         double statValueNew = stat(dummy);
+         if (uniform(engine) < exp(statValueNew - statValue)) {
+            paramValues.swap(trial);
+            statValue = statValueNew;
+         }
+      }
+      std::copy(paramValues.begin(), paramValues.end(), sample.begin());
+      sample[npars] = -statValue;
+      sink.write(sample);
+      sample_size++;
+
+      if (proposal == ADAPTIVE) {
+// Welford updates of the running mean and covariance
+         for (size_t i = 0; i < npars; i++) {
+            double delta = paramValues[i] - mean[i];
+            mean[i] += delta/sample_size;
+            for (size_t j = 0; j <= i; j++) {
+               sumSq[i*npars + j] += delta*(paramValues[j] - mean[j]);
+            }
+         }
+         if (sample_size >= adaptStart && sample_size % adaptInterval == 0) {
+            std::vector<double> cov(npars*npars);
+            for (size_t i = 0; i < npars; i++) {
+               for (size_t j = 0; j <= i; j++) {
+                  cov[i*npars + j] = scale*sumSq[i*npars + j]/(sample_size - 1);
+                  cov[j*npars + i] = cov[i*npars + j];
+               }
+               cov[i*npars + i] += scale*adaptEps;
+            }
+// Keep the previous proposal if the sample covariance is singular.
+            if (cholesky(cov, npars)) {
+               chol = cov;
+            }
          }
-// Append the objective function value
-         newParamValues.push_back(-m_stat->operator()(dummy));
-// We always append the current point after the update step
-         samples.push_back(newParamValues);
-         sample_size++;
       }
    }
-   if (m_verbose) {
-      std::cerr << "!" << std::endl;
-   }
+// Leave the statistic at the last point of the chain.
+   stat.setFreeParamValues(paramValues);
 }
 
-void Mcmc::writeSamples(std::string filename, 
-                        std::vector< std::vector<double> > &samples) const {
+void Mcmc::generateChains(std::vector< std::vector< std::vector<double> > >
+                          & chains, unsigned long nsamp, 
+                          unsigned int nchains, Proposal proposal,
+                          long seed) {
+   if (nchains == 0) {
+      throw Exception("Mcmc::generateChains: nchains must be positive.");
+   }
+   std::vector<double> paramValues;
+   m_stat->getFreeParamValues(paramValues);
+   std::vector<Parameter> params;
+   m_stat->getFreeParams(params);
 
-   fitsfile *fptr;
-   int status = 0;
+// Each chain has its own copy of the statistic and random number
+// engine, and all but the first start from dispersed points.
+   std::vector< std::unique_ptr<Function> > stats;
+   std::vector< std::unique_ptr<CLHEP::HepRandomEngine> > engines;
+   std::vector< std::vector<double> > startValues;
+   for (unsigned int k = 0; k < nchains; k++) {
+      stats.push_back(std::unique_ptr<Function>(m_stat->clone()));
+      engines.push_back(std::unique_ptr<CLHEP::HepRandomEngine>
+                        (new CLHEP::MTwistEngine(seed + k)));
+      std::vector<double> start(paramValues);
+      for (size_t i = 0; k > 0 && i < start.size(); i++) {
+         for (int ntries = 0; ntries < 100; ntries++) {
+            double trial = paramValues[i] 
+               + m_transitionWidths[i]*gaussian(engines[k].get());
+            if (trial >= params[i].getBounds().first &&
+                trial <= params[i].getBounds().second) {
+               start[i] = trial;
+               break;
+            }
+         }
+      }
+      startValues.push_back(start);
+   }
 
-   if (m_verbose) {
-      std::cout << filename << std::endl;
+   chains.assign(nchains, std::vector< std::vector<double> >());
+   std::vector<std::exception_ptr> errors(nchains);
+   std::vector<std::thread> threads;
+   for (unsigned int k = 0; k < nchains; k++) {
+      threads.push_back(std::thread([&, k]() {
+         try {
+            chains[k].reserve(nsamp + startValues[k].size());
+            VectorSampleSink sink(chains[k]);
+            runChain(*stats[k], startValues[k], nsamp, proposal,
+                     engines[k].get(), sink);
+         } catch (...) {
+            errors[k] = std::current_exception();
+         }
+      }));
    }
-// Create the file.
-   remove(filename.c_str());
-   fits_create_file(&fptr, filename.c_str(), &status);
-   if (status != 0) {
-      fits_report_error(stderr, status);
-      throw Exception("Mcmc::writeSamples: cfitsio errors.");
+   for (unsigned int k = 0; k < nchains; k++) {
+      threads[k].join();
    }
+   for (unsigned int k = 0; k < nchains; k++) {
+      if (errors[k]) {
+         std::rethrow_exception(errors[k]);
+      }
+   }
+}
 
-// Create the binary table, with the labels identifying the content of
-// each column
+std::vector<double> 
+Mcmc::gelmanRubin(const std::vector< std::vector< std::vector<double> > > 
+                  & chains, unsigned long burnIn) {
+   size_t nchains(chains.size());
+   if (nchains < 2) {
+      throw Exception("Mcmc::gelmanRubin: at least two chains are needed.");
+   }
+   size_t nsamp(chains[0].size());
+   for (size_t k = 1; k < nchains; k++) {
+      nsamp = std::min(nsamp, chains[k].size());
+   }
+   if (nsamp < burnIn + 2) {
+      throw Exception("Mcmc::gelmanRubin: too few samples after burn-in.");
+   }
+   size_t n(nsamp - burnIn);
+// The last column of each sample is the statistic value.
+   size_t npars(chains[0][0].size() - 1);
+
+   std::vector<double> rhat;
+   for (size_t i = 0; i < npars; i++) {
+      std::vector<double> means(nchains, 0);
+      double within(0);
+      for (size_t k = 0; k < nchains; k++) {
+         for (size_t j = burnIn; j < nsamp; j++) {
+            means[k] += chains[k][j][i];
+         }
+         means[k] /= n;
+         double var(0);
+         for (size_t j = burnIn; j < nsamp; j++) {
+            double delta = chains[k][j][i] - means[k];
+            var += delta*delta;
+         }
+         within += var/(n - 1);
+      }
+      within /= nchains;
+// R-hat is undefined for a parameter that is constant within every
+// chain, e.g., if none of its proposals were accepted.
+      if (within == 0) {
+         std::ostringstream message;
+         message << "Mcmc::gelmanRubin: free parameter " << i 
+                 << " does not vary within any of the chains.";
+         throw Exception(message.str());
+      }
 
-   int tfields = static_cast<int>(samples[0].size());
-   char *ttype[100];
-   char *tform[100];
-   char *tunit[100];
+      double grandMean(0);
+      for (size_t k = 0; k < nchains; k++) {
+         grandMean += means[k];
+      }
+      grandMean /= nchains;
+      double between(0);
+      for (size_t k = 0; k < nchains; k++) {
+         between += (means[k] - grandMean)*(means[k] - grandMean);
+      }
+      between *= double(n)/(nchains - 1);
+
+      double varPlus = (n - 1.)/n*within + between/n;
+      rhat.push_back(std::sqrt(varPlus/within));
+   }
+   return rhat;
+}
 
+void Mcmc::writeSamples(std::string filename, 
+                        std::vector< std::vector<double> > &samples,
+                        bool doublePrecision) const {
+   if (samples.empty()) {
+      throw Exception("Mcmc::writeSamples: no samples to write.");
+   }
    if (m_verbose) {
-      std::cout << "Creating binary table" << std::endl;
-   }
-   for (int i = 0; i < tfields; i++) {
-      std::ostringstream type;
-      type << "param" << i;
-      ttype[i] = strdup(std::string(type.str()).c_str());
-      tform[i] = strdup("1E");
-      tunit[i] = strdup("None");
-      if (m_verbose) {
-         std::cout << ttype[i] << "  "
-                   << tform[i] << "  "
-                   << tunit[i] << std::endl;
-      }
-   }
-   char *extname = strdup("Mcmc data");
-   int nrows = samples.size();
-   fits_create_tbl(fptr, BINARY_TBL, nrows, tfields, ttype, tform,
-		   tunit, extname, &status);
-   if (status != 0) {
-      fits_report_error(stderr, status);
-      throw Exception("Mcmc::writeSamples: cfitsio errors.");
-   }
-
-   int firstrow  = 1;  /* first row in table to write   */
-   int firstelem = 1;  /* first element in row  (ignored in ASCII tables) */
-
-// write each column
-   for (int i = 0; i < tfields; i++) {
-// repack the data into a vector of floats
-      std::vector<float> my_data;
-      for (int j = 0; j < nrows; j++) {
-         my_data.push_back(samples[j][i]);
-      }
-// Since the data in vectors are stored sequentially, one can pass the
-// pointer to the first object as a C array.
-      fits_write_col(fptr, TFLOAT, i+1, firstrow, firstelem, nrows, 
-                     &my_data[0], &status);
-      if (status != 0) {
-         fits_report_error(stderr, status);
-         throw Exception("Mcmc::writeSamples: cfitsio errors.");
-      }
-   }
-   fits_close_file(fptr, &status);
-   if (status != 0) {
-      fits_report_error(stderr, status);
-      throw Exception("Mcmc::writeSamples: cfitsio errors.");
+      std::cout << filename << std::endl;
    }
+// Label the columns by Parameter name if the samples are from this
+// statistic, and generically otherwise.
+   std::vector<std::string> names;
+   getColumnNames(names);
+   if (names.size() != samples[0].size()) {
+      genericColumnNames(samples[0].size(), names);
+   }
+   FitsSampleSink sink(filename, names, doublePrecision);
+   for (size_t j = 0; j < samples.size(); j++) {
+      sink.write(samples[j]);
+   }
+   sink.close();
+}
+
+void Mcmc::writeSamples(std::string filename, const SampleBuffer & samples,
+                        bool doublePrecision) const {
+   if (samples.empty()) {
+      throw Exception("Mcmc::writeSamples: no samples to write.");
+   }
+   std::vector<std::string> names;
+   getColumnNames(names);
+   if (names.size() != samples.ncols()) {
+      genericColumnNames(samples.ncols(), names);
+   }
+   FitsSampleSink sink(filename, names, doublePrecision);
+   std::vector<double> row;
+   for (size_t i = 0; i < samples.size(); i++) {
+      samples.getSample(i, row);
+      sink.write(row);
+   }
+   sink.close();
 }
 
 void Mcmc::estimateTransWidths() {
@@ -195,22 +511,7 @@ void Mcmc::estimateTransWidths() {
 }
 
 double Mcmc::drawValue(Parameter &param, double dx, double &transProbRatio) {
-// Normalize the top-hat function (i.e., find the width) at the input
-// Parameter location given the Parameter bounds.
-
-   double xl = param.getBounds().first;
-   double xu = param.getBounds().second;
-   double x0 = param.getValue();
-   double width = std::min(xu, x0 + dx) - std::max(xl, x0 - dx);
-
-// Draw the trial value...
-   double drand = RandFlat::shoot();
-   double y = drand*width + std::max(xl, x0 - dx);
-
-// and compute the ratio of the transition probability densities
-   transProbRatio = width/(std::min(xu, y + dx) - std::max(xl, y - dx));
-
-   return y;
+   return drawTopHat(param, dx, transProbRatio, 0);
 }
 
 } // namespace optimizers
@@ -6,21 +6,147 @@
  * $Header$
  */
 
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>
 #include <sstream>
 #include "optimizers/dArg.h"
 #include "optimizers/Minuit.h"
+#include "optimizers/NewMinuit.h"
 #include "optimizers/Parameter.h"
 #include "optimizers/Exception.h"
 #include "optimizers/OutOfBounds.h"
 
+// The COMMON blocks of the f2c'd Minuit in minuit_routines.c.  These
+// hold all of Minuit's state between calls and must match the layouts
+// generated there.
+extern "C" {
+  typedef double doublereal;
+  extern struct {char cpnam[1000];} mn7nam_;
+  extern struct {doublereal u[100], alim[100], blim[100];} mn7ext_;
+  extern struct {doublereal erp[100], ern[100], werr[100], globcc[100];} mn7err_;
+  extern struct {integer nvarl[100], niofex[100], nexofi[100];} mn7inx_;
+  extern struct {doublereal x[100], xt[100], dirin[100];} mn7int_;
+  extern struct {doublereal xs[100], xts[100], dirins[100];} mn7fx2_;
+  extern struct {doublereal grd[100], g2[100], gstep[100], gin[100], 
+                            dgrd[100];} mn7der_;
+  extern struct {doublereal grds[100], g2s[100], gsteps[100];} mn7fx3_;
+  extern struct {integer ipfix[100], npfix;} mn7fx1_;
+  extern struct {doublereal vhmat[5050];} mn7var_;
+  extern struct {doublereal vthmat[5050];} mn7vat_;
+  extern struct {doublereal p[10100], pstar[100], pstst[100], pbar[100], 
+                            prho[100];} mn7sim_;
+  extern struct {integer maxint, npar, maxext, nu;} mn7npr_;
+  extern struct {integer isysrd, isyswr, isyssa, npagwd, npagln, 
+                         newpag;} mn7iou_;
+  extern struct {integer istkrd[10], nstkrd, istkwr[10], nstkwr;} mn7io2_;
+  extern struct {char cfrom[8], cstatu[10], ctitl[50], cword[20], 
+                      cundef[10], cvrsn[6], covmes[88];} mn7tit_;
+  extern struct {integer isw[7], idbg[11], nblock, icomnd;} mn7flg_;
+  extern struct {doublereal amin, up, edm, fval3, epsi, apsi, 
+                            dcovar;} mn7min_;
+  extern struct {integer nfcn, nfcnmx, nfcnlc, nfcnfr, itaur, istrat, 
+                         nwrmes[2];} mn7cnv_;
+  extern struct {doublereal word7[30];} mn7arg_;
+  extern struct {logical lwarn, lrepor, limset, lnolim, lnewmn, 
+                         lphead;} mn7log_;
+  extern struct {doublereal epsmac, epsma2, vlimlo, vlimhi, undefi, bigedm, 
+                            updflt;} mn7cns_;
+  extern struct {doublereal xpt[101], ypt[101];} mn7rpt_;
+  extern struct {char chpt[101];} mn7cpt_;
+  extern struct {doublereal xmidcr, ymidcr, xdircr, ydircr;
+                 integer ke1cr, ke2cr;} mn7xcr_;
+  extern struct {char origin[200], warmes[1200];} mn7wrc_;
+  extern struct {integer nfcwar[20], icirc[2];} mn7wri_;
+}
+
 namespace {
    int numPars(0);
+
+   /// Serializes all calls into the Fortran Minuit, which is not
+   /// reentrant.  fcn runs inside those calls with the COMMON
+   /// blocks in use, so the lock cannot be released around it.
+   std::recursive_mutex & minuitMutex() {
+      static std::recursive_mutex mutex;
+      return mutex;
+   }
+
+   struct CommonBlock {
+      void * address;
+      size_t size;
+   };
+
+#define MINUIT_COMMON(name) {static_cast<void *>(&name), sizeof(name)}
+   const CommonBlock commonBlocks[] = {
+      MINUIT_COMMON(mn7nam_), MINUIT_COMMON(mn7ext_), MINUIT_COMMON(mn7err_),
+      MINUIT_COMMON(mn7inx_), MINUIT_COMMON(mn7int_), MINUIT_COMMON(mn7fx2_),
+      MINUIT_COMMON(mn7der_), MINUIT_COMMON(mn7fx3_), MINUIT_COMMON(mn7fx1_),
+      MINUIT_COMMON(mn7var_), MINUIT_COMMON(mn7vat_), MINUIT_COMMON(mn7sim_),
+      MINUIT_COMMON(mn7npr_), MINUIT_COMMON(mn7iou_), MINUIT_COMMON(mn7io2_),
+      MINUIT_COMMON(mn7tit_), MINUIT_COMMON(mn7flg_), MINUIT_COMMON(mn7min_),
+      MINUIT_COMMON(mn7cnv_), MINUIT_COMMON(mn7arg_), MINUIT_COMMON(mn7log_),
+      MINUIT_COMMON(mn7cns_), MINUIT_COMMON(mn7rpt_), MINUIT_COMMON(mn7cpt_),
+      MINUIT_COMMON(mn7xcr_), MINUIT_COMMON(mn7wrc_), MINUIT_COMMON(mn7wri_)
+   };
+#undef MINUIT_COMMON
+   const size_t numCommonBlocks(sizeof(commonBlocks)/sizeof(CommonBlock));
 }
 
 namespace optimizers {
 
-
-  Minuit::Minuit(Statistic& stat) : Optimizer(stat) {
+  /**
+   * @class Minuit::StateGuard
+   * @brief Holds the Minuit lock and swaps this instance's copy of
+   * the COMMON blocks (and the free parameter count used by fcn) in
+   * on construction and out on destruction.  Nested guards on the
+   * same instance are no-ops.
+   */
+  class Minuit::StateGuard {
+  public:
+    StateGuard(const Minuit & minuit) 
+      : m_lock(minuitMutex()), m_minuit(minuit), m_owner(!minuit.m_active) {
+      if (!m_owner) {
+        return;
+      }
+      m_minuit.m_active = true;
+      if (!m_minuit.m_commonState.empty()) {
+        const char * state = &m_minuit.m_commonState[0];
+        for (size_t i = 0; i < numCommonBlocks; i++) {
+          std::memcpy(commonBlocks[i].address, state, commonBlocks[i].size);
+          state += commonBlocks[i].size;
+        }
+      }
+      numPars = m_minuit.m_numPars;
+    }
+    ~StateGuard() {
+      if (!m_owner) {
+        return;
+      }
+      size_t stateSize = 0;
+      for (size_t i = 0; i < numCommonBlocks; i++) {
+        stateSize += commonBlocks[i].size;
+      }
+      m_minuit.m_commonState.resize(stateSize);
+      char * state = &m_minuit.m_commonState[0];
+      for (size_t i = 0; i < numCommonBlocks; i++) {
+        std::memcpy(state, commonBlocks[i].address, commonBlocks[i].size);
+        state += commonBlocks[i].size;
+      }
+      m_minuit.m_numPars = numPars;
+      m_minuit.m_active = false;
+    }
+  private:
+    std::lock_guard<std::recursive_mutex> m_lock;
+    const Minuit & m_minuit;
+    bool m_owner;
+  };
+
+  Minuit::Minuit(Statistic& stat) 
+    : Optimizer(stat), m_numPars(0), m_active(false), m_strategy_value(1),
+      m_useMinuit2(false), m_printLevel(-1), m_errorDef(0.5) {
+    StateGuard guard(*this);
     const integer i5=5, i6=6, i7=7;
     mninit_(&i5, &i6, &i7);
   }
@@ -35,6 +161,12 @@ namespace optimizers {
 
   void Minuit::setStrategy(unsigned int strat) {
      m_strategy_value = strat;
+     if (m_useMinuit2) {
+        if (m_minuit2) {
+           m_minuit2->setStrategy(strat);
+        }
+        return;
+     }
       std::ostringstream s_strategy;
       s_strategy << "SET STRATEGY " << strat;
       doCmd(s_strategy.str());
@@ -56,6 +188,12 @@ namespace optimizers {
   }
 
   int Minuit::minimize(int verbose, double tol, int tolType, bool doHesse) {
+    if (m_useMinuit2) {
+      return minimize2(verbose, tol, tolType, doHesse);
+    }
+    clearEvaluationCache();
+    Instrumentation::Timer timer(instruments(), Instrumentation::FIND_MIN);
+    StateGuard guard(*this);
 
     typedef std::vector<Parameter>::iterator pptr;
 
@@ -64,6 +202,16 @@ namespace optimizers {
     numPars = params.size();
     integer errorFlag;
 
+    // Minuit does not expose its intermediate steps, so only the
+    // starting and final points are reported to an observer.
+    beginIterations();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    if (observer() != 0) {
+      std::vector<double> startValues;
+      m_stat->getFreeParamValues(startValues);
+      notifyIteration(startValues, m_stat->value(), nan, nan);
+    }
+
     int minuitVerbose = verbose - 1;
     if (minuitVerbose >= 0) {
       const integer i5=5, i6=6, i7=7;
@@ -135,6 +283,7 @@ namespace optimizers {
 
     // Improve the quality of the Hessian matrix.
     if (doHesse) {
+       Instrumentation::Timer timer(instruments(), Instrumentation::HESSIAN);
        doCmd("HESSE");
        m_stat->setFreeParamValues(paramValues);
     }
@@ -147,6 +296,7 @@ namespace optimizers {
     m_val = fmin;
     m_quality = minStat;
     m_distance = vertDist;
+    notifyIteration(paramValues, -fmin, nan, vertDist);
     if (verbose != 0) {
       std::cout << "Minuit fit quality: " << minStat << 
 	"   estimated distance: " << vertDist << std::endl;
@@ -181,7 +331,64 @@ namespace optimizers {
     return getRetCode();
   } // End of minimize 
 
+  int Minuit::minimize2(int verbose, double tol, int tolType, bool doHesse) {
+    // A new NewMinuit for each fit picks up the current Statistic,
+    // which changes if the evaluation cache or instrumentation is
+    // switched on or off.
+    m_minuit2.reset(new NewMinuit(*m_stat));
+    m_minuit2->setStrategy(m_strategy_value);
+    m_minuit2->setMaxEval(m_maxEval);
+    m_minuit2->setObserver(observer());
+    clearEvaluationCache();
+    Instrumentation::Timer timer(instruments(), Instrumentation::FIND_MIN);
+    if (doHesse) {
+      m_minuit2->find_min(verbose, tol, tolType);
+    } else {
+      m_minuit2->find_min_only(verbose, tol, tolType);
+    }
+    getMinuit2Results();
+    if (verbose != 0) {
+      std::cout << "Minuit fit quality: " << m_quality << 
+	"   estimated distance: " << m_distance << std::endl;
+    }
+    if (m_minuit2->getRetCode() == 1) {
+      setRetCode(1);  // Call limit reached.
+    } else if (m_quality == 3) {
+      setRetCode(0);
+    } else {
+      setRetCode(100 + m_quality);  // Bad covariance.
+    }
+    return getRetCode();
+  }
+
+  void Minuit::getMinuit2Results() {
+    // The covariance status has the same meaning as the Fortran
+    // MNSTAT's ISTAT.
+    m_quality = m_minuit2->userCovarianceStatus();
+    m_distance = m_minuit2->getDistance();
+    m_val = m_minuit2->userFval();
+    m_uncertainty.clear();
+    if (m_minuit2->userHasCovariance()) {
+      std::vector< std::vector<double> > cov(m_minuit2->userCovariance());
+      for (size_t i = 0; i < cov.size(); i++) {
+        m_uncertainty.push_back(std::sqrt(cov[i][i]));
+      }
+    }
+  }
+
+  NewMinuit & Minuit::minuit2(const std::string & routine) const {
+    if (!m_minuit2) {
+      throw Exception("Minuit: find_min must be executed before " + routine);
+    }
+    return *m_minuit2;
+  }
+
   std::pair<double,double> Minuit::Minos(unsigned int n, double level, bool numericDeriv) {
+    if (m_useMinuit2) {
+      return minuit2("Minos").Minos(n, level, numericDeriv);
+    }
+    Instrumentation::Timer timer(instruments(), Instrumentation::MINOS);
+    StateGuard guard(*this);
     std::vector<double> parValues;
     m_stat->getFreeParamValues(parValues);
     integer npar(m_stat->getNumFreeParams());
@@ -252,8 +459,22 @@ namespace optimizers {
     return std::pair<double,double>(eminus,eplus);
   }
 
+  std::vector< std::pair<double, double> > 
+  Minuit::MinosAll(const std::vector<unsigned int> & pars, double level, 
+                   bool parallel) {
+    if (m_useMinuit2) {
+      return minuit2("MinosAll").MinosAll(pars, level, parallel);
+    }
+    return Optimizer::MinosAll(pars, level, parallel);
+  }
+
   void Minuit::MnContour(unsigned int par1, unsigned int par2,
 			    double level, unsigned int npts) {
+    if (m_useMinuit2) {
+      minuit2("MnContour").MnContour(par1, par2, level, npts);
+      return;
+    }
+    StateGuard guard(*this);
     std::vector<double> parValues;
     m_stat->getFreeParamValues(parValues);
     integer npar(m_stat->getNumFreeParams());
@@ -283,8 +504,62 @@ namespace optimizers {
     return;
   }
 
+  std::vector<Contour> Minuit::
+  contours(const std::vector< std::pair<unsigned int, unsigned int> > & pairs,
+           const std::vector<double> & levels, unsigned int npts,
+           bool parallel) {
+    if (m_useMinuit2) {
+      return minuit2("contours").contours(pairs, levels, npts, parallel);
+    }
+    StateGuard guard(*this);
+    std::vector<double> parValues;
+    m_stat->getFreeParamValues(parValues);
+    integer npar(m_stat->getNumFreeParams());
+    for (size_t i = 0; i < pairs.size(); i++) {
+      if (pairs[i].first >= static_cast<unsigned int>(npar)) {
+	throw Exception("Parameter number out of range in contours", 
+			pairs[i].first);
+      }
+      if (pairs[i].second >= static_cast<unsigned int>(npar)) {
+	throw Exception("Parameter number out of range in contours", 
+			pairs[i].second);
+      }
+    }
+    numPars = npar;
+    void * statistic = static_cast<void *>(m_stat);
+    std::vector<double> xpt(npts), ypt(npts);
+    std::vector<Contour> results;
+    for (size_t i = 0; i < pairs.size(); i++) {
+      for (size_t j = 0; j < levels.size(); j++) {
+	std::ostringstream levelcmd;
+	levelcmd << "SET ERR " << levels[j]/2.;
+	doCmd(levelcmd.str());
+	integer par1(pairs[i].first + 1);
+	integer par2(pairs[i].second + 1);
+	integer npt(npts);
+	integer nfound(0);
+	mncont_(&fcn, &par1, &par2, &npt, &xpt[0], &ypt[0], &nfound, 
+		statistic);
+	results.push_back(Contour(pairs[i].first, pairs[i].second, 
+				  levels[j]));
+	for (integer k = 0; k < nfound; k++) {
+	  results.back().points.push_back(std::make_pair(xpt[k], ypt[k]));
+	}
+      }
+    }
+    numPars = 0;
+    //Set internal error level back to 0.5=1sigma for -logLike optimizer
+    doCmd("SET ERR 0.5");
+    m_stat->setFreeParamValues(parValues);
+    return results;
+  }
+
   int Minuit::doCmd(std::string command, bool set_npar) {
     // Pass a command string to Minuit
+    if (m_useMinuit2) {
+      return minuit2Cmd(command);
+    }
+    StateGuard guard(*this);
     integer errorFlag = 0;
     
     // This is need to make sure that this class and MINUIT
@@ -299,6 +574,69 @@ namespace optimizers {
     return errorFlag;
   }
 
+  int Minuit::minuit2Cmd(const std::string & command) {
+    // Like the Fortran, take the command names and SET keywords to
+    // be case-insensitive, and tell them apart by their first
+    // three letters, or four for MINImize and MINOs.
+    std::string upper(command);
+    for (size_t i = 0; i < upper.size(); i++) {
+      upper[i] = std::toupper(static_cast<unsigned char>(upper[i]));
+    }
+    std::istringstream words(upper);
+    std::string name;
+    words >> name;
+    if (name.compare(0, 3, "SET") == 0) {
+      std::string keyword;
+      words >> keyword;
+      keyword = keyword.substr(0, 3);
+      if (keyword == "PRI") {
+        words >> m_printLevel;
+      } else if (keyword == "ERR") {
+        words >> m_errorDef;
+      } else if (keyword == "STR") {
+        unsigned int strategy(1);
+        words >> strategy;
+        setStrategy(strategy);
+      } else if (keyword != "NOW" && keyword != "GRA" && keyword != "NOG") {
+        return 3;
+      }
+      return 0;
+    }
+    try {
+      if (name.compare(0, 3, "MIG") == 0 || name.compare(0, 4, "MINI") == 0) {
+        // The tolerance is as for MINIMIZE in minimize.
+        double maxCalls(m_maxEval), tolerance(0.1);
+        words >> maxCalls >> tolerance;
+        int maxEval(m_maxEval);
+        m_maxEval = static_cast<int>(maxCalls);
+        minimize2(m_printLevel + 1, tolerance/2000., ABSOLUTE, false);
+        m_maxEval = maxEval;
+        return getRetCode() == 1 ? 4 : 0;
+      } else if (name.compare(0, 3, "HES") == 0) {
+        // getUncertainty runs hesse unless migrad left a valid
+        // covariance.
+        minuit2("HESSE").getUncertainty();
+        getMinuit2Results();
+        return 0;
+      } else if (name.compare(0, 4, "MINO") == 0) {
+        // The parameter numbers start from one, as in the Fortran.
+        double maxCalls;
+        std::vector<unsigned int> pars;
+        unsigned int par;
+        if (words >> maxCalls) {
+          while (words >> par) {
+            pars.push_back(par - 1);
+          }
+        }
+        minuit2("MINOS").MinosAll(pars, 2.*m_errorDef, false);
+        return 0;
+      }
+    } catch (Exception &) {
+      return 4;  // Abnormal termination, as for the Fortran.
+    }
+    return 3;
+  }
+
   void fcn(integer* npar, double* grad, double* fcnval,
 	   double* xval, integer* iflag, void* futil) {
     // This is the function that Minuit minimizes
@@ -307,26 +645,35 @@ namespace optimizers {
         numPars = *npar;
      }
     
-    std::vector<double> parameters(xval, xval + numPars);
+    // fcn only runs while the Minuit lock is held, so the scratch
+    // vectors can be shared and reused without allocating.
+    static std::vector<double> parameters;
+    static std::vector<double> gradient;
+    parameters.assign(xval, xval + numPars);
 
     // What a hack!  Minuit thinks futil is a function 
     // pointer.  It's been hijacked to be a pointer to
     // m_stat, so this non-member function can use it.
 
     Statistic * statp = static_cast<Statistic *>(futil);
-    statp->setFreeParamValues(parameters);
 
-    *fcnval = -statp->value();
     if (*iflag == 2) { // Return gradient values
-      std::vector<double> gradient;
-      statp->getFreeDerivs(gradient);
+      statp->valueAndFreeDerivs(parameters, *fcnval, gradient);
+      *fcnval = -*fcnval;
       for (int i=0; i < *npar; i++) {
 	grad[i] = -gradient[i];
       }
+    } else {
+      statp->setFreeParamValues(parameters);
+      *fcnval = -statp->value();
     }
   }    
 
    std::vector< std::vector<double> > Minuit::covarianceMatrix() const {
+      if (m_useMinuit2) {
+         return minuit2("covarianceMatrix").covarianceMatrix();
+      }
+      StateGuard guard(*this);
       std::vector<double> parValues;
       m_stat->getFreeParamValues(parValues);
       integer npar(m_stat->getNumFreeParams());
@@ -0,0 +1,301 @@
+/**
+ * @file MultiStart.cxx
+ * @brief Implementation of the multi-start global Optimizer.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#include <cmath>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+#include "CLHEP/Random/MTwistEngine.h"
+#include "CLHEP/Random/RandFlat.h"
+
+#include "optimizers/Exception.h"
+#include "optimizers/MultiStart.h"
+#include "optimizers/OptimizerFactory.h"
+
+#include "Parallel.h"
+
+namespace {
+   using optimizers::IterationRecord;
+
+/// Thrown by StartMonitor to abandon a local fit.
+   class StartCancelled {};
+
+/// The best value over all of the local fits so far.
+   class BestValue {
+   public:
+      BestValue() : m_value(-std::numeric_limits<double>::infinity()) {}
+      double value() {
+         std::lock_guard<std::mutex> lock(m_mutex);
+         return m_value;
+      }
+      void update(double value) {
+         std::lock_guard<std::mutex> lock(m_mutex);
+         m_value = std::max(m_value, value);
+      }
+   private:
+      std::mutex m_mutex;
+      double m_value;
+   };
+
+/// Cancels a local fit that is unlikely to reach the best value.
+   class StartMonitor : public optimizers::IterationObserver {
+   public:
+      StartMonitor(BestValue & best, double margin, unsigned int minIterations)
+         : m_best(best), m_margin(margin), m_minIterations(minIterations),
+           m_lastValue(0) {}
+      virtual void update(const IterationRecord & record) {
+         double gain(record.edm);
+         if (std::isnan(gain)) {
+            gain = 10.*std::max(record.value - m_lastValue, 0.);
+         }
+         m_lastValue = record.value;
+         if (record.iteration >= m_minIterations
+             && record.value + gain < m_best.value() - m_margin) {
+            throw StartCancelled();
+         }
+      }
+   private:
+      BestValue & m_best;
+      double m_margin;
+      unsigned int m_minIterations;
+      double m_lastValue;
+   };
+
+/// The backends built on f2c translations keep their locals in
+/// static storage, so only one of them may run at a time.
+   bool isThreadSafe(const std::string & name) {
+      return (name == "NewMinuit" || name == "NEWMINUIT"
+              || name == "Lbfgs" || name == "LBFGS"
+              || name == "LbfgsB" || name == "LBFGSB"
+              || name == "Powell" || name == "POWELL"
+              || name == "Simplex" || name == "SIMPLEX"
+              || name == "Amoeba" || name == "AMOEBA");
+   }
+
+/// The Minuits only report their iterations after the fit, and
+/// Simplex reports only its starting and final points.
+   bool reportsIterations(const std::string & name) {
+      return !(name == "Minuit" || name == "MINUIT"
+               || name == "NewMinuit" || name == "NEWMINUIT"
+               || name == "Simplex" || name == "SIMPLEX"
+               || name == "Amoeba" || name == "AMOEBA");
+   }
+
+   std::mutex & serialFitMutex() {
+      static std::mutex mutex;
+      return mutex;
+   }
+
+   bool betterValue(const optimizers::MultiStart::Minimum & a,
+                    const optimizers::MultiStart::Minimum & b) {
+      return a.value > b.value;
+   }
+}
+
+namespace optimizers {
+
+MultiStart::MultiStart(Statistic & stat, const std::string & localOptimizer)
+   : Optimizer(stat), m_localOptimizer(localOptimizer), m_nstarts(0),
+     m_nthreads(0), m_seed(19780503), m_clusterTol(1e-3),
+     m_cancelMargin(10.), m_cancelIterations(5), m_ncancelled(0),
+     m_nfailed(0) {}
+
+int MultiStart::find_min(int verbose, double tol, int tolType) {
+   clearEvaluationCache();
+   Instrumentation::Timer timer(instruments(), Instrumentation::FIND_MIN);
+
+   std::vector<double> lower, upper;
+   samplingRanges(lower, upper);
+   std::vector< std::vector<double> > starts;
+   drawStarts(lower, upper, starts);
+
+// Make sure that the factory exists before the threads use it.
+   OptimizerFactory & factory(OptimizerFactory::instance());
+   bool serial(!isThreadSafe(m_localOptimizer));
+   bool monitor(m_cancelMargin > 0 && reportsIterations(m_localOptimizer));
+   if (m_cancelMargin > 0 && !monitor && verbose > 0) {
+      std::cout << "MultiStart: " << m_localOptimizer 
+                << " does not report its iterations as it goes, "
+                << "so no starts will be cancelled." << std::endl;
+   }
+
+   unsigned int nthreads(serial ? 1 : numThreads(starts.size(), m_nthreads));
+   std::vector< std::unique_ptr<Statistic> > stats;
+   cloneStatistics(*m_stat, nthreads, stats);
+
+   std::vector<Minimum> fits(starts.size());
+   std::vector<char> status(starts.size(), 0);
+   enum {CONVERGED=1, CANCELLED, FAILED};
+   BestValue best;
+   TaskQueue tasks(starts.size());
+
+   runThreads(nthreads, [&](unsigned int ithread) {
+      Statistic & stat(*stats[ithread]);
+      size_t istart;
+      while (tasks.next(istart)) {
+         std::unique_lock<std::mutex> lock(serialFitMutex(), std::defer_lock);
+         if (serial) {
+            lock.lock();
+         }
+         try {
+            stat.setFreeParamValues(starts[istart]);
+            std::unique_ptr<Optimizer>
+               local(factory.create(m_localOptimizer, stat));
+            local->setMaxEval(m_maxEval);
+            local->setNumericDerivFlag(getNumericDerivFlag());
+            StartMonitor startMonitor(best, m_cancelMargin,
+                                      m_cancelIterations);
+            if (monitor) {
+               local->setObserver(&startMonitor);
+            }
+            local->find_min_only(0, tol, tolType);
+            Minimum & fit(fits[istart]);
+            stat.getFreeParamValues(fit.params);
+            fit.value = stat.value();
+            fit.nstarts = 1;
+            fit.retCode = local->getRetCode();
+            best.update(fit.value);
+            status[istart] = CONVERGED;
+         } catch (StartCancelled &) {
+            status[istart] = CANCELLED;
+         } catch (std::exception & eObj) {
+            if (verbose > 0) {
+               std::cout << "MultiStart: start " << istart << " failed: "
+                         << eObj.what() << std::endl;
+            }
+            status[istart] = FAILED;
+         }
+      }
+   }, &tasks);
+
+   std::vector<Minimum> converged;
+   m_ncancelled = 0;
+   m_nfailed = 0;
+   for (size_t istart = 0; istart < starts.size(); istart++) {
+      if (status[istart] == CONVERGED) {
+         converged.push_back(fits[istart]);
+      } else if (status[istart] == CANCELLED) {
+         m_ncancelled++;
+      } else {
+         m_nfailed++;
+      }
+   }
+   if (converged.empty()) {
+      throw Exception("MultiStart: none of the local fits converged.");
+   }
+   cluster(converged, lower, upper);
+
+   m_stat->setFreeParamValues(m_minima.front().params);
+   setRetCode(m_minima.front().retCode);
+   if (verbose > 0) {
+      put(std::cout);
+   }
+   return getRetCode();
+}
+
+void MultiStart::samplingRanges(std::vector<double> & lower,
+                                std::vector<double> & upper) const {
+   std::vector<Parameter> params;
+   m_stat->getFreeParams(params);
+   lower.resize(params.size());
+   upper.resize(params.size());
+   for (size_t i = 0; i < params.size(); i++) {
+      double value(params[i].getValue());
+      double width(std::max(std::fabs(value), 1.));
+      lower[i] = params[i].effectiveBounds().first;
+      upper[i] = params[i].effectiveBounds().second;
+      if (std::isinf(lower[i])) {
+         lower[i] = std::min(value - width, upper[i]);
+      }
+      if (std::isinf(upper[i])) {
+         upper[i] = std::max(value + width, lower[i]);
+      }
+   }
+}
+
+void MultiStart::drawStarts(const std::vector<double> & lower,
+                            const std::vector<double> & upper,
+                            std::vector< std::vector<double> > & starts) const {
+   size_t npars(lower.size());
+   size_t nstarts(m_nstarts > 0 ? m_nstarts : 10*npars);
+   if (nstarts == 0) {
+      nstarts = 1;
+   }
+   starts.assign(nstarts, std::vector<double>(npars));
+   m_stat->getFreeParamValues(starts[0]);
+
+// Each parameter range is cut into nstarts - 1 strata, and each
+// stratum is used by exactly one sample point.
+   size_t nsample(nstarts - 1);
+   CLHEP::MTwistEngine engine(m_seed);
+   std::vector<size_t> strata(nsample);
+   for (size_t j = 0; j < npars; j++) {
+      for (size_t k = 0; k < nsample; k++) {
+         strata[k] = k;
+      }
+      for (size_t k = nsample; k > 1; k--) {
+         size_t kk(static_cast<size_t>(CLHEP::RandFlat::shoot(&engine)*k));
+         std::swap(strata[k - 1], strata[std::min(kk, k - 1)]);
+      }
+      for (size_t k = 0; k < nsample; k++) {
+         double u((strata[k] + CLHEP::RandFlat::shoot(&engine))/nsample);
+         starts[k + 1][j] = lower[j] + u*(upper[j] - lower[j]);
+      }
+   }
+}
+
+void MultiStart::cluster(const std::vector<Minimum> & fits,
+                         const std::vector<double> & lower,
+                         const std::vector<double> & upper) {
+   std::vector<Minimum> sorted(fits);
+   std::stable_sort(sorted.begin(), sorted.end(), betterValue);
+   m_minima.clear();
+   for (size_t i = 0; i < sorted.size(); i++) {
+      bool found(false);
+      for (size_t k = 0; k < m_minima.size() && !found; k++) {
+         double dist2(0);
+         for (size_t j = 0; j < lower.size(); j++) {
+            double range(upper[j] - lower[j]);
+            double dx(sorted[i].params[j] - m_minima[k].params[j]);
+            if (range > 0) {
+               dx /= range;
+            }
+            dist2 += dx*dx;
+         }
+         if (std::sqrt(dist2) < m_clusterTol) {
+            m_minima[k].nstarts++;
+            found = true;
+         }
+      }
+      if (!found) {
+         m_minima.push_back(sorted[i]);
+      }
+   }
+}
+
+std::ostream & MultiStart::put(std::ostream & s) const {
+   s << "MultiStart with " << m_localOptimizer << ": "
+     << m_minima.size() << " distinct maxima, "
+     << m_ncancelled << " starts cancelled, "
+     << m_nfailed << " failed" << std::endl;
+   for (size_t k = 0; k < m_minima.size(); k++) {
+      s << "  " << m_minima[k].value << "  (" << m_minima[k].nstarts
+        << " starts):";
+      for (size_t j = 0; j < m_minima[k].params.size(); j++) {
+         s << "  " << m_minima[k].params[j];
+      }
+      s << std::endl;
+   }
+   return s;
+}
+
+} // namespace optimizers
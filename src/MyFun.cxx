@@ -29,8 +29,7 @@ double MyFun::value(const Arg & xarg) const {
    double x = dynamic_cast<const dArg &>(xarg).getValue();
 
    double my_val(0);
-   std::vector<Parameter> params;
-   getParams(params);
+   const std::vector<Parameter> & params(m_parameter);
 
    for (size_t i(0); i < params.size(); i++) {
       my_val += params[i].getTrueValue()*pow(x, int(i));
@@ -41,17 +40,13 @@ double MyFun::value(const Arg & xarg) const {
 
 double MyFun::derivByParamImp(const Arg & xarg,
                               const std::string & paramName) const {
-   double x = dynamic_cast<const dArg &>(xarg).getValue();
-
-   std::vector<Parameter> params;
-   getParams(params);
+   return derivByParamIndexImp(xarg, parameterIndex(paramName));
+}
 
-   for (unsigned int i = 0; i < params.size(); i++) {
-      if (paramName == params[i].getName()) {
-         return params[i].getScale()*pow(x, int(i));
-      }
-   }
-   throw ParameterNotFound(paramName, getName(), "MyFun::deriveByParam");
+double MyFun::derivByParamIndexImp(const Arg & xarg,
+                                   unsigned int i) const {
+   double x = dynamic_cast<const dArg &>(xarg).getValue();
+   return m_parameter.at(i).getScale()*pow(x, int(i));
 }
 
 } // namespace optimizers
@@ -38,6 +38,9 @@ protected:
    virtual double derivByParamImp(const Arg & x,
                                   const std::string & paramName) const;
 
+   virtual double derivByParamIndexImp(const Arg & x,
+                                       unsigned int paramIndex) const;
+
 };
 
 } // namespace optimizers
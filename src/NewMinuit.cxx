@@ -5,6 +5,9 @@
  * $Header$
  */
 
+#include <cmath>
+#include <fstream>
+#include <limits>
 #include <sstream>
 #include "optimizers/NewMinuit.h"
 #include "optimizers/Parameter.h"
@@ -13,14 +16,20 @@
 #include "Minuit2/MnMinimize.h"
 #include "Minuit2/MnMinos.h"
 #include "Minuit2/MnContours.h"
+#include "Minuit2/MnCross.h"
+#include "Minuit2/MnFunctionCross.h"
 #include "Minuit2/ContoursError.h"
 #include "Minuit2/MnPlot.h"
 #include "Minuit2/FunctionMinimum.h"
 #include "Minuit2/MnHesse.h"
 #include "Minuit2/MnPrint.h"
 #include "Minuit2/MnMatrix.h"
+#include "Minuit2/MnUserCovariance.h"
+#include "Minuit2/MinimumState.h"
+#include "Minuit2/MnUserTransformation.h"
 #include "optimizers/Exception.h"
 #include "optimizers/OutOfBounds.h"
+#include "Parallel.h"
 #include "StMnMinos.h"
 #ifndef BUILD_WITHOUT_ROOT
 #include "RVersion.h"
@@ -34,7 +43,7 @@ namespace optimizers {
   NewMinuit::NewMinuit(Statistic & stat) 
   : Optimizer(stat), m_FCN(stat), 
     m_tolerance(1e-3), m_strategy(ROOT::Minuit2::MnStrategy(1)), m_min(0),
-    m_strategy_value(1) {}
+    m_strategy_value(1), m_warmStart(false) {}
 
   //  =
   NewMinuit & NewMinuit::operator=(const NewMinuit & rhs) {
@@ -47,6 +56,10 @@ namespace optimizers {
       delete m_min;
       m_min = new ROOT::Minuit2::FunctionMinimum(*(rhs.m_min));
       m_strategy_value = rhs.m_strategy_value;
+      m_warmStart = rhs.m_warmStart;
+      m_seedNames = rhs.m_seedNames;
+      m_seedValues = rhs.m_seedValues;
+      m_seedCovariance = rhs.m_seedCovariance;
       return *this;
   }
 
@@ -54,7 +67,9 @@ namespace optimizers {
   NewMinuit::NewMinuit(const NewMinuit & x) 
      : Optimizer(x), 
        m_FCN(x.m_FCN), m_distance(x.m_distance), m_tolerance(x.m_tolerance),
-       m_strategy(x.m_strategy), m_strategy_value(x.m_strategy_value) {
+       m_strategy(x.m_strategy), m_strategy_value(x.m_strategy_value),
+       m_warmStart(x.m_warmStart), m_seedNames(x.m_seedNames),
+       m_seedValues(x.m_seedValues), m_seedCovariance(x.m_seedCovariance) {
      m_min = new ROOT::Minuit2::FunctionMinimum(*(x.m_min));
   }
 
@@ -69,9 +84,12 @@ namespace optimizers {
   }
 
   int NewMinuit::find_min_only(int verbose, double tol, int TolType) {
+    clearEvaluationCache();
+    Instrumentation::Timer timer(instruments(), Instrumentation::FIND_MIN);
     setTolerance(tol, TolType);
     std::vector<Parameter> params;
     m_stat->getFreeParams(params);
+    bool warm = m_warmStart && seedMatches(params);
     ROOT::Minuit2::MnUserParameters upar;
     size_t ii(0);
     for (pptr p = params.begin(); p != params.end(); p++, ii++) {
@@ -79,42 +97,53 @@ namespace optimizers {
        mangledName << ii << "_" << p->getName();
        double min = p->getBounds().first;
        double max = p->getBounds().second;
+       //  Q:  Is 1.0 the best choice for that parameter?
+       double step = 1.0;
+       if (warm && p->error() > 0) {
+         step = p->error();
+       }
        if(min==0. and max==0.) 
          {
            //no bound : same API as Minuit : (min,max)=(0,0)
-           upar.Add(mangledName.str().c_str(), p->getValue(), 1.0);
+           upar.Add(mangledName.str().c_str(), p->getValue(), step);
          }
        //if C++11 is not ok, we need to compare to 
        //#include <limits>
        //double inf=std::numeric_limits<double>::infinity();
        else if(std::isinf(max))
          {
-           upar.Add(mangledName.str().c_str(), p->getValue(), 1.0);
+           upar.Add(mangledName.str().c_str(), p->getValue(), step);
            upar.SetLowerLimit(ii,min);
          }
        else if(std::isinf(min))
          {
-           upar.Add(mangledName.str().c_str(), p->getValue(), 1.0);
+           upar.Add(mangledName.str().c_str(), p->getValue(), step);
            upar.SetUpperLimit(ii,max);
          }
        else 
          {
-           upar.Add(mangledName.str().c_str(), p->getValue(), 1.0, 
+           upar.Add(mangledName.str().c_str(), p->getValue(), step, 
                     min, max); 
          }
-      //  Q:  Is 1.0 the best choice for that parameter?
     }
 
     ROOT::Minuit2::MnUserParameterState userState(upar);
+    if (warm && !m_seedCovariance.empty()) {
+      // Migrad takes its starting error matrix from the covariance.
+      ROOT::Minuit2::MnUserCovariance cov(m_seedCovariance, params.size());
+      userState = ROOT::Minuit2::MnUserParameterState(upar, cov);
+    }
     ROOT::Minuit2::MnMinimize migrad(m_FCN, userState, m_strategy);
     ROOT::Minuit2::FunctionMinimum min = migrad(m_maxEval, m_tolerance);
     delete m_min;
     m_min = new ROOT::Minuit2::FunctionMinimum(min);
     if (verbose > 0) std::cout << *m_min;
+    notifyMigradStates();
     if (!min.IsValid()) {
       throw Exception("Minuit abnormal termination.  No convergence?");
     }
     m_distance = min.Edm();
+    saveSeed();
     std::vector<double> ParamValues;
     unsigned int i = 0;
     for (pptr p = params.begin(); p != params.end(); p++, i++) {
@@ -125,8 +154,27 @@ namespace optimizers {
     return getRetCode();
   }
 
+  // Migrad keeps the state at each of its iterations, in internal
+  // coordinates, so these are replayed to the observer afterwards.
+  void NewMinuit::notifyMigradStates() {
+    if (observer() == 0) {
+      return;
+    }
+    beginIterations();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const ROOT::Minuit2::MnUserTransformation & trafo 
+      = m_min->UserState().Trafo();
+    const std::vector<ROOT::Minuit2::MinimumState> & states 
+      = m_min->States();
+    for (size_t i = 0; i < states.size(); i++) {
+      notifyIteration(trafo(states[i].Vec()), -states[i].Fval(), 
+                      nan, states[i].Edm());
+    }
+  }
+
   // Call Minuit's HESSE to get a robust estimate of the covariance matrix
   void NewMinuit::hesse(int verbose) {
+    Instrumentation::Timer timer(instruments(), Instrumentation::HESSIAN);
     if (!m_min) 
       throw Exception("Minuit: find_min must be executed before hesse");
     ROOT::Minuit2::MnHesse hesse(m_strategy);
@@ -134,10 +182,112 @@ namespace optimizers {
     if (verbose > 0) std::cout << m_min->UserState();
     if (!m_min->HasValidCovariance())
       throw Exception("Minuit HESSE results invalid");
+    saveSeed();
+  }
+
+  void NewMinuit::saveSeed() {
+    std::vector<Parameter> params;
+    m_stat->getFreeParams(params);
+    m_seedNames.clear();
+    m_seedValues.clear();
+    for (size_t i = 0; i < params.size(); i++) {
+      m_seedNames.push_back(params[i].getName());
+      m_seedValues.push_back(m_min->UserParameters().Value(i));
+    }
+    m_seedCovariance.clear();
+    if (m_min->HasCovariance() 
+        && m_min->UserCovariance().Nrow() == params.size()) {
+      m_seedCovariance = m_min->UserCovariance().Data();
+    }
+  }
+
+  bool NewMinuit::seedMatches(const std::vector<Parameter> & params) const {
+    if (params.size() != m_seedNames.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < params.size(); i++) {
+      if (params[i].getName() != m_seedNames[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // The state file is plain text: a header line, the number of free
+  // parameters, one "value name" line per parameter, and the packed
+  // upper triangle of the covariance matrix, if there is one.
+  void NewMinuit::writeState(const std::string & filename) const {
+    if (m_seedNames.empty()) {
+      throw Exception("NewMinuit::writeState: no fit results to write.");
+    }
+    std::ofstream output(filename.c_str());
+    if (!output) {
+      throw Exception("NewMinuit::writeState: cannot open " + filename);
+    }
+    output << "NewMinuit state 1\n"
+           << m_seedNames.size() << "\n";
+    output.precision(17);
+    for (size_t i = 0; i < m_seedNames.size(); i++) {
+      output << m_seedValues[i] << " " << m_seedNames[i] << "\n";
+    }
+    output << m_seedCovariance.size() << "\n";
+    for (size_t k = 0; k < m_seedCovariance.size(); k++) {
+      output << m_seedCovariance[k] << "\n";
+    }
+    output.close();
+    if (!output) {
+      throw Exception("NewMinuit::writeState: error writing " + filename);
+    }
+  }
+
+  void NewMinuit::readState(const std::string & filename) {
+    std::ifstream input(filename.c_str());
+    if (!input) {
+      throw Exception("NewMinuit::readState: cannot open " + filename);
+    }
+    std::string header;
+    std::getline(input, header);
+    if (header != "NewMinuit state 1") {
+      throw Exception("NewMinuit::readState: " + filename 
+                      + " is not a NewMinuit state file.");
+    }
+    size_t npar(0);
+    input >> npar;
+    std::vector<std::string> names(npar);
+    std::vector<double> values(npar);
+    for (size_t i = 0; i < npar && input; i++) {
+      input >> values[i] >> std::ws;
+      std::getline(input, names[i]);
+    }
+    size_t ncov(0);
+    input >> ncov;
+    std::vector<double> covariance(ncov);
+    for (size_t k = 0; k < ncov && input; k++) {
+      input >> covariance[k];
+    }
+    if (!input || (ncov != 0 && ncov != npar*(npar + 1)/2)) {
+      throw Exception("NewMinuit::readState: error reading " + filename);
+    }
+
+    std::vector<Parameter> params;
+    m_stat->getFreeParams(params);
+    bool matches(params.size() == npar);
+    for (size_t i = 0; matches && i < npar; i++) {
+      matches = (params[i].getName() == names[i]);
+    }
+    if (!matches) {
+      throw Exception("NewMinuit::readState: the free parameters in " 
+                      + filename + " do not match those of the Statistic.");
+    }
+    m_stat->setFreeParamValues(values);
+    m_seedNames = names;
+    m_seedValues = values;
+    m_seedCovariance = covariance;
   }
 
   // Call MINOS
   std::pair<double,double> NewMinuit::Minos(unsigned int n, double level, bool numericDeriv) {
+    Instrumentation::Timer timer(instruments(), Instrumentation::MINOS);
     std::vector<double> parValues;
     checkParValues(n, parValues);
     if(level!=1.){
@@ -171,6 +321,7 @@ namespace optimizers {
 
    double NewMinuit::minos_lower_error(unsigned int n, double level,
                                        double tol) {
+      Instrumentation::Timer timer(instruments(), Instrumentation::MINOS);
       std::vector<double> parValues;
       checkParValues(n, parValues);
       if (level != 1) {
@@ -192,6 +343,7 @@ namespace optimizers {
 
    double NewMinuit::minos_upper_error(unsigned int n, double level, 
                                        double tol) {
+      Instrumentation::Timer timer(instruments(), Instrumentation::MINOS);
       std::vector<double> parValues;
       checkParValues(n, parValues);
       if (level != 1) {
@@ -211,6 +363,153 @@ namespace optimizers {
       return upper;
    }
       
+   std::vector< std::pair<double, double> >
+   NewMinuit::MinosAll(const std::vector<unsigned int> & pars, double level,
+                       bool parallel, double tol) {
+      if (!m_min) {
+         throw Exception("Minuit: find_min must be executed before MinosAll");
+      }
+      std::vector<double> parValues;
+      m_stat->getFreeParamValues(parValues);
+      std::vector<unsigned int> indices(pars);
+      if (indices.empty()) {
+         for (unsigned int i = 0; i < parValues.size(); i++) {
+            indices.push_back(i);
+         }
+      }
+      for (size_t i = 0; i < indices.size(); i++) {
+         checkParValues(indices[i], parValues);
+      }
+      std::vector< std::pair<double, double> > errors(indices.size());
+      if (!parallel) {
+         for (size_t i = 0; i < indices.size(); i++) {
+            errors[i].first = minos_lower_error(indices[i], level, tol);
+            errors[i].second = minos_upper_error(indices[i], level, tol);
+         }
+         return errors;
+      }
+
+      Instrumentation::Timer timer(instruments(), Instrumentation::MINOS);
+      size_t ntasks(2*indices.size());
+      unsigned int nthreads(numThreads(ntasks));
+
+// Each thread has its own Statistic and FCN, since MnFunctionCross
+// moves the parameters.  FunctionMinimum is a shared handle, so the
+// error definition is set here, once, and the threads only read it.
+      std::vector< std::unique_ptr<Statistic> > stats;
+      cloneStatistics(*m_stat, nthreads, stats);
+      m_FCN.SetErrorDef(level/2.);
+      m_min->SetErrorDef(level/2.);
+      TaskQueue tasks(ntasks);
+      try {
+         runThreads(nthreads, [&](unsigned int ithread) {
+            myFCN fcn(*stats[ithread]);
+            fcn.SetErrorDef(level/2.);
+            StMnMinos minos(fcn, *m_min, m_strategy);
+            size_t itask;
+            while (tasks.next(itask)) {
+               unsigned int n(indices[itask/2]);
+               stats[ithread]->setFreeParamValues(parValues);
+               if (itask % 2 == 0) {
+                  errors[itask/2].first = minos.Lower_valid(n, 0, tol);
+               } else {
+                  errors[itask/2].second = minos.Upper_valid(n, 0, tol);
+               }
+            }
+         }, &tasks);
+      } catch (...) {
+         m_FCN.SetErrorDef(0.5);
+         m_min->SetErrorDef(0.5);
+         m_stat->setFreeParamValues(parValues);
+         throw;
+      }
+      m_FCN.SetErrorDef(0.5);
+      m_min->SetErrorDef(0.5);
+      m_stat->setFreeParamValues(parValues);
+      return errors;
+   }
+
+   std::vector<Contour> NewMinuit::
+   contours(const std::vector< std::pair<unsigned int, unsigned int> > & pairs,
+            const std::vector<double> & levels, unsigned int npts,
+            bool parallel) {
+      if (!m_min) {
+         throw Exception("Minuit: find_min must be executed before contours");
+      }
+      std::vector<double> parValues;
+      for (size_t i = 0; i < pairs.size(); i++) {
+         checkParValues(pairs[i].first, parValues);
+         checkParValues(pairs[i].second, parValues);
+      }
+      Instrumentation::Timer timer(instruments(), Instrumentation::MINOS);
+
+// Unlike MnContours, which places each new point between the ones
+// already found, each point here is found independently: it is the
+// crossing of the level along the ray from the minimum at angle
+// 2 pi k/npts, in units of the parabolic errors, with the other
+// parameters profiled out.  So all of the points can be computed
+// concurrently.
+      const ROOT::Minuit2::MnUserParameterState & state(m_min->UserState());
+      std::vector<Contour> results;
+      for (size_t i = 0; i < pairs.size(); i++) {
+         for (size_t j = 0; j < levels.size(); j++) {
+            results.push_back(Contour(pairs[i].first, pairs[i].second,
+                                      levels[j]));
+            results.back().points.resize(npts);
+         }
+      }
+      size_t ntasks(results.size()*npts);
+      std::vector<char> valid(ntasks, 0);
+      unsigned int nthreads(parallel ? numThreads(ntasks) : 1);
+
+      std::vector< std::unique_ptr<Statistic> > stats;
+      cloneStatistics(*m_stat, nthreads, stats);
+      TaskQueue tasks(ntasks);
+      runThreads(nthreads, [&](unsigned int ithread) {
+         myFCN fcn(*stats[ithread]);
+         std::vector<unsigned int> par(2);
+         std::vector<double> pmid(2);
+         std::vector<double> pdir(2);
+         size_t itask;
+         while (tasks.next(itask)) {
+            Contour & contour(results[itask/npts]);
+            double angle(2.*M_PI*(itask % npts)/npts);
+            double scale(std::sqrt(contour.level));
+            par[0] = contour.par1;
+            par[1] = contour.par2;
+            pmid[0] = state.Value(par[0]);
+            pmid[1] = state.Value(par[1]);
+            pdir[0] = scale*state.Error(par[0])*std::cos(angle);
+            pdir[1] = scale*state.Error(par[1])*std::sin(angle);
+            fcn.SetErrorDef(contour.level/2.);
+            stats[ithread]->setFreeParamValues(parValues);
+            ROOT::Minuit2::MnFunctionCross cross(fcn, state, m_min->Fval(),
+                                                 m_strategy);
+            ROOT::Minuit2::MnCross crossing(cross(par, pmid, pdir, 0.1,
+                                                  m_maxEval));
+            if (crossing.IsValid()) {
+               contour.points[itask % npts] = 
+                  std::make_pair(pmid[0] + crossing.Value()*pdir[0],
+                                 pmid[1] + crossing.Value()*pdir[1]);
+               valid[itask] = 1;
+            }
+         }
+      }, &tasks);
+
+// Drop the rays that did not cross the level, e.g., at a bound.
+      for (size_t k = 0; k < results.size(); k++) {
+         std::vector< std::pair<double, double> > & points(results[k].points);
+         size_t nvalid(0);
+         for (size_t ipt = 0; ipt < npts; ipt++) {
+            if (valid[k*npts + ipt]) {
+               points[nvalid++] = points[ipt];
+            }
+         }
+         points.resize(nvalid);
+      }
+      return results;
+   }
+
    void NewMinuit::checkParValues(unsigned int n,
                                   std::vector<double> & parValues) const {
       m_stat->getFreeParamValues(parValues);
@@ -36,6 +36,8 @@ void OptPP::statInterface(int mode, int ndim, const ColumnVector &x,
    
    assert(ndim == static_cast<int>(s_stat->getNumFreeParams()));
 
+   std::vector<double> derivsVec;
+
    if (mode & NLPFunction) {
       std::vector<double> paramValues;
       if (s_verbose) std::cout << "parameter values: ";
@@ -45,16 +47,22 @@ void OptPP::statInterface(int mode, int ndim, const ColumnVector &x,
          if (s_verbose) std::cout << param_val << "  ";
       }
 
-      s_stat->setFreeParamValues(paramValues);
-      fx = -s_stat->value();
+      if (mode & NLPGradient) {
+         s_stat->valueAndFreeDerivs(paramValues, fx, derivsVec);
+         fx = -fx;
+      } else {
+         s_stat->setFreeParamValues(paramValues);
+         fx = -s_stat->value();
+      }
       result = NLPFunction;
 
       if (s_verbose) std::cout << "f(x) = " << fx << std::endl;
    }
 
    if (mode & NLPGradient) {
-      std::vector<double> derivsVec;
-      const_cast<Statistic *>(s_stat)->getFreeDerivs(derivsVec);
+      if (!(mode & NLPFunction)) {
+         const_cast<Statistic *>(s_stat)->getFreeDerivs(derivsVec);
+      }
       if (s_verbose) std::cout << "gradients: ";
       for (int i = 0; i < ndim; i++) {
          gx(i+1) = -derivsVec[i];
@@ -82,8 +90,13 @@ int OptPP::find_min_only(int verbose, double tol, int foo) {
 }
 
 int OptPP::find_min(int verbose, double tol, int) {
+   clearEvaluationCache();
+   Instrumentation::Timer timer(instruments(), Instrumentation::FIND_MIN);
 
    s_verbose = verbose;
+// Evaluate through the cache and instrumentation, if enabled since
+// construction.
+   s_stat = m_stat;
 
    int ndim = s_stat->getNumFreeParams();
    
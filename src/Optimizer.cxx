@@ -8,15 +8,30 @@
 
 #include <cmath>
 
+#include <algorithm>
+#include <memory>
+
 #include <sstream>
 #include <stdexcept>
 
 #include "optimizers/dArg.h"
 #include "optimizers/Exception.h"
 #include "optimizers/Optimizer.h"
+#include "optimizers/SparseHessian.h"
 #include "optimizers/Statistic.h"
 #include "optimizers/Util.h"
 
+#include "Parallel.h"
+
+#ifdef HAVE_LAPACK
+extern "C" {
+   void dpotrf_(const char * uplo, const int * n, double * a,
+                const int * lda, int * info, int strlen);
+   void dpotri_(const char * uplo, const int * n, double * a,
+                const int * lda, int * info, int strlen);
+}
+#endif
+
 namespace {
    class StatDerivFunc {
    public:
@@ -38,68 +53,298 @@ namespace {
       size_t m_jpar;
       std::vector<double> m_parVals;
    };
+
+#ifndef HAVE_LAPACK
+/// The dense kernels below work on the lower triangle of an n x n
+/// matrix stored row by row, so that their inner loops run over
+/// contiguous elements, and on blocks of rows small enough to stay
+/// in cache.
+   const size_t blockSize(64);
+
+/// Dot product with independent partial sums, which the compiler can
+/// keep in vector registers.
+   double dot(const double * x, const double * y, size_t n) {
+      double s0(0), s1(0), s2(0), s3(0);
+      size_t k(0);
+      for ( ; k + 4 <= n; k += 4) {
+         s0 += x[k]*y[k];
+         s1 += x[k+1]*y[k+1];
+         s2 += x[k+2]*y[k+2];
+         s3 += x[k+3]*y[k+3];
+      }
+      for ( ; k < n; k++) {
+         s0 += x[k]*y[k];
+      }
+      return (s0 + s1) + (s2 + s3);
+   }
+
+/// Right-looking blocked Cholesky decomposition, A = L L^T.  For
+/// each block of columns, factor the diagonal block, solve for the
+/// rows of L below it, then subtract their products from the rest of
+/// the matrix.  Returns false, with the value of the pivot, if A is
+/// not positive definite.
+   bool choleskyLower(double * a, size_t n, double & pivot) {
+      for (size_t kb = 0; kb < n; kb += blockSize) {
+         size_t ke(std::min(kb + blockSize, n));
+         for (size_t i = kb; i < n; i++) {
+            double * ai(a + i*n);
+            size_t jend(std::min(i + 1, ke));
+            for (size_t j = kb; j < jend; j++) {
+               const double * aj(a + j*n);
+               double sum(ai[j] - dot(ai + kb, aj + kb, j - kb));
+               if (j < i) {
+                  ai[j] = sum/aj[j];
+               } else if (sum <= 0) {
+                  pivot = sum;
+                  return false;
+               } else {
+                  ai[i] = std::sqrt(sum);
+               }
+            }
+         }
+         for (size_t i = ke; i < n; i++) {
+            double * ai(a + i*n);
+            for (size_t j = ke; j <= i; j++) {
+               ai[j] -= dot(ai + kb, a + j*n + kb, ke - kb);
+            }
+         }
+      }
+      return true;
+   }
+
+/// The inverse, W, of the factor L, stored by columns in the upper
+/// triangle of u: column j of W solves L w = e_j, so
+/// w_i = (delta_ij - sum_{j <= k < i} L_ik w_k)/L_ii.  A block of
+/// columns is solved at once, so that each row of L is read once for
+/// all of them.
+   void invertLower(const double * l, size_t n, double * u) {
+      for (size_t jb = 0; jb < n; jb += blockSize) {
+         size_t je(std::min(jb + blockSize, n));
+         for (size_t i = jb; i < n; i++) {
+            const double * li(l + i*n);
+            size_t jend(std::min(i + 1, je));
+            for (size_t j = jb; j < jend; j++) {
+               double * wj(u + j*n);
+               if (j == i) {
+                  wj[i] = 1./li[i];
+               } else {
+                  wj[i] = -dot(li + j, wj + j, i - j)/li[i];
+               }
+            }
+         }
+      }
+   }
+
+/// The lower triangle of W^T W, the inverse of the original matrix,
+/// from the columns of W in u: element (i, j) is the dot product of
+/// columns i and j over rows k >= i, where both may be nonzero.
+   void lowerProduct(const double * u, size_t n, double * a) {
+      for (size_t ib = 0; ib < n; ib += blockSize) {
+         size_t ie(std::min(ib + blockSize, n));
+         for (size_t jb = 0; jb <= ib; jb += blockSize) {
+            for (size_t i = ib; i < ie; i++) {
+               const double * wi(u + i*n + i);
+               size_t jend(std::min(jb + blockSize, i + 1));
+               for (size_t j = jb; j < jend; j++) {
+                  a[i*n + j] = dot(wi, u + j*n + i, n - i);
+               }
+            }
+         }
+      }
+   }
+
+#endif // HAVE_LAPACK
+
+/// Copy the lower triangle to the upper.
+   void symmetrize(double * a, size_t n) {
+      for (size_t i = 0; i < n; i++) {
+         for (size_t j = 0; j < i; j++) {
+            a[j*n + i] = a[i*n + j];
+         }
+      }
+   }
 }
 
 namespace optimizers {
 
 const std::vector<double> & Optimizer::getUncertainty(bool) {
    double eps(1e-7);
+
+// Statistics with a sparse Hessian need only its factor within the
+// envelope for the diagonal of the covariance matrix.
+   std::vector< std::vector<size_t> > pattern;
+   if (m_stat->getFreeHessianPattern(pattern)) {
+      std::shared_ptr<SparseHessian> sparseHess(new SparseHessian(pattern));
+      computeSparseHessian(*sparseHess, eps);
+      sparseHess->choleskyDecompose();
+      std::vector<double> variances;
+      sparseHess->inverseDiagonal(variances);
+      m_sparseHessian = sparseHess;
+      m_covariance = CovarianceMatrix();
+      m_uncertainty.clear();
+      for (size_t i = 0; i < variances.size(); i++) {
+         m_uncertainty.push_back(sqrt(variances[i]));
+      }
+      return m_uncertainty;
+   }
+
+   m_sparseHessian.reset();
    std::valarray<double> hess;
    computeHessian(hess, eps);
 
    choleskyDecompose(hess);
+   choleskyInvert(hess);
 
-// Repack in compact form.
-   int npars = static_cast<int>(sqrt(double(hess.size()))+0.1);
-   std::valarray<double> compactHess(npars*(npars+1)/2);
-   int indx(0);
-   for (int j = 0; j < npars; j++) {
-      for (int i = 0; i <= j; i++) {
-         compactHess[indx++] = hess[i + j*npars];
+// Keep the covariance matrix, and extract the error estimates as the
+// square-roots of its diagonal elements.
+   size_t npars(static_cast<size_t>(sqrt(double(hess.size())) + 0.1));
+   m_covariance = CovarianceMatrix(npars);
+   m_uncertainty.clear();
+   for (size_t i = 0; i < npars; i++) {
+      for (size_t j = 0; j < npars; j++) {
+         m_covariance(i, j) = hess[i*npars + j];
       }
+      m_uncertainty.push_back(m_covariance.uncertainty(i));
    }
 
-// Invert using the BLAS routine to get the covariance matrix.
-   int info;
-   const char uplo = 'U';
-   dpptri_(&uplo, &npars, &compactHess[0], &info, 1);
-   if (info < 0) {
-      throw Exception("DPPTRI: illegal argument value", -info);
-   } else if (info > 0) {
-      throw Exception("DPPTRI: Zero diagonal element in Cholesky factor",
-                      info);
+   return m_uncertainty;
+}
+
+void Optimizer::setEvaluationCache(unsigned int nentries) {
+// The cache goes outside of the instrumentation wrapper, so that
+// only the evaluations that reach the Statistic are timed.
+   Statistic & stat(m_instrumented ? *m_instrumented : this->stat());
+   if (nentries == 0) {
+      m_cache.reset();
+      m_stat = &stat;
+      return;
    }
+   m_cache.reset(new CachedStatistic(stat, nentries));
+   m_stat = m_cache.get();
+}
 
-// Extract the error estimates as the square-roots of the diagonal
-// elements.
-   m_uncertainty.clear();
-   for (int i = 0; i < npars; i++) {
-      m_uncertainty.push_back(sqrt(compactHess[i*(i + 3)/2]));
+void Optimizer::setInstrumentation(bool enable) {
+   if (enable == static_cast<bool>(m_instruments)) {
+      return;
+   }
+   unsigned int nentries(m_cache ? m_cache->nentries() : 0);
+   if (enable) {
+      m_instruments.reset(new Instrumentation());
+      m_instrumented.reset(new InstrumentedStatistic(stat(), *m_instruments));
+   } else {
+      Statistic & stat(this->stat());
+      m_cache.reset();
+      m_instrumented.reset();
+      m_instruments.reset();
+      m_stat = &stat;
    }
+// Rebuild the cache, if any, over the new innermost Statistic and
+// point m_stat at the outermost one.
+   setEvaluationCache(nentries);
+}
 
-   return m_uncertainty;
+std::vector< std::pair<double, double> > 
+Optimizer::MinosAll(const std::vector<unsigned int> & pars, double level,
+                    bool parallel) {
+   (void)(parallel);
+   std::vector<unsigned int> indices(pars);
+   if (indices.empty()) {
+      for (unsigned int i = 0; i < m_stat->getNumFreeParams(); i++) {
+         indices.push_back(i);
+      }
+   }
+   std::vector< std::pair<double, double> > errors;
+   for (size_t i = 0; i < indices.size(); i++) {
+      errors.push_back(Minos(indices[i], level));
+   }
+   return errors;
+}
+
+void Optimizer::notifyIteration(const std::vector<double> & params,
+                                double value, double gradNorm, double edm) {
+   if (m_observer == 0) {
+      return;
+   }
+   IterationRecord & record(m_iteration);
+   double step(0);
+   if (!record.params.empty()) {
+      if (record.params == params && record.value == value) {
+         return;
+      }
+      for (size_t i = 0; i < params.size() && i < record.params.size(); i++) {
+         double dx(params[i] - record.params[i]);
+         step += dx*dx;
+      }
+      step = std::sqrt(step);
+      record.iteration++;
+   }
+   record.params = params;
+   record.value = value;
+   record.gradNorm = gradNorm;
+   record.stepLength = step;
+   record.edm = edm;
+   m_observer->update(record);
+}
+
+void Optimizer::notifyPortIteration(const std::vector<int> & iv,
+                                    const std::vector<double> & v,
+                                    int & niter) {
+// PORT subscripts, less one: iv(NITER) = iv[30] and iv(X0) = iv[42]
+// locate the iteration count and the copy of the point from which
+// the current iteration started; v(DGNORM) = v[0], v(NREDUC) = v[5]
+// and v(F0) = v[12] hold the norm of the gradient wrt the free
+// variables, the reduction predicted for a full Newton step and
+// the function value at that point.  The drivers minimize -value.
+   if (m_observer == 0 || iv[30] == niter) {
+      return;
+   }
+   niter = iv[30];
+   const double * x0(&v[iv[42] - 1]);
+   m_portParams.assign(x0, x0 + m_stat->getNumFreeParams());
+   notifyIteration(m_portParams, -v[12], v[0], v[5]);
 }
 
 #if 1
 void Optimizer::computeHessian(std::valarray<double> &hess, double eps) {
 // Compute the Hessian matrix for the free parameters using simple
 // finite differences.
+   Instrumentation::Timer timer(instruments(), Instrumentation::HESSIAN);
    std::vector<double> params;
    m_stat->getFreeParamValues(params);
 
-// get a copy of the parameters for inspecting bounds
-   std::vector<Parameter> parameters;
-   m_stat->getFreeParams(parameters);
-
    std::vector<double> firstDerivs;
    m_stat->getFreeDerivs(firstDerivs);
 
-// Obtain the full Hessian matrix.
    int npars = params.size();
+   std::vector<double> deltas;
+   hessianSteps(params, eps, deltas);
+
+// Obtain the full Hessian matrix.
    hess.resize(npars*npars);
-   int indx(0);
-   for (int irow = 0; irow < npars; irow++) {
-      std::vector<double> new_params = params;
+
+   unsigned int nthreads(numThreads(npars, m_hessianThreads));
+
+   if (nthreads <= 1) {
+      for (int irow = 0; irow < npars; irow++) {
+         hessianRow(*m_stat, params, irow, deltas[irow], firstDerivs,
+                    &hess[irow*npars]);
+      }
+   } else {
+      computeHessianRows(hess, params, deltas, firstDerivs, nthreads);
+   }
+
+// Restore Parameter values.
+   m_stat->setFreeParamValues(params);
+}
+
+void Optimizer::hessianSteps(const std::vector<double> & params, double eps,
+                             std::vector<double> & deltas) const {
+// get a copy of the parameters for inspecting bounds
+   std::vector<Parameter> parameters;
+   m_stat->getFreeParams(parameters);
+
+   deltas.resize(params.size());
+   for (size_t irow = 0; irow < params.size(); irow++) {
       double delta;
       if (params[irow] == 0) {
          delta = eps;
@@ -113,19 +358,114 @@ void Optimizer::computeHessian(std::valarray<double> &hess, double eps) {
           params[irow] + delta > bounds.second) {
          delta *= -1;
       }
+      deltas[irow] = delta;
+   }
+}
+
+void Optimizer::computeSparseHessian(SparseHessian & hess, double eps) {
+// Curtis-Powell-Reid estimation: step all of the parameters of a
+// group at once; the change in the gradient gives their columns.
+   Instrumentation::Timer timer(instruments(), Instrumentation::HESSIAN);
+   std::vector<double> params;
+   m_stat->getFreeParamValues(params);
+
+   std::vector<double> firstDerivs;
+   m_stat->getFreeDerivs(firstDerivs);
+
+   std::vector<double> deltas;
+   hessianSteps(params, eps, deltas);
 
-      new_params[irow] = params[irow] + delta;
-      m_stat->setFreeParamValues(new_params);
+   size_t ngroups(hess.numGroups());
+   auto groupColumns = [&](Statistic & stat, size_t igroup) {
+      const std::vector<size_t> & columns(hess.group(igroup));
+      std::vector<double> new_params(params);
+      for (size_t k = 0; k < columns.size(); k++) {
+         new_params[columns[k]] += deltas[columns[k]];
+      }
+      stat.setFreeParamValues(new_params);
       std::vector<double> derivs;
-      m_stat->getFreeDerivs(derivs);
-      for (int icol = 0; icol < npars; icol++) {
-         hess[indx] = -(derivs[icol] - firstDerivs[icol])/delta;
-         indx++;
+      stat.getFreeDerivs(derivs);
+      for (size_t i = 0; i < derivs.size(); i++) {
+         derivs[i] = -(derivs[i] - firstDerivs[i]);
       }
+// Each group sets only its own columns, so the groups may be
+// stored concurrently.
+      hess.setGroup(igroup, derivs, deltas);
+   };
+
+   unsigned int nthreads(numThreads(ngroups, m_hessianThreads));
+   if (nthreads <= 1) {
+      for (size_t igroup = 0; igroup < ngroups; igroup++) {
+         groupColumns(*m_stat, igroup);
+      }
+   } else {
+      std::vector< std::unique_ptr<Statistic> > stats;
+      cloneStatistics(*m_stat, nthreads, stats);
+      TaskQueue groups(ngroups);
+      HessianSchedule schedule(m_hessianSchedule);
+      runThreads(nthreads, [&](unsigned int ithread) {
+         Statistic & stat(*stats[ithread]);
+         if (schedule == STATIC) {
+            for (size_t igroup = ithread; igroup < ngroups;
+                 igroup += nthreads) {
+               groupColumns(stat, igroup);
+            }
+         } else {
+            size_t igroup;
+            while (groups.next(igroup)) {
+               groupColumns(stat, igroup);
+            }
+         }
+      }, &groups);
    }
+
 // Restore Parameter values.
    m_stat->setFreeParamValues(params);
 }
+
+void Optimizer::hessianRow(Statistic & stat, 
+                           const std::vector<double> & params,
+                           size_t irow, double delta,
+                           const std::vector<double> & firstDerivs,
+                           double * row) {
+   std::vector<double> new_params(params);
+   new_params[irow] = params[irow] + delta;
+   stat.setFreeParamValues(new_params);
+   std::vector<double> derivs;
+   stat.getFreeDerivs(derivs);
+   for (size_t icol = 0; icol < params.size(); icol++) {
+      row[icol] = -(derivs[icol] - firstDerivs[icol])/delta;
+   }
+}
+
+void Optimizer::computeHessianRows(std::valarray<double> & hess,
+                                   const std::vector<double> & params,
+                                   const std::vector<double> & deltas,
+                                   const std::vector<double> & firstDerivs,
+                                   unsigned int nthreads) {
+// Each thread evaluates its rows using its own copy of the Statistic.
+   std::vector< std::unique_ptr<Statistic> > stats;
+   cloneStatistics(*m_stat, nthreads, stats);
+
+   size_t npars(params.size());
+   TaskQueue rows(npars);
+   HessianSchedule schedule(m_hessianSchedule);
+   runThreads(nthreads, [&](unsigned int ithread) {
+      Statistic & stat(*stats[ithread]);
+      if (schedule == STATIC) {
+         for (size_t irow = ithread; irow < npars; irow += nthreads) {
+            hessianRow(stat, params, irow, deltas[irow], firstDerivs,
+                       &hess[irow*npars]);
+         }
+      } else {
+         size_t irow;
+         while (rows.next(irow)) {
+            hessianRow(stat, params, irow, deltas[irow], firstDerivs,
+                       &hess[irow*npars]);
+         }
+      }
+   }, &rows);
+}
 #else
 void Optimizer::computeHessian(std::valarray<double> & hess, double eps) {
    std::vector<double> params;
@@ -150,44 +490,64 @@ void Optimizer::computeHessian(std::valarray<double> & hess, double eps) {
 #endif
 
 void Optimizer::choleskyDecompose(std::valarray<double> & array) {
-// This implementation is based on NR's choldc().
-
-   int npts = static_cast<int>(sqrt(double(array.size()))+0.1);
-   std::valarray<double> p(npts);
-
-   for (int i = 0; i < npts; i++) {
-      for (int j = i; j < npts; j++) {
-// Here we use the FORTRAN subscripting convention, 
-// a[i][j] = array[i + j*npts].
-         double sum = array[i + j*npts];
-         for (int k = i - 1; k >= 0; k--) {
-            sum -= array[i + k*npts]*array[j + k*npts];
-         }
-         if (i == j) {
-            if (sum <= 0) {
-               std::ostringstream errorMessage;
-               errorMessage << "Optimizer::choleskyDecompose:\n"
-                            << "Imaginary diagonal element.\n"
-                            << "Element value squared = " << sum << "\n";
-               throw Exception(errorMessage.str());
-            }
-            p[i] = sqrt(sum);
-         } else {
-            array[j + i*npts] = sum/p[i];
-         }
-      }
+// The matrix is symmetric, so it may be read row by row.  The factor
+// L is formed in the lower triangle, then copied to the upper.
+   size_t npts(static_cast<size_t>(sqrt(double(array.size())) + 0.1));
+   if (npts == 0) {
+      return;
+   }
+   double * a(&array[0]);
+#ifdef HAVE_LAPACK
+// The lower triangle by rows is the upper triangle by columns.
+   const char uplo('U');
+   int n(npts);
+   int info;
+   dpotrf_(&uplo, &n, a, &n, &info, 1);
+   if (info < 0) {
+      throw Exception("DPOTRF: illegal argument value", -info);
+   } else if (info > 0) {
+      std::ostringstream errorMessage;
+      errorMessage << "Optimizer::choleskyDecompose:\n"
+                   << "Imaginary diagonal element.\n"
+                   << "Element number " << info << "\n";
+      throw Exception(errorMessage.str());
    }
+#else
+   double pivot;
+   if (!::choleskyLower(a, npts, pivot)) {
+      std::ostringstream errorMessage;
+      errorMessage << "Optimizer::choleskyDecompose:\n"
+                   << "Imaginary diagonal element.\n"
+                   << "Element value squared = " << pivot << "\n";
+      throw Exception(errorMessage.str());
+   }
+#endif
+   ::symmetrize(a, npts);
+}
 
-// Symmetrize.
-   for (int i = 0; i < npts; i++) {
-      for (int j = i; j < npts; j++) {
-         if (i == j) {
-            array[i + j*npts] = p[i];
-         } else {
-            array[i + j*npts] = array[j + i*npts];
-         }
-      }
+void Optimizer::choleskyInvert(std::valarray<double> & array) {
+   size_t npts(static_cast<size_t>(sqrt(double(array.size())) + 0.1));
+   if (npts == 0) {
+      return;
    }
+   double * a(&array[0]);
+#ifdef HAVE_LAPACK
+   const char uplo('U');
+   int n(npts);
+   int info;
+   dpotri_(&uplo, &n, a, &n, &info, 1);
+   if (info < 0) {
+      throw Exception("DPOTRI: illegal argument value", -info);
+   } else if (info > 0) {
+      throw Exception("DPOTRI: Zero diagonal element in Cholesky factor",
+                      info);
+   }
+#else
+   std::vector<double> columns(npts*npts);
+   ::invertLower(a, npts, &columns[0]);
+   ::lowerProduct(&columns[0], npts, a);
+#endif
+   ::symmetrize(a, npts);
 }
 
 std::ostream& operator<<(std::ostream& s, const Optimizer& t) {
@@ -195,10 +555,40 @@ std::ostream& operator<<(std::ostream& s, const Optimizer& t) {
 }
 
 std::vector<std::vector<double> > Optimizer::covarianceMatrix() const {
-   throw std::runtime_error("Optimizer::covarianceMatrix member function "
-                            "not implemented yet.");
-   std::vector<std::vector<double> > ret;
-   return ret;
+   return covariance().rows();
+}
+
+CovarianceMatrix Optimizer::covariance() const {
+   if (m_sparseHessian) {
+// Solve for one column at a time from the sparse factor.
+      size_t npars(m_sparseHessian->size());
+      CovarianceMatrix matrix(npars);
+      std::vector<double> column;
+      for (size_t j = 0; j < npars; j++) {
+         column.assign(npars, 0);
+         column[j] = 1;
+         m_sparseHessian->solve(column);
+         for (size_t i = 0; i < npars; i++) {
+            matrix(i, j) = column[i];
+         }
+      }
+      return matrix;
+   }
+   if (m_covariance.empty()) {
+      throw Exception("Optimizer::covariance: "
+                      "the covariance matrix has not been computed.");
+   }
+   return m_covariance;
+}
+
+void Optimizer::setPackedCovariance(int npars,
+                                    const std::vector<double> & packed) {
+   m_sparseHessian.reset();
+   m_covariance.setPacked(npars, packed);
+   m_uncertainty.clear();
+   for (int i = 0; i < npars; i++) {
+      m_uncertainty.push_back(m_covariance.uncertainty(i));
+   }
 }
 
 } // namespace optimizers
@@ -13,11 +13,14 @@
 #include "optimizers/Drmnfb.h"
 #include "optimizers/ModNewton.h"
 #include "optimizers/Lbfgs.h"
+#include "optimizers/LbfgsB.h"
 #include "optimizers/Minuit.h"
+#include "optimizers/MultiStart.h"
 #include "optimizers/NewMinuit.h"
 #include "optimizers/Optimizer.h"
 #include "optimizers/Statistic.h"
 #include "optimizers/Powell.h"
+#include "optimizers/Simplex.h"
 
 #include "optimizers/OptimizerFactory.h"
 
@@ -37,7 +40,10 @@ Optimizer * OptimizerFactory::create(const std::string & optimizerName,
    if (optimizerName == "Minuit" || optimizerName == "MINUIT") {
       return new Minuit(stat);
    } else if (optimizerName == "Lbfgs" || optimizerName == "LBFGS") {
-      return new Lbfgs(stat);
+//      return new Lbfgs(stat);
+      return new LbfgsB(stat);
+   } else if (optimizerName == "LbfgsB" || optimizerName == "LBFGSB") {
+      return new LbfgsB(stat);
    } else if (optimizerName == "Drmngb" || optimizerName == "DRMNGB") {
 //      return new Drmngb(stat);
       return new ModNewton(stat, true);
@@ -48,6 +54,15 @@ Optimizer * OptimizerFactory::create(const std::string & optimizerName,
       return new Powell(stat);
    } else if (optimizerName == "NewMinuit" || optimizerName == "NEWMINUIT") {
       return new NewMinuit(stat);
+   } else if (optimizerName == "Simplex" || optimizerName == "SIMPLEX"
+              || optimizerName == "Amoeba" || optimizerName == "AMOEBA") {
+      return new Simplex(stat);
+   } else if (optimizerName == "MultiStart" || optimizerName == "MULTISTART") {
+      return new MultiStart(stat);
+   } else if (optimizerName.substr(0, 11) == "MultiStart:"
+              || optimizerName.substr(0, 11) == "MULTISTART:") {
+// The local Optimizer follows the colon, e.g., "MultiStart:Lbfgs".
+      return new MultiStart(stat, optimizerName.substr(11));
    } else {
       throw std::runtime_error("Invalid optimizer choice: " + optimizerName);
    }
@@ -0,0 +1,109 @@
+/**
+ * @file Parallel.h
+ * @brief Helpers for running independent tasks on a pool of threads,
+ * each thread with its own clone of the Statistic.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#ifndef optimizers_Parallel_h
+#define optimizers_Parallel_h
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "optimizers/Exception.h"
+#include "optimizers/Statistic.h"
+
+namespace optimizers {
+
+/// The number of threads to use for ntasks independent tasks: the
+/// requested number, or one per hardware core if that is zero, but
+/// never more than there are tasks.
+inline unsigned int numThreads(size_t ntasks, unsigned int requested=0) {
+   unsigned int nthreads(requested);
+   if (nthreads == 0) {
+      nthreads = std::thread::hardware_concurrency();
+   }
+   if (nthreads == 0) {
+      nthreads = 1;
+   }
+   if (nthreads > ntasks) {
+      nthreads = ntasks;
+   }
+   return nthreads;
+}
+
+/// Append one clone of stat for each of nthreads threads to stats.
+inline void cloneStatistics(const Statistic & stat, unsigned int nthreads,
+                            std::vector< std::unique_ptr<Statistic> > & stats) {
+   for (unsigned int ithread = 0; ithread < nthreads; ithread++) {
+      Function * clone(stat.clone());
+      Statistic * statClone(dynamic_cast<Statistic *>(clone));
+      if (statClone == 0) {
+         delete clone;
+         throw Exception("Statistic::clone did not return a Statistic.");
+      }
+      stats.push_back(std::unique_ptr<Statistic>(statClone));
+   }
+}
+
+/// Hands out the task numbers 0 through ntasks - 1 to the threads
+/// that share it, each number once.
+class TaskQueue {
+public:
+   TaskQueue(size_t ntasks) : m_ntasks(ntasks), m_next(0) {}
+
+   /// Take the next task, if any are left.
+   bool next(size_t & itask) {
+      itask = m_next++;
+      return itask < m_ntasks;
+   }
+
+   /// Hand out no more tasks, e.g., once one has failed.
+   void cancel() {
+      m_next = m_ntasks;
+   }
+
+private:
+   size_t m_ntasks;
+   std::atomic<size_t> m_next;
+};
+
+/// Run worker(ithread) on each of nthreads threads and, once all of
+/// them have finished, rethrow the first exception that any threw.
+/// If the workers take their tasks from a TaskQueue, pass it as
+/// tasks, so that the others stop taking new ones after a failure.
+template <typename Worker>
+void runThreads(unsigned int nthreads, Worker worker, TaskQueue * tasks=0) {
+   std::vector<std::exception_ptr> failures(nthreads);
+   std::vector<std::thread> threads;
+   for (unsigned int ithread = 0; ithread < nthreads; ithread++) {
+      threads.push_back(std::thread([&, ithread]() {
+         try {
+            worker(ithread);
+         } catch (...) {
+            failures[ithread] = std::current_exception();
+            if (tasks != 0) {
+               tasks->cancel();
+            }
+         }
+      }));
+   }
+   for (unsigned int ithread = 0; ithread < nthreads; ithread++) {
+      threads[ithread].join();
+   }
+   for (unsigned int ithread = 0; ithread < nthreads; ithread++) {
+      if (failures[ithread]) {
+         std::rethrow_exception(failures[ithread]);
+      }
+   }
+}
+
+} // namespace optimizers
+
+#endif // optimizers_Parallel_h
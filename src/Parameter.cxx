@@ -114,6 +114,14 @@ std::pair<double, double> Parameter::getBounds() const {
    return my_Bounds;
 }
 
+std::pair<double, double> Parameter::effectiveBounds() const {
+   if (m_minValue == 0 && m_maxValue == 0) {
+      return std::make_pair(-std::numeric_limits<double>::infinity(),
+                            std::numeric_limits<double>::infinity());
+   }
+   return getBounds();
+}
+
 void Parameter::extractDomData(const DOMElement * elt) {
    m_name = xmlBase::Dom::getAttribute(elt, "name");
    m_value = std::atof(xmlBase::Dom::getAttribute(elt, "value").c_str());
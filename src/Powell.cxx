@@ -1,6 +1,8 @@
 #include "optimizers/Powell.h"
 #include "optimizers/Exception.h"
+#include "Parallel.h"
 #include <limits>
+#include <memory>
 #include <cmath>
 
 namespace optimizers {
@@ -31,27 +33,58 @@ namespace optimizers {
   // Values of the function along a line in parameter space.
   // Used in the line-search part of the algorithm.  
   double Powell::f1dim(double x) {
-    int ncom = m_stat->getNumFreeParams();
-    std::vector<double> xt(ncom);
+    int ncom = m_pcom.size();
+    m_xt.resize(ncom);
     for (int j=0; j<ncom; j++) {
-      xt[j] = m_pcom[j] + x * m_xicom[j];
+      m_xt[j] = m_pcom[j] + x * m_xicom[j];
     } 
-    return this->value(xt);
+    return this->value(m_xt);
   }
 
+  // A line in parameter space for the concurrent line minimizations,
+  // evaluated on its own clone of the Statistic.  The buffers are
+  // allocated once and reused for every probe.
+  class PowellLine {
+  public:
+    PowellLine(Statistic &stat, int n) 
+      : m_stat(stat), m_pcom(n), m_xicom(n), m_xt(n) {}
+    double f1dim(double x) {
+      for (size_t j=0; j<m_xt.size(); j++) {
+	m_xt[j] = m_pcom[j] + x * m_xicom[j];
+      }
+      m_stat.setFreeParamValues(m_xt);
+      return -m_stat.value();
+    }
+    void set_pcom(const std::vector<double> &pc) {m_pcom = pc;}
+    void set_xicom(const std::vector<double> &xi) {m_xicom = xi;}
+  private:
+    Statistic &m_stat;
+    std::vector<double> m_pcom;
+    std::vector<double> m_xicom;
+    std::vector<double> m_xt;
+  };
+
   // Function value at an arbitrary point
   double Powell::value(std::vector<double> &pval) {
     m_stat->setFreeParamValues(pval);
     return -m_stat->value();
   }
 
+  void Powell::acceptStep(const std::vector<double> &p, double fret) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    notifyIteration(p, -fret, nan, nan);
+  }
+
   // The minimizer.  It's just a wrapper for the function powell.
   int Powell::find_min_only(int verbose, double tol, int tolType) {
     return find_min(verbose, tol, tolType);
   }
 
   int Powell::find_min(int verbose, double tol, int tolType) {
+    clearEvaluationCache();
+    Instrumentation::Timer timer(instruments(), Instrumentation::FIND_MIN);
     (void) (verbose);
+    beginIterations();
     std::vector<double> p;
     m_stat->getFreeParamValues(p);
     int npar = p.size();
@@ -60,7 +93,15 @@ namespace optimizers {
       xi.push_back(std::vector<double>(npar,0.));
       xi[j][j] = 1.;
     }
-    int code = powell(p, xi, tol, tolType, m_iter, m_maxEval, m_fret, *this);
+    unsigned int nthreads = m_nthreads == 1 ? 1 : numThreads(npar, m_nthreads);
+    int code;
+    if (nthreads > 1) {
+      code = parallelPowell(p, xi, tol, tolType, m_maxEval, nthreads);
+    } else {
+      code = powell(p, xi, tol, tolType, m_iter, m_maxEval, m_fret, *this);
+    }
+    // Leave the Statistic at the minimum rather than at the last probe.
+    m_stat->setFreeParamValues(p);
     setRetCode(code);
     return code;
   }
@@ -73,8 +114,9 @@ namespace optimizers {
   }
 
   //  Brent's parabolic interpolation method for a 1-dim function
-  double brent(const double ax, const double bx, const double cx, 
-	       Powell &f,const double tol, double &xmin)
+  template<class Line>
+  double lineBrent(const double ax, const double bx, const double cx, 
+		   Line &f, const double tol, double &xmin)
   {
     const int ITMAX=100;
     const double CGOLD=0.3819660;
@@ -139,32 +181,10 @@ namespace optimizers {
     return fx;
   }
 
-  // Line search.  Bracket the minimum and call brent  
-  void linmin(std::vector<double> &p, std::vector<double> &xi, 
-		  double &fret, Powell &func)
-  {
-    int j;
-    const double TOL=1.0e-8;
-    double xx,xmin,fx,fb,fa,bx,ax;
-    
-    int n=p.size();
-    func.set_pcom(p);
-    func.set_xicom(xi);
-    ax=0.0;
-    xx=1.0;
-    mnbrak(ax,xx,bx,fa,fx,fb,func);
-    fret=brent(ax,xx,bx,func,TOL,xmin);
-    for (j=0;j<n;j++) {
-      xi[j] *= xmin;
-      p[j] += xi[j];
-    }
-    func.set_pcom(p);
-    func.set_xicom(xi);
-  }
-
   // Bracket the min. of a 1-d function.
-  void mnbrak(double &ax, double &bx, double &cx, double &fa, double &fb, 
-	      double &fc, Powell &func)
+  template<class Line>
+  void lineBracket(double &ax, double &bx, double &cx, double &fa, 
+		   double &fb, double &fc, Line &func)
   {
     const double GOLD=1.618034,GLIMIT=100.0,TINY=1.0e-20;
     double ulim,u,r,q,fu;
@@ -216,6 +236,45 @@ namespace optimizers {
     }
   }
 
+  // Line search.  Bracket the minimum and call brent  
+  template<class Line>
+  void lineMin(std::vector<double> &p, std::vector<double> &xi, 
+	       double &fret, Line &func)
+  {
+    int j;
+    const double TOL=1.0e-8;
+    double xx,xmin,fx,fb,fa,bx,ax;
+    
+    int n=p.size();
+    func.set_pcom(p);
+    func.set_xicom(xi);
+    ax=0.0;
+    xx=1.0;
+    lineBracket(ax,xx,bx,fa,fx,fb,func);
+    fret=lineBrent(ax,xx,bx,func,TOL,xmin);
+    for (j=0;j<n;j++) {
+      xi[j] *= xmin;
+      p[j] += xi[j];
+    }
+    func.set_pcom(p);
+    func.set_xicom(xi);
+  }
+
+  double brent(const double ax, const double bx, const double cx, 
+	       Powell &f,const double tol, double &xmin) {
+    return lineBrent(ax, bx, cx, f, tol, xmin);
+  }
+
+  void linmin(std::vector<double> &p, std::vector<double> &xi, 
+		  double &fret, Powell &func) {
+    lineMin(p, xi, fret, func);
+  }
+
+  void mnbrak(double &ax, double &bx, double &cx, double &fa, double &fb, 
+	      double &fc, Powell &func) {
+    lineBracket(ax, bx, cx, fa, fb, fc, func);
+  }
+
   // Powell's direction-set method, discarding the direction of
   // largest increase.  See Numerical Recipes.
   int powell(std::vector<double> &p, std::vector<std::vector<double> > &xi, 
@@ -230,6 +289,7 @@ namespace optimizers {
     std::vector<double> pt(n),ptt(n),xit(n);
 
     fret=func.value(p);
+    func.acceptStep(p, fret);
     for (j=0;j<n;j++) pt[j]=p[j];
     for (iter=0;;++iter) {
       fp=fret;
@@ -244,6 +304,7 @@ namespace optimizers {
 	  ibig=i+1;
 	}
       }
+      func.acceptStep(p, fret);
       double fcheck = 0.5 * (fabs(fp)+fabs(fret));
       if (tolType == ABSOLUTE) fcheck = 1.;
       if (fabs(fp-fret) <= ftol*fcheck+TINY) {
@@ -271,4 +332,128 @@ namespace optimizers {
     }
   }
   
-} // namespace 
+  // As powell, but each iteration first performs the line
+  // minimizations along the n directions concurrently, all from the
+  // same point, and then a line minimization along the sum of their
+  // steps.  That is enough for the iteration if it gains at least
+  // half as much as the steps do separately, as it does when the
+  // directions are close to conjugate, and at least 2/n as much as
+  // the last serial sweep, which costs n line minimizations.
+  // Otherwise, and to confirm convergence, the iteration continues
+  // with a serial sweep as in powell.
+  int Powell::parallelPowell(std::vector<double> &p, 
+			     std::vector<std::vector<double> > &xi,
+			     const double ftol, int tolType, int itmax,
+			     unsigned int nthreads)
+  {
+    const double TINY=1.0e-25;
+    int i,j,ibig;
+    double del,fp,fpp,fptt,t,gain;
+    double sweepGain=std::numeric_limits<double>::infinity();
+    double &fret = m_fret;
+    
+    int n=p.size();
+    std::vector<double> pt(n),ptt(n),xit(n);
+
+    // Storage for each thread and each direction, allocated once.
+    std::vector<std::unique_ptr<Statistic> > stats;
+    cloneStatistics(*m_stat, nthreads, stats);
+    std::vector<PowellLine> lines;
+    for (unsigned int k=0; k<nthreads; k++) {
+      lines.push_back(PowellLine(*stats[k], n));
+    }
+    std::vector<std::vector<double> > starts(nthreads, p);
+    std::vector<std::vector<double> > steps(n, std::vector<double>(n));
+    std::vector<double> fsteps(n);
+
+    fret=value(p);
+    acceptStep(p, fret);
+    for (m_iter=0;;++m_iter) {
+      fp=fret;
+      TaskQueue directions(n);
+      runThreads(nthreads, [&](unsigned int ithread) {
+	  size_t idir;
+	  while (directions.next(idir)) {
+	    for (int jj=0; jj<n; jj++) steps[idir][jj]=xi[jj][idir];
+	    starts[ithread]=p;
+	    lineMin(starts[ithread], steps[idir], fsteps[idir], 
+		    lines[ithread]);
+	  }
+	}, &directions);
+      ibig=0;
+      del=0.0;
+      gain=0.0;
+      for (i=0;i<n;i++) {
+	if (fp-fsteps[i] > 0.0) gain += fp-fsteps[i];
+	if (fp-fsteps[i] > del) {
+	  del=fp-fsteps[i];
+	  ibig=i+1;
+	}
+      }
+      for (j=0;j<n;j++) {
+	xit[j]=0.0;
+	for (i=0;i<n;i++) xit[j] += steps[i][j];
+	ptt[j]=p[j];
+      }
+      lineMin(ptt,xit,fptt,*this);
+      if (fptt <= fp-del) {
+	p=ptt;
+	fret=fptt;
+      } else if (ibig > 0) {
+	for (j=0;j<n;j++) p[j] += steps[ibig-1][j];
+	fret=fsteps[ibig-1];
+      }
+      double fcheck = 0.5 * (fabs(fp)+fabs(fret));
+      if (tolType == ABSOLUTE) fcheck = 1.;
+      bool serial = (fp-fret < 0.5*gain || fp-fret < 2.0*sweepGain/n
+		     || fabs(fp-fret) <= ftol*fcheck+TINY);
+      if (serial) {
+	fpp=fret;
+	for (j=0;j<n;j++) pt[j]=p[j];
+	ibig=0;
+	del=0.0;
+	for (i=0;i<n;i++) {
+	  for (j=0;j<n;j++) xit[j]=xi[j][i];
+	  fptt=fret;
+	  lineMin(p,xit,fret,*this);
+	  if (fptt-fret > del) {
+	    del=fptt-fret;
+	    ibig=i+1;
+	  }
+	}
+	sweepGain=fpp-fret;
+      }
+      acceptStep(p, fret);
+      if (serial) {
+	fcheck = 0.5 * (fabs(fpp)+fabs(fret));
+	if (tolType == ABSOLUTE) fcheck = 1.;
+	if (fabs(fpp-fret) <= ftol*fcheck+TINY) {
+	  return 0;
+	}
+      }
+      if (m_iter == itmax) {
+	return 1;
+      }
+      // Only the serial sweeps update the direction set, as in
+      // powell, from the sweep's own starting point and value, net
+      // step and largest decrease.
+      if (!serial) continue;
+      for (j=0;j<n;j++) {
+	ptt[j]=2.0*p[j]-pt[j];
+	xit[j]=p[j]-pt[j];
+      }
+      fptt=value(ptt);
+      if (fptt < fpp && ibig > 0) {
+	t=2.0*(fpp-2.0*fret+fptt)*SQR(fpp-fret-del)-del*SQR(fpp-fptt);
+	if (t < 0.0) {
+	  lineMin(p,xit,fret,*this);
+	  for (j=0;j<n;j++) {
+	    xi[j][ibig-1]=xi[j][n-1];
+	    xi[j][n-1]=xit[j];
+	  }
+	}
+      }
+    }
+  }
+
+} // namespace
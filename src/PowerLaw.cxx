@@ -30,8 +30,7 @@ double PowerLaw::value(const Arg & xarg) const {
 
    enum ParamTypes {Prefactor, Index, Scale};
 
-   std::vector<Parameter> my_params;
-   getParams(my_params);
+   const std::vector<Parameter> & my_params(m_parameter);
 
    return my_params[Prefactor].getTrueValue()
       *pow((x/my_params[Scale].getTrueValue()), 
@@ -40,22 +39,17 @@ double PowerLaw::value(const Arg & xarg) const {
 
 double PowerLaw::derivByParamImp(const Arg & xarg,
                                  const std::string & paramName) const {
+   return derivByParamIndexImp(xarg, parameterIndex(paramName));
+}
+
+double PowerLaw::derivByParamIndexImp(const Arg & xarg,
+                                      unsigned int iparam) const {
    double x = dynamic_cast<const dArg &>(xarg).getValue();
 
    enum ParamTypes {Prefactor, Index, Scale};
 
-   std::vector<Parameter> my_params;
-   getParams(my_params);
-
-   int iparam = -1;
-   for (unsigned int i = 0; i < my_params.size(); i++) {
-      if (paramName == my_params[i].getName()) iparam = i;
-   }
+   const std::vector<Parameter> & my_params(m_parameter);
 
-   if (iparam == -1) {
-      throw ParameterNotFound(paramName, getName(), "PowerLaw::derivByParam");
-   }
-   
    switch (iparam) {
    case Prefactor:
       if (my_params[Prefactor].getTrueValue() != 0) {
@@ -82,13 +76,66 @@ double PowerLaw::derivByParamImp(const Arg & xarg,
    return 0;
 }
 
+void PowerLaw::valuesImp(const double * x, double * out, size_t n) const {
+   enum ParamTypes {Prefactor, Index, Scale};
+
+   double f0 = m_parameter[Prefactor].getTrueValue();
+   double gamma = m_parameter[Index].getTrueValue();
+   double x0 = m_parameter[Scale].getTrueValue();
+
+   for (size_t i = 0; i < n; i++) {
+      out[i] = f0*pow(x[i]/x0, gamma);
+   }
+}
+
+void PowerLaw::derivsImp(const double * x, double * out, size_t n,
+                         bool getFree) const {
+   enum ParamTypes {Prefactor, Index, Scale};
+
+   double f0 = m_parameter[Prefactor].getTrueValue();
+   double gamma = m_parameter[Index].getTrueValue();
+   double x0 = m_parameter[Scale].getTrueValue();
+
+   std::vector<double> & powers(m_powers);
+   powers.resize(n);
+   for (size_t i = 0; i < n; i++) {
+      powers[i] = pow(x[i]/x0, gamma);
+   }
+
+   for (unsigned int iparam = 0; iparam < m_parameter.size(); iparam++) {
+      if (getFree && !m_parameter[iparam].isFree()) {
+         continue;
+      }
+      double scale = m_parameter[iparam].getScale();
+      switch (iparam) {
+      case Prefactor:
+         for (size_t i = 0; i < n; i++) {
+            out[i] = powers[i]*scale;
+         }
+         break;
+      case Index:
+         for (size_t i = 0; i < n; i++) {
+            out[i] = f0*powers[i]*log(x[i]/x0)*scale;
+         }
+         break;
+      case Scale:
+         for (size_t i = 0; i < n; i++) {
+            out[i] = -f0*powers[i]*gamma/x0*scale;
+         }
+         break;
+      default:
+         break;
+      }
+      out += n;
+   }
+}
+
 double PowerLaw::integral(const Arg & xargmin, const Arg & xargmax) const {
    double xmin = dynamic_cast<const dArg &>(xargmin).getValue();
    double xmax = dynamic_cast<const dArg &>(xargmax).getValue();
 
    enum ParamTypes {Prefactor, Index, Scale};
-   std::vector<Parameter> my_params;
-   getParams(my_params);
+   const std::vector<Parameter> & my_params(m_parameter);
 
    double f0 = my_params[Prefactor].getTrueValue();
    double Gamma = my_params[Index].getTrueValue();
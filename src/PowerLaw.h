@@ -38,6 +38,18 @@ protected:
 
    double derivByParamImp(const Arg & x, const std::string & paramName) const;
 
+   double derivByParamIndexImp(const Arg & x, unsigned int paramIndex) const;
+
+   void valuesImp(const double * x, double * out, size_t n) const;
+
+   void derivsImp(const double * x, double * out, size_t n,
+                  bool getFree) const;
+
+private:
+
+   /// Scratch space for derivsImp.
+   mutable std::vector<double> m_powers;
+
 };
 
 } // namespace optimizers
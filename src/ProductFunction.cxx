@@ -24,28 +24,63 @@ ProductFunction::ProductFunction(Function & a, Function & b)
 
 void ProductFunction::fetchDerivs(const Arg & x, std::vector<double> &derivs, 
                                   bool getFree) const {
+   if (getFree) {
+      m_a->getFreeDerivs(x, derivs);
+   } else {
+      m_a->getDerivs(x, derivs);
+   }
    if (!derivs.empty()) {
-      derivs.clear();
+      double b_value(m_b->operator()(x));
+      for (unsigned int i = 0; i < derivs.size(); i++) {
+         derivs[i] *= b_value;
+      }
    }
 
-   std::vector<double> my_derivs;
    if (getFree) {
-      m_a->getFreeDerivs(x, my_derivs);
+      m_b->getFreeDerivs(x, m_derivs);
    } else {
-      m_a->getDerivs(x, my_derivs);
+      m_b->getDerivs(x, m_derivs);
    }
-   for (unsigned int i = 0; i < my_derivs.size(); i++) {
-      derivs.push_back(my_derivs[i]*m_b->operator()(x));
+   if (!m_derivs.empty()) {
+      double a_value(m_a->operator()(x));
+      for (unsigned int i = 0; i < m_derivs.size(); i++) {
+         derivs.push_back(m_derivs[i]*a_value);
+      }
    }
+}
 
+double ProductFunction::fetchValueAndDerivs(const Arg & x,
+                                            std::vector<double> & derivs,
+                                            bool getFree) const {
+   double a_value, b_value;
    if (getFree) {
-      m_b->getFreeDerivs(x, my_derivs);
+      a_value = m_a->getValueAndFreeDerivs(x, derivs);
+      b_value = m_b->getValueAndFreeDerivs(x, m_derivs);
    } else {
-      m_b->getDerivs(x, my_derivs);
+      a_value = m_a->getValueAndDerivs(x, derivs);
+      b_value = m_b->getValueAndDerivs(x, m_derivs);
+   }
+   for (unsigned int i = 0; i < derivs.size(); i++) {
+      derivs[i] *= b_value;
    }
-   for (unsigned int i = 0; i < my_derivs.size(); i++) {
-      derivs.push_back(my_derivs[i]*m_a->operator()(x));
+   for (unsigned int i = 0; i < m_derivs.size(); i++) {
+      derivs.push_back(m_derivs[i]*a_value);
+   }
+
+   double my_value(a_value*b_value);
+   if (scalingFunction()) {
+      my_value *= scalingFunction()->operator()(x);
+   }
+   return my_value;
+}
+
+double ProductFunction::derivByParamIndexImp(const Arg & x,
+                                             unsigned int paramIndex) const {
+   unsigned int na(m_a->getNumParams());
+   if (paramIndex < na) {
+      return m_a->derivByParamIndex(x, paramIndex)*m_b->operator()(x);
    }
+   return m_b->derivByParamIndex(x, paramIndex - na)*m_a->operator()(x);
 }
 
 } // namespace optimizers
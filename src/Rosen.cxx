@@ -8,6 +8,7 @@
 
 #include <cmath>
 
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -30,20 +31,28 @@ double Rosen::value(const Arg &) const {
    return -(m_prefactor*pow((y - x*x), 2) + pow((1 - x), 2));
 }
 
-double Rosen::derivByParamImp(const Arg &, 
+double Rosen::derivByParamImp(const Arg & xarg, 
                               const std::string & paramName) const {
-   std::vector<double> params;
-   getParamValues(params);
+   if (paramName != "x" && paramName != "y") {
+      throw ParameterNotFound(paramName, getName(), "Rosen::derivByParam");
+   }
+   return derivByParamIndexImp(xarg, parameterIndex(paramName));
+}
 
-   double x = params[0];
-   double y = params[1];
+double Rosen::derivByParamIndexImp(const Arg &, 
+                                   unsigned int paramIndex) const {
+   double x = m_parameter[0].getValue();
+   double y = m_parameter[1].getValue();
 
-   if (paramName == "x") {
+   if (paramIndex == 0) {
       return -(-4.*m_prefactor*(y - x*x)*x - 2.*(1. - x));
-   } else if (paramName == "y") {
+   } else if (paramIndex == 1) {
       return -2.*m_prefactor*(y - x*x);
    }
-   throw ParameterNotFound(paramName, getName(), "Rosen::derivByParam");
+   std::ostringstream paramName;
+   paramName << "with index " << paramIndex;
+   throw ParameterNotFound(paramName.str(), getName(),
+                           "Rosen::derivByParamIndex");
 }
 
 } // namespace optimizers
@@ -44,6 +44,9 @@ protected:
    virtual double derivByParamImp(const Arg &,
                                   const std::string & paramName) const;
 
+   virtual double derivByParamIndexImp(const Arg &,
+                                       unsigned int paramIndex) const;
+
 private:
 
    double m_prefactor;
@@ -8,6 +8,7 @@
 
 #include <cmath>
 
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -33,22 +34,31 @@ double RosenBounded::value(const Arg &) const {
    return -(m_prefactor*pow((y - x*x), 2) + pow((1 - x), 2));
 }
 
-double RosenBounded::derivByParamImp(const Arg &, 
+double RosenBounded::derivByParamImp(const Arg & xarg, 
                                      const std::string & paramName) const {
-   std::vector<double> params;
-   getParamValues(params);
+   if (paramName != "x" && paramName != "y") {
+      throw ParameterNotFound(paramName, getName(),
+                              "RosenBounded::derivByParam");
+   }
+   return derivByParamIndexImp(xarg, parameterIndex(paramName));
+}
 
-   double x = params[0];
-   double y = params[1];
+double RosenBounded::derivByParamIndexImp(const Arg &, 
+                                          unsigned int paramIndex) const {
+   double x = m_parameter[0].getValue();
+   double y = m_parameter[1].getValue();
 
    check_bounds(x, y);
 
-   if (paramName == "x") {
+   if (paramIndex == 0) {
       return -(-4.*m_prefactor*(y - x*x)*x - 2.*(1. - x));
-   } else if (paramName == "y") {
+   } else if (paramIndex == 1) {
       return -2.*m_prefactor*(y - x*x);
    }
-   throw ParameterNotFound(paramName, getName(), "RosenBounded::derivByParam");
+   std::ostringstream paramName;
+   paramName << "with index " << paramIndex;
+   throw ParameterNotFound(paramName.str(), getName(),
+                           "RosenBounded::derivByParamIndex");
 }
 
 void RosenBounded::set_xbounds(double xmin, double xmax) {
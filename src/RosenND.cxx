@@ -8,6 +8,7 @@
 
 #include <cmath>
 
+#include <algorithm>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -37,33 +38,86 @@ double RosenND::value(const Arg &) const {
    return -my_value;
 }
 
-double RosenND::derivByParamImp(const Arg &, 
-                                const std::string & paramName) const {
-   std::vector<Parameter> params;
-   getParams(params);
+void RosenND::valueAndFreeDerivs(const std::vector<double> & x,
+                                 double & f, std::vector<double> & g) {
+   setFreeParamValues(x);
+
+// Accumulate each term of the sum and its contributions to the
+// gradient in a single pass over the parameters.
+   std::vector<double> & derivs(m_derivs);
+   derivs.assign(m_dim, 0);
+   double my_value = 0;
+   for (int i = 1; i < m_dim; i++) {
+      double xx = m_parameter[i-1].getTrueValue();
+      double yy = m_parameter[i].getTrueValue();
+      double resid = yy - xx*xx;
+      my_value += m_prefactor*resid*resid + (1. - xx)*(1. - xx);
+      derivs[i-1] += -4.*m_prefactor*resid*xx - 2.*(1. - xx);
+      derivs[i] += 2.*m_prefactor*resid;
+   }
+   f = -my_value;
 
-   for (unsigned int i = 0; i < params.size(); i++) {
-      if (params[i].getName() == paramName) {
-         if (i > 0 && i < params.size()-1) {
-            double x = params[i-1].getTrueValue();
-            double y = params[i].getTrueValue();
-            double z = params[i+1].getTrueValue();
-            return -( 2.*m_prefactor*(y - x*x) 
-                      - 4.*m_prefactor*(z - y*y)*y 
-                      - 2.*(1. - y) );
-         } else if (i == 0) {
-            double y = params[i].getTrueValue();
-            double z = params[i+1].getTrueValue();
-            return -( - 4.*m_prefactor*(z - y*y)*y 
-                      - 2.*(1. - y) );
-         } else if (i == params.size()-1) {
-            double x = params[i-1].getTrueValue();
-            double y = params[i].getTrueValue();
-            return -( 2.*m_prefactor*(y - x*x) );
+   g.clear();
+   for (int i = 0; i < m_dim; i++) {
+      if (m_parameter[i].isFree()) {
+         g.push_back(-derivs[i]);
+      }
+   }
+}
+
+bool RosenND::getFreeHessianPattern(
+   std::vector< std::vector<size_t> > & pattern) const {
+// Index the free parameters, then couple each one to its free
+// neighbors.
+   std::vector<int> freeIndex(m_dim, -1);
+   size_t nfree(0);
+   for (int i = 0; i < m_dim; i++) {
+      if (m_parameter[i].isFree()) {
+         freeIndex[i] = nfree++;
+      }
+   }
+   pattern.assign(nfree, std::vector<size_t>());
+   for (int i = 0; i < m_dim; i++) {
+      if (freeIndex[i] < 0) {
+         continue;
+      }
+      for (int j = std::max(i - 1, 0); j <= std::min(i + 1, m_dim - 1); j++) {
+         if (freeIndex[j] >= 0) {
+            pattern[freeIndex[i]].push_back(freeIndex[j]);
          }
       }
    }
-   throw ParameterNotFound(paramName, getName(), "RosenND::derivByParam");
+   return true;
+}
+
+double RosenND::derivByParamImp(const Arg & xarg, 
+                                const std::string & paramName) const {
+   return derivByParamIndexImp(xarg, parameterIndex(paramName));
+}
+
+double RosenND::derivByParamIndexImp(const Arg &, unsigned int i) const {
+   const std::vector<Parameter> & params(m_parameter);
+   if (i > 0 && i < params.size()-1) {
+      double x = params[i-1].getTrueValue();
+      double y = params[i].getTrueValue();
+      double z = params[i+1].getTrueValue();
+      return -( 2.*m_prefactor*(y - x*x) 
+                - 4.*m_prefactor*(z - y*y)*y 
+                - 2.*(1. - y) );
+   } else if (i == 0) {
+      double y = params[i].getTrueValue();
+      double z = params[i+1].getTrueValue();
+      return -( - 4.*m_prefactor*(z - y*y)*y 
+                - 2.*(1. - y) );
+   } else if (i == params.size()-1) {
+      double x = params[i-1].getTrueValue();
+      double y = params[i].getTrueValue();
+      return -( 2.*m_prefactor*(y - x*x) );
+   }
+   std::ostringstream paramName;
+   paramName << "with index " << i;
+   throw ParameterNotFound(paramName.str(), getName(),
+                           "RosenND::derivByParamIndex");
 }
 
 } // namespace optimizers
@@ -32,6 +32,13 @@ public:
       Function::getFreeDerivs(dummy, derivs);
    }
 
+   virtual void valueAndFreeDerivs(const std::vector<double> & x,
+                                   double & f, std::vector<double> & g);
+
+   /// The Hessian is tridiagonal.
+   virtual bool getFreeHessianPattern(
+      std::vector< std::vector<size_t> > & pattern) const;
+
 protected:
 
    virtual double value(const Arg &) const;
@@ -39,6 +46,9 @@ protected:
    virtual double derivByParamImp(const Arg &,
                                   const std::string &paramName) const;
 
+   virtual double derivByParamIndexImp(const Arg &,
+                                       unsigned int paramIndex) const;
+
    virtual Function * clone() const {
       return new RosenND(*this);
    }
@@ -49,6 +59,8 @@ private:
 
    double m_prefactor;
 
+   /// Scratch space for valueAndFreeDerivs.
+   std::vector<double> m_derivs;
 
 };
 
@@ -0,0 +1,81 @@
+/**
+ * @file SampleBuffer.cxx
+ * @brief Implementation of column-major sample storage.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#include <algorithm>
+
+#include "optimizers/Exception.h"
+#include "optimizers/SampleBuffer.h"
+
+namespace optimizers {
+
+void SampleBuffer::setNcols(size_t ncols) {
+   m_ncols = ncols;
+   m_size = 0;
+   m_data.assign(m_ncols*m_capacity, 0);
+}
+
+void SampleBuffer::reserve(size_t capacity) {
+   if (capacity <= m_capacity) {
+      return;
+   }
+// Columns are relocated to their offsets within the larger block.
+   std::vector<double> data(m_ncols*capacity, 0);
+   for (size_t j = 0; j < m_ncols; j++) {
+      std::copy(m_data.begin() + j*m_capacity, 
+                m_data.begin() + j*m_capacity + m_size,
+                data.begin() + j*capacity);
+   }
+   m_data.swap(data);
+   m_capacity = capacity;
+}
+
+void SampleBuffer::resize(size_t size) {
+   reserve(size);
+   for (size_t j = 0; j < m_ncols; j++) {
+      for (size_t i = m_size; i < size; i++) {
+         m_data[j*m_capacity + i] = 0;
+      }
+   }
+   m_size = size;
+}
+
+void SampleBuffer::getSample(size_t i, std::vector<double> & row) const {
+   row.resize(m_ncols);
+   for (size_t j = 0; j < m_ncols; j++) {
+      row[j] = m_data[j*m_capacity + i];
+   }
+}
+
+void SampleBuffer::write(const std::vector<double> & sample) {
+   if (m_ncols == 0 && m_size == 0) {
+      setNcols(sample.size());
+   }
+   if (sample.size() != m_ncols) {
+      throw Exception("SampleBuffer::write: sample size does not match "
+                      "the number of columns.");
+   }
+   if (m_size == m_capacity) {
+      reserve(std::max<size_t>(2*m_capacity, 1024));
+   }
+   for (size_t j = 0; j < m_ncols; j++) {
+      m_data[j*m_capacity + m_size] = sample[j];
+   }
+   m_size++;
+}
+
+void SampleBuffer::appendTo(std::vector< std::vector<double> > & samples)
+   const {
+   samples.reserve(samples.size() + m_size);
+   std::vector<double> row;
+   for (size_t i = 0; i < m_size; i++) {
+      getSample(i, row);
+      samples.push_back(row);
+   }
+}
+
+} // namespace optimizers
@@ -0,0 +1,162 @@
+/**
+ * @file Simplex.cxx
+ * @brief Implementation of the Nelder-Mead simplex Optimizer.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#include <cmath>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+#include "optimizers/Amoeba.h"
+#include "optimizers/Simplex.h"
+
+#include "Parallel.h"
+
+namespace {
+   using optimizers::Statistic;
+
+/// Maps the free parameters onto Amoeba's unbounded internal
+/// variables and back.
+   class BoundsTransform {
+   public:
+      BoundsTransform(const std::vector<optimizers::Parameter> & params)
+         : m_lower(params.size()), m_upper(params.size()) {
+         for (size_t i = 0; i < params.size(); i++) {
+            m_lower[i] = params[i].effectiveBounds().first;
+            m_upper[i] = params[i].effectiveBounds().second;
+         }
+      }
+      void toInternal(const std::vector<double> & x,
+                      std::vector<double> & u) const {
+         u.resize(x.size());
+         for (size_t i = 0; i < x.size(); i++) {
+            bool lower(!std::isinf(m_lower[i]));
+            bool upper(!std::isinf(m_upper[i]));
+            if (lower && upper) {
+               double s(2.*(x[i] - m_lower[i])/(m_upper[i] - m_lower[i]) - 1.);
+               u[i] = std::asin(std::max(-1., std::min(s, 1.)));
+            } else if (lower) {
+               double d(std::max(x[i] - m_lower[i], 0.) + 1.);
+               u[i] = std::sqrt(d*d - 1.);
+            } else if (upper) {
+               double d(std::max(m_upper[i] - x[i], 0.) + 1.);
+               u[i] = std::sqrt(d*d - 1.);
+            } else {
+               u[i] = x[i];
+            }
+         }
+      }
+      void toExternal(const std::vector<double> & u,
+                      std::vector<double> & x) const {
+         x.resize(u.size());
+         for (size_t i = 0; i < u.size(); i++) {
+            bool lower(!std::isinf(m_lower[i]));
+            bool upper(!std::isinf(m_upper[i]));
+            if (lower && upper) {
+               x[i] = m_lower[i]
+                  + (m_upper[i] - m_lower[i])*(std::sin(u[i]) + 1.)/2.;
+            } else if (lower) {
+               x[i] = m_lower[i] - 1. + std::sqrt(u[i]*u[i] + 1.);
+            } else if (upper) {
+               x[i] = m_upper[i] + 1. - std::sqrt(u[i]*u[i] + 1.);
+            } else {
+               x[i] = u[i];
+            }
+// Guard against rounding just outside of the bounds.
+            x[i] = std::max(m_lower[i], std::min(x[i], m_upper[i]));
+         }
+      }
+   private:
+      std::vector<double> m_lower;
+      std::vector<double> m_upper;
+   };
+
+/// The negative of the Statistic, as a function of the internal
+/// variables, for Amoeba to minimize.
+   class StatFunctor : public optimizers::Functor {
+   public:
+      StatFunctor(Statistic & stat, const BoundsTransform & transform)
+         : m_stat(stat), m_transform(transform) {}
+      virtual double operator()(std::vector<double> & u) {
+         m_transform.toExternal(u, m_x);
+         m_stat.setFreeParamValues(m_x);
+         return -m_stat.value();
+      }
+      virtual optimizers::Functor * clone() const {
+         std::vector< std::unique_ptr<Statistic> > stats;
+         optimizers::cloneStatistics(m_stat, 1, stats);
+         return new StatFunctor(stats[0].release(), m_transform);
+      }
+   private:
+      Statistic & m_stat;
+      std::unique_ptr<Statistic> m_owned;
+      const BoundsTransform & m_transform;
+      std::vector<double> m_x;
+      StatFunctor(Statistic * stat, const BoundsTransform & transform)
+         : m_stat(*stat), m_owned(stat), m_transform(transform) {}
+   };
+}
+
+namespace optimizers {
+
+int Simplex::find_min(int verbose, double tol, int tolType) {
+   clearEvaluationCache();
+   Instrumentation::Timer timer(instruments(), Instrumentation::FIND_MIN);
+   beginIterations();
+   const double noValue = std::numeric_limits<double>::quiet_NaN();
+
+   std::vector<Parameter> params;
+   m_stat->getFreeParams(params);
+   BoundsTransform transform(params);
+   std::vector<double> x, u;
+   m_stat->getFreeParamValues(x);
+   if (observer() != 0) {
+      notifyIteration(x, m_stat->value(), noValue, noValue);
+   }
+   transform.toInternal(x, u);
+
+   StatFunctor functor(*m_stat, transform);
+   Amoeba amoeba(functor, u, m_step);
+   amoeba.setMaxEval(m_maxEval);
+   amoeba.setThreads(m_nthreads);
+   try {
+      m_value = -amoeba.findMin(u, tol, tolType == ABSOLUTE);
+      setRetCode(SIMPLEX_NORMAL);
+   } catch (std::runtime_error &) {
+      if (amoeba.numEvals() < m_maxEval) {
+         throw;
+      }
+// Leave the Statistic at the best point found.
+      m_value = -amoeba.bestVertex(u);
+      setRetCode(SIMPLEX_TOOMANY);
+   }
+   m_numEvals = amoeba.numEvals();
+
+   transform.toExternal(u, x);
+   m_stat->setFreeParamValues(x);
+   notifyIteration(x, m_value, noValue, noValue);
+   if (verbose > 0) {
+      put(std::cout);
+   }
+   return getRetCode();
+}
+
+std::ostream & Simplex::put(std::ostream & s) const {
+   s << "Simplex performed " << m_numEvals << " function evaluations"
+     << std::endl;
+   s << "and produced a final value of " << m_value;
+   if (getRetCode() == SIMPLEX_TOOMANY) {
+      s << " before exceeding the maximum number of evaluations";
+   }
+   s << std::endl;
+   return s;
+}
+
+} // namespace optimizers
@@ -0,0 +1,373 @@
+/**
+ * @file SparseHessian.cxx
+ * @brief Implementation of SparseHessian.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#include <cmath>
+
+#include <algorithm>
+#include <sstream>
+
+#include "optimizers/Exception.h"
+#include "optimizers/SparseHessian.h"
+
+namespace {
+   typedef std::vector< std::vector<size_t> > Graph;
+
+/// Breadth-first search from root over the nodes that are not yet
+/// numbered, taking the neighbors of each node in order of increasing
+/// degree.  Appends the nodes to order as they are reached and
+/// returns the number of levels; the last level starts at
+/// order[lastLevel].
+   size_t levelStructure(const Graph & adj, size_t root,
+                         const std::vector<bool> & numbered,
+                         std::vector<int> & depth,
+                         std::vector<size_t> & order, size_t & lastLevel) {
+      size_t start(order.size());
+      order.push_back(root);
+      depth[root] = 0;
+      std::vector<size_t> neighbors;
+      for (size_t head = start; head < order.size(); head++) {
+         size_t node(order[head]);
+         neighbors.clear();
+         for (size_t k = 0; k < adj[node].size(); k++) {
+            size_t next(adj[node][k]);
+            if (!numbered[next] && depth[next] < 0) {
+               depth[next] = depth[node] + 1;
+               neighbors.push_back(next);
+            }
+         }
+         for (size_t k = 1; k < neighbors.size(); k++) {
+            size_t next(neighbors[k]);
+            size_t m(k);
+            for ( ; m > 0 && adj[neighbors[m-1]].size() > adj[next].size();
+                  m--) {
+               neighbors[m] = neighbors[m-1];
+            }
+            neighbors[m] = next;
+         }
+         order.insert(order.end(), neighbors.begin(), neighbors.end());
+      }
+      int maxDepth(depth[order.back()]);
+      lastLevel = order.size() - 1;
+      while (lastLevel > start && depth[order[lastLevel-1]] == maxDepth) {
+         lastLevel--;
+      }
+// Clear the depths for the next search.
+      for (size_t i = start; i < order.size(); i++) {
+         depth[order[i]] = -1;
+      }
+      return maxDepth + 1;
+   }
+
+   double dot(const double * x, const double * y, size_t n) {
+      double sum(0);
+      for (size_t i = 0; i < n; i++) {
+         sum += x[i]*y[i];
+      }
+      return sum;
+   }
+}
+
+namespace optimizers {
+
+SparseHessian::SparseHessian(const std::vector< std::vector<size_t> > & pattern)
+   : m_adj(pattern.size()), m_est(pattern.size()), m_factored(false) {
+   size_t npars(pattern.size());
+   for (size_t i = 0; i < npars; i++) {
+      m_adj[i].push_back(i);
+      for (size_t k = 0; k < pattern[i].size(); k++) {
+         size_t j(pattern[i][k]);
+         if (j >= npars) {
+            throw Exception("SparseHessian: pattern index out of range", j);
+         }
+         m_adj[i].push_back(j);
+         m_adj[j].push_back(i);
+      }
+   }
+   for (size_t i = 0; i < npars; i++) {
+      std::sort(m_adj[i].begin(), m_adj[i].end());
+      m_adj[i].erase(std::unique(m_adj[i].begin(), m_adj[i].end()),
+                     m_adj[i].end());
+      m_est[i].resize(m_adj[i].size(), 0);
+   }
+   colorColumns();
+   order();
+}
+
+size_t SparseHessian::nonZeros() const {
+   size_t nnz(0);
+   for (size_t i = 0; i < m_adj.size(); i++) {
+      nnz += m_adj[i].size();
+   }
+   return nnz;
+}
+
+void SparseHessian::colorColumns() {
+// Greedy coloring of the columns, largest degree first.  A column
+// may not share a color with any column that has a nonzero in one
+// of its rows.
+   size_t npars(m_adj.size());
+   std::vector<size_t> columns(npars);
+   for (size_t j = 0; j < npars; j++) {
+      columns[j] = j;
+   }
+   std::stable_sort(columns.begin(), columns.end(),
+                    [this](size_t a, size_t b) {
+                       return m_adj[a].size() > m_adj[b].size();
+                    });
+   std::vector<int> color(npars, -1);
+   std::vector<size_t> forbidden(npars + 1, npars);
+   m_groups.clear();
+   for (size_t jj = 0; jj < npars; jj++) {
+      size_t j(columns[jj]);
+      for (size_t k = 0; k < m_adj[j].size(); k++) {
+         const std::vector<size_t> & row(m_adj[m_adj[j][k]]);
+         for (size_t m = 0; m < row.size(); m++) {
+            if (color[row[m]] >= 0) {
+               forbidden[color[row[m]]] = j;
+            }
+         }
+      }
+      size_t c(0);
+      while (forbidden[c] == j) {
+         c++;
+      }
+      color[j] = c;
+      if (c == m_groups.size()) {
+         m_groups.push_back(std::vector<size_t>());
+      }
+      m_groups[c].push_back(j);
+   }
+   for (size_t c = 0; c < m_groups.size(); c++) {
+      std::sort(m_groups[c].begin(), m_groups[c].end());
+   }
+}
+
+void SparseHessian::order() {
+// Reverse Cuthill-McKee, starting each connected component from a
+// pseudo-peripheral node found as in George & Liu 1979, ACM TOMS,
+// 5, 284.
+   size_t npars(m_adj.size());
+   std::vector<bool> numbered(npars, false);
+   std::vector<int> depth(npars, -1);
+   std::vector<size_t> rcm;
+   std::vector<size_t> levels;
+   rcm.reserve(npars);
+   for (size_t seed = 0; seed < npars; seed++) {
+      if (numbered[seed]) {
+         continue;
+      }
+      size_t root(seed);
+      size_t lastLevel;
+      levels.clear();
+      size_t nlevels(levelStructure(m_adj, root, numbered, depth, levels,
+                                    lastLevel));
+      while (true) {
+         size_t candidate(levels[lastLevel]);
+         for (size_t k = lastLevel + 1; k < levels.size(); k++) {
+            if (m_adj[levels[k]].size() < m_adj[candidate].size()) {
+               candidate = levels[k];
+            }
+         }
+         std::vector<size_t> trial;
+         size_t trialLast;
+         size_t ntrial(levelStructure(m_adj, candidate, numbered, depth,
+                                      trial, trialLast));
+         if (ntrial <= nlevels) {
+            break;
+         }
+         root = candidate;
+         nlevels = ntrial;
+         levels.swap(trial);
+         lastLevel = trialLast;
+      }
+      levels.clear();
+      levelStructure(m_adj, root, numbered, depth, levels, lastLevel);
+      for (size_t k = 0; k < levels.size(); k++) {
+         numbered[levels[k]] = true;
+      }
+      rcm.insert(rcm.end(), levels.begin(), levels.end());
+   }
+   std::reverse(rcm.begin(), rcm.end());
+
+   std::vector<size_t> natural(npars);
+   std::vector<size_t> inverse(npars);
+   for (size_t i = 0; i < npars; i++) {
+      natural[i] = i;
+      inverse[rcm[i]] = i;
+   }
+   if (envelope(inverse) < envelope(natural)) {
+      m_perm = rcm;
+      m_iperm = inverse;
+   } else {
+      m_perm = natural;
+      m_iperm = natural;
+   }
+}
+
+size_t SparseHessian::envelope(const std::vector<size_t> & iperm) const {
+   size_t size(0);
+   for (size_t i = 0; i < m_adj.size(); i++) {
+      size_t first(iperm[i]);
+      for (size_t k = 0; k < m_adj[i].size(); k++) {
+         first = std::min(first, iperm[m_adj[i][k]]);
+      }
+      size += iperm[i] - first + 1;
+   }
+   return size;
+}
+
+void SparseHessian::setGroup(size_t igroup, const std::vector<double> & diff,
+                             const std::vector<double> & steps) {
+   const std::vector<size_t> & columns(m_groups.at(igroup));
+   for (size_t jj = 0; jj < columns.size(); jj++) {
+      size_t j(columns[jj]);
+      for (size_t k = 0; k < m_adj[j].size(); k++) {
+         m_est[j][k] = diff[m_adj[j][k]]/steps[j];
+      }
+   }
+}
+
+double SparseHessian::operator()(size_t i, size_t j) const {
+   const std::vector<size_t> & row(m_adj.at(i));
+   std::vector<size_t>::const_iterator it
+      = std::lower_bound(row.begin(), row.end(), j);
+   if (it == row.end() || *it != j) {
+      return 0;
+   }
+   const std::vector<size_t> & column(m_adj.at(j));
+   size_t ki(it - row.begin());
+   size_t kj(std::lower_bound(column.begin(), column.end(), i)
+             - column.begin());
+   return (m_est[i][ki] + m_est[j][kj])/2.;
+}
+
+void SparseHessian::choleskyDecompose() {
+// Row-oriented factorization within the envelope: row i of L is
+// nonzero only from column m_first[i], so each element is a single
+// contiguous dot product over the overlap of two rows.
+   size_t npars(m_adj.size());
+   m_first.resize(npars);
+   m_rowStart.resize(npars + 1);
+   m_rowStart[0] = 0;
+   for (size_t p = 0; p < npars; p++) {
+      const std::vector<size_t> & row(m_adj[m_perm[p]]);
+      m_first[p] = p;
+      for (size_t k = 0; k < row.size(); k++) {
+         m_first[p] = std::min(m_first[p], m_iperm[row[k]]);
+      }
+      m_rowStart[p+1] = m_rowStart[p] + p - m_first[p] + 1;
+   }
+   m_env.assign(m_rowStart[npars], 0);
+   for (size_t p = 0; p < npars; p++) {
+      size_t i(m_perm[p]);
+      for (size_t k = 0; k < m_adj[i].size(); k++) {
+         size_t q(m_iperm[m_adj[i][k]]);
+         if (q <= p) {
+            env(p, q) = (*this)(i, m_adj[i][k]);
+         }
+      }
+   }
+
+   for (size_t i = 0; i < npars; i++) {
+      for (size_t j = m_first[i]; j <= i; j++) {
+         size_t k0(std::max(m_first[i], m_first[j]));
+         double sum(env(i, j));
+         if (k0 < j) {
+            sum -= dot(&env(i, k0), &env(j, k0), j - k0);
+         }
+         if (j < i) {
+            env(i, j) = sum/env(j, j);
+         } else {
+            if (sum <= 0) {
+               std::ostringstream errorMessage;
+               errorMessage << "SparseHessian::choleskyDecompose:\n"
+                            << "Imaginary diagonal element.\n"
+                            << "Element value squared = " << sum << "\n";
+               throw Exception(errorMessage.str());
+            }
+            env(i, i) = std::sqrt(sum);
+         }
+      }
+   }
+   m_factored = true;
+}
+
+void SparseHessian::solve(std::vector<double> & b) const {
+   if (!m_factored) {
+      throw Exception("SparseHessian::solve: matrix is not factored");
+   }
+   size_t npars(m_adj.size());
+   std::vector<double> y(npars);
+   for (size_t p = 0; p < npars; p++) {
+      y[p] = b.at(m_perm[p]);
+   }
+// L y' = y
+   for (size_t p = 0; p < npars; p++) {
+      size_t k0(m_first[p]);
+      y[p] = (y[p] - dot(&env(p, k0), &y[k0], p - k0))/env(p, p);
+   }
+// L^T x = y'
+   for (size_t p = npars; p-- > 0; ) {
+      y[p] /= env(p, p);
+      for (size_t k = m_first[p]; k < p; k++) {
+         y[k] -= env(p, k)*y[p];
+      }
+   }
+   for (size_t p = 0; p < npars; p++) {
+      b[m_perm[p]] = y[p];
+   }
+}
+
+void SparseHessian::inverseDiagonal(std::vector<double> & diag) const {
+   if (!m_factored) {
+      throw Exception("SparseHessian::inverseDiagonal: "
+                      "matrix is not factored");
+   }
+// With Z = A^{-1} = L^{-T} L^{-1}, L^T Z is the lower triangular
+// L^{-1}, so for j >= i,
+//
+//    Z_ij = (delta_ij/L_ii - sum_{k > i} L_ki Z_kj)/L_ii.
+//
+// Working up from the last row, the Z_kj needed lie within the
+// envelope of L, so Z is computed only there.
+   size_t npars(m_adj.size());
+   std::vector< std::vector<size_t> > below(npars);
+   for (size_t k = 0; k < npars; k++) {
+      for (size_t i = m_first[k]; i < k; i++) {
+         below[i].push_back(k);
+      }
+   }
+   std::vector<double> z(m_env.size(), 0);
+   for (size_t i = npars; i-- > 0; ) {
+      const std::vector<size_t> & rows(below[i]);
+      double lii(env(i, i));
+      for (size_t jj = rows.size(); jj-- > 0; ) {
+         size_t j(rows[jj]);
+         double sum(0);
+         for (size_t kk = 0; kk < rows.size(); kk++) {
+            size_t k(rows[kk]);
+            size_t hi(std::max(k, j));
+            size_t lo(std::min(k, j));
+            sum += env(k, i)*z[m_rowStart[hi] + lo - m_first[hi]];
+         }
+         z[m_rowStart[j] + i - m_first[j]] = -sum/lii;
+      }
+      double sum(0);
+      for (size_t kk = 0; kk < rows.size(); kk++) {
+         size_t k(rows[kk]);
+         sum += env(k, i)*z[m_rowStart[k] + i - m_first[k]];
+      }
+      z[m_rowStart[i] + i - m_first[i]] = (1./lii - sum)/lii;
+   }
+   diag.resize(npars);
+   for (size_t p = 0; p < npars; p++) {
+      diag[m_perm[p]] = z[m_rowStart[p] + p - m_first[p]];
+   }
+}
+
+} // namespace optimizers
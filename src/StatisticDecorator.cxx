@@ -0,0 +1,115 @@
+/**
+ * @file StatisticDecorator.cxx
+ * @brief Implementation of the base class for wrapping Statistics
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#include "optimizers/Exception.h"
+#include "optimizers/StatisticDecorator.h"
+
+namespace optimizers {
+
+StatisticDecorator::StatisticDecorator(const std::string & genericName,
+                                       Statistic & stat)
+   : Statistic(genericName, stat.getNumParams()), m_stat(&stat),
+     m_own_stat(false) {
+   setName(stat.getName());
+   m_stat->getParams(m_parameter);
+}
+
+StatisticDecorator::StatisticDecorator(const StatisticDecorator & rhs)
+   : Statistic(rhs), m_stat(0), m_own_stat(true) {
+   Function * stat(rhs.m_stat->clone());
+   m_stat = dynamic_cast<Statistic *>(stat);
+   if (m_stat == 0) {
+      delete stat;
+      throw Exception(rhs.genericName() + ": clone of the wrapped "
+                      "Statistic is not a Statistic.");
+   }
+}
+
+StatisticDecorator::~StatisticDecorator() {
+   if (m_own_stat) {
+      delete m_stat;
+   }
+}
+
+const Statistic & StatisticDecorator::innermost() const {
+   const Statistic * stat(m_stat);
+   const StatisticDecorator * decorator;
+   while ((decorator = dynamic_cast<const StatisticDecorator *>(stat)) != 0) {
+      stat = decorator->m_stat;
+   }
+   return *stat;
+}
+
+void StatisticDecorator::setParam(const std::string & paramName,
+                                  double paramValue) {
+   m_stat->setParam(paramName, paramValue);
+   paramsChanged();
+}
+
+void StatisticDecorator::setParam(const Parameter & param) {
+   m_stat->setParam(param);
+   paramsChanged();
+}
+
+std::vector<double>::const_iterator StatisticDecorator::setParamValues_(
+   std::vector<double>::const_iterator it) {
+   it = m_stat->setParamValues_(it);
+   paramsChanged();
+   return it;
+}
+
+std::vector<double>::const_iterator StatisticDecorator::setFreeParamValues_(
+   std::vector<double>::const_iterator it) {
+   it = m_stat->setFreeParamValues_(it);
+// Only the values have changed, so just those are copied, leaving
+// the names and the rest of each Parameter as they are.
+   const std::vector<Parameter> & params(m_stat->parameters());
+   for (size_t i = 0; i < params.size(); i++) {
+      m_parameter[i].setValue(params[i].getValue());
+   }
+   return it;
+}
+
+void StatisticDecorator::setParams(const std::vector<Parameter> & params) {
+   m_stat->setParams(params);
+   paramsChanged();
+}
+
+void StatisticDecorator::paramsChanged() {
+   m_stat->getParams(m_parameter);
+}
+
+void StatisticDecorator::fetchParamValues(std::vector<double> & values,
+                                          bool getFree) const {
+   if (getFree) {
+      m_stat->getFreeParamValues(values);
+   } else {
+      m_stat->getParamValues(values);
+   }
+}
+
+void StatisticDecorator::fetchDerivs(const Arg & x,
+                                     std::vector<double> & derivs,
+                                     bool getFree) const {
+   if (getFree) {
+      getFreeDerivs(derivs);
+   } else {
+      m_stat->getDerivs(x, derivs);
+   }
+}
+
+double StatisticDecorator::fetchValueAndDerivs(const Arg & x,
+                                               std::vector<double> & derivs,
+                                               bool getFree) const {
+   if (getFree) {
+      return m_stat->getValueAndFreeDerivs(x, derivs);
+   }
+   return m_stat->getValueAndDerivs(x, derivs);
+}
+
+} // namespace optimizers
@@ -22,28 +22,43 @@ SumFunction::SumFunction(Function & a, Function & b)
 
 void SumFunction::fetchDerivs(const Arg & x, std::vector<double> & derivs, 
                               bool getFree) const {
-   if (!derivs.empty()) {
-      derivs.clear();
-   }
-
-   std::vector<double> my_derivs;
    if (getFree) {
-      m_a->getFreeDerivs(x, my_derivs);
+      m_a->getFreeDerivs(x, derivs);
+      m_b->getFreeDerivs(x, m_derivs);
    } else {
-      m_a->getDerivs(x, my_derivs);
-   }
-   for (unsigned int i = 0; i < my_derivs.size(); i++) {
-      derivs.push_back(my_derivs[i]);
+      m_a->getDerivs(x, derivs);
+      m_b->getDerivs(x, m_derivs);
    }
+   derivs.insert(derivs.end(), m_derivs.begin(), m_derivs.end());
+}
 
+double SumFunction::fetchValueAndDerivs(const Arg & x,
+                                        std::vector<double> & derivs,
+                                        bool getFree) const {
+   double a_value, b_value;
    if (getFree) {
-      m_b->getFreeDerivs(x, my_derivs);
+      a_value = m_a->getValueAndFreeDerivs(x, derivs);
+      b_value = m_b->getValueAndFreeDerivs(x, m_derivs);
    } else {
-      m_b->getDerivs(x, my_derivs);
+      a_value = m_a->getValueAndDerivs(x, derivs);
+      b_value = m_b->getValueAndDerivs(x, m_derivs);
    }
-   for (unsigned int i = 0; i < my_derivs.size(); i++) {
-      derivs.push_back(my_derivs[i]);
+   derivs.insert(derivs.end(), m_derivs.begin(), m_derivs.end());
+
+   double my_value(a_value + b_value);
+   if (scalingFunction()) {
+      my_value *= scalingFunction()->operator()(x);
+   }
+   return my_value;
+}
+
+double SumFunction::derivByParamIndexImp(const Arg & x,
+                                         unsigned int paramIndex) const {
+   unsigned int na(m_a->getNumParams());
+   if (paramIndex < na) {
+      return m_a->derivByParamIndex(x, paramIndex);
    }
+   return m_b->derivByParamIndex(x, paramIndex - na);
 }
 
 } // namespace optimizers
@@ -0,0 +1,139 @@
+/**
+ * @file TraceWriter.cxx
+ * @brief Implementation of the binary iteration trace writer.
+ * @author J. Chiang
+ *
+ * $Header$
+ */
+
+#include <cstring>
+
+#include <sstream>
+
+#include "optimizers/Exception.h"
+#include "optimizers/TraceWriter.h"
+
+namespace {
+   const char s_magic[] = "OPTTRACE";
+   const size_t s_magicSize = 8;
+}
+
+namespace optimizers {
+
+TraceWriter::TraceWriter(const std::string & filename, size_t blockSize)
+   : m_filename(filename),
+     m_file(filename.c_str(), std::ios::out | std::ios::binary
+            | std::ios::trunc),
+     m_blockSize(blockSize > 0 ? blockSize : 1), m_npar(-1), m_nrecords(0),
+     m_start(std::chrono::steady_clock::now()) {
+   if (!m_file) {
+      throw Exception("TraceWriter: cannot open " + filename);
+   }
+}
+
+TraceWriter::~TraceWriter() throw() {
+   try {
+      close();
+   } catch (...) {
+   }
+}
+
+void TraceWriter::update(const IterationRecord & record) {
+   if (!m_file.is_open()) {
+      return;
+   }
+   if (m_npar < 0) {
+      writeHeader(record.params.size());
+   } else if (record.params.size() != static_cast<size_t>(m_npar)) {
+      std::ostringstream message;
+      message << "TraceWriter: record has " << record.params.size()
+              << " parameters, but the trace in " << m_filename
+              << " has " << m_npar;
+      throw Exception(message.str());
+   }
+   std::chrono::steady_clock::time_point now(std::chrono::steady_clock::now());
+   if (record.iteration == 0) {
+      m_start = now;
+   }
+   std::chrono::duration<double> elapsed(now - m_start);
+   m_buffer.push_back(record.iteration);
+   m_buffer.push_back(record.value);
+   m_buffer.push_back(record.gradNorm);
+   m_buffer.push_back(record.stepLength);
+   m_buffer.push_back(record.edm);
+   m_buffer.push_back(elapsed.count());
+   m_buffer.insert(m_buffer.end(), record.params.begin(),
+                   record.params.end());
+   m_nrecords++;
+   if (m_buffer.size() >= m_blockSize*(s_nfields + m_npar)) {
+      flush();
+   }
+}
+
+void TraceWriter::flush() {
+   if (!m_file.is_open()) {
+      return;
+   }
+   if (!m_buffer.empty()) {
+      m_file.write(reinterpret_cast<const char *>(&m_buffer[0]),
+                   m_buffer.size()*sizeof(double));
+      m_buffer.clear();
+   }
+   m_file.flush();
+   if (!m_file) {
+      throw Exception("TraceWriter: error writing " + m_filename);
+   }
+}
+
+void TraceWriter::close() {
+   if (!m_file.is_open()) {
+      return;
+   }
+   if (m_npar < 0) {
+// No records: still leave a valid, empty trace.
+      writeHeader(0);
+   }
+   flush();
+   m_file.close();
+}
+
+void TraceWriter::writeHeader(unsigned int npar) {
+   m_npar = npar;
+   unsigned int header[2] = {s_version, npar};
+   m_file.write(s_magic, s_magicSize);
+   m_file.write(reinterpret_cast<const char *>(header), sizeof(header));
+   m_buffer.reserve(m_blockSize*(s_nfields + npar));
+}
+
+void TraceWriter::read(const std::string & filename,
+                       std::vector< std::vector<double> > & records,
+                       unsigned int & npar) {
+   std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+   if (!file) {
+      throw Exception("TraceWriter::read: cannot open " + filename);
+   }
+   char magic[s_magicSize];
+   unsigned int header[2];
+   file.read(magic, s_magicSize);
+   file.read(reinterpret_cast<char *>(header), sizeof(header));
+   if (!file || std::memcmp(magic, s_magic, s_magicSize) != 0) {
+      throw Exception("TraceWriter::read: " + filename
+                      + " is not an optimizer trace file");
+   }
+   if (header[0] != s_version) {
+      throw Exception("TraceWriter::read: unsupported trace version in "
+                      + filename, header[0]);
+   }
+   npar = header[1];
+   records.clear();
+   std::vector<double> record(s_nfields + npar);
+   while (file.read(reinterpret_cast<char *>(&record[0]),
+                    record.size()*sizeof(double))) {
+      records.push_back(record);
+   }
+   if (file.gcount() != 0) {
+      throw Exception("TraceWriter::read: truncated record in " + filename);
+   }
+}
+
+} // namespace optimizers
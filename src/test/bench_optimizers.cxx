@@ -0,0 +1,692 @@
+/**
+ * @file bench_optimizers.cxx
+ * @brief Timing and evaluation-count benchmark of the Optimizer
+ * backends over a suite of RosenND and ChiSq problems.
+ * @author J. Chiang
+ *
+ * Usage:
+ *
+ *   bench_optimizers [--json] [--output file] [--max-dim n]
+ *                    [--max-data n] [--max-eval n] [--tol x]
+ *                    [--optimizers name1,name2,...]
+ *
+ * Each optimizer is run from the same starting point on each
+ * problem.  "Lbfgs:m" runs Lbfgs keeping m variable metric
+ * corrections, e.g., --optimizers Lbfgs:3,Lbfgs:5,Lbfgs:20 shows the
+ * effect of that setting on the high-dimensional problems.  LbfgsB
+ * and "LbfgsB:m" run the C++ L-BFGS-B in the same way, e.g.,
+ * --max-dim 10000 --optimizers Lbfgs,LbfgsB compares it with the f2c
+ * translation up to 10000 dimensions.  For every run the wall time,
+ * the numbers of Statistic value and gradient evaluations, the final
+ * objective value and the estimated distance to the minimum (EDM)
+ * are written as CSV, or as JSON with --json, to the output file
+ * (bench_optimizers.csv or bench_optimizers.json by default).
+ * Results go to a file rather than stdout since Minuit writes its
+ * own output there.
+ *
+ * The EDM, 0.5 g^T H^{-1} g, is computed the same way for every
+ * backend from the gradient at the final point and a
+ * finite-difference Hessian, so that the backends' own convergence
+ * criteria do not enter the comparison.  It is reported as nan (null
+ * in JSON) if the Hessian is not positive definite there, or if
+ * there are more than 1000 parameters.
+ *
+ * $Header$
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "optimizers/Amoeba.h"
+#include "optimizers/ChiSq.h"
+#include "optimizers/Functor.h"
+#include "optimizers/Gaussian.h"
+#include "optimizers/Instrumentation.h"
+#include "optimizers/InstrumentedStatistic.h"
+#include "optimizers/Lbfgs.h"
+#include "optimizers/LbfgsB.h"
+#include "optimizers/Minuit.h"
+#include "optimizers/ModNewton.h"
+#include "optimizers/NewMinuit.h"
+#include "optimizers/Optimizer.h"
+#include "optimizers/OutOfBounds.h"
+#include "optimizers/Parameter.h"
+#include "optimizers/Powell.h"
+#include "optimizers/ProductFunction.h"
+#include "optimizers/Statistic.h"
+#include "optimizers/StatisticDecorator.h"
+#include "optimizers/SumFunction.h"
+#include "optimizers/dArg.h"
+
+#include "AbsEdge.h"
+#include "BrokenPowerLaw.h"
+#include "PowerLaw.h"
+#include "RosenND.h"
+
+using namespace optimizers;
+
+namespace {
+
+/**
+ * @class SignedStatistic
+ *
+ * @brief Forwards to a Statistic with its sign flipped, so that a
+ * ChiSq can be maximized.
+ */
+
+class SignedStatistic : public StatisticDecorator {
+
+public:
+
+   SignedStatistic(Statistic & stat, double sign)
+      : StatisticDecorator("SignedStatistic", stat), m_sign(sign) {}
+
+   virtual double value() const {
+      return m_sign*m_stat->value();
+   }
+
+   virtual void getFreeDerivs(std::vector<double> & derivs) const {
+      m_stat->getFreeDerivs(derivs);
+      scale(derivs);
+   }
+
+   virtual void getFreeDerivs(const Arg &, std::vector<double> & derivs) const {
+      getFreeDerivs(derivs);
+   }
+
+   virtual void valueAndFreeDerivs(const std::vector<double> & x,
+                                   double & f, std::vector<double> & g) {
+      m_stat->valueAndFreeDerivs(x, f, g);
+      f *= m_sign;
+      scale(g);
+   }
+
+   virtual Function * clone() const {
+      return new SignedStatistic(*this);
+   }
+
+protected:
+
+   virtual double value(const Arg &) const {
+      return value();
+   }
+
+   virtual double derivByParamImp(const Arg & x,
+                                  const std::string & paramName) const {
+      return m_sign*m_stat->derivByParam(x, paramName);
+   }
+
+   virtual double derivByParamIndexImp(const Arg & x,
+                                       unsigned int paramIndex) const {
+      return m_sign*m_stat->derivByParamIndex(x, paramIndex);
+   }
+
+   virtual void fetchDerivs(const Arg & x, std::vector<double> & derivs,
+                            bool getFree) const {
+      StatisticDecorator::fetchDerivs(x, derivs, getFree);
+      if (!getFree) {
+         scale(derivs);
+      }
+   }
+
+   virtual double fetchValueAndDerivs(const Arg & x,
+                                      std::vector<double> & derivs,
+                                      bool getFree) const {
+      double value(StatisticDecorator::fetchValueAndDerivs(x, derivs,
+                                                           getFree));
+      scale(derivs);
+      return m_sign*value;
+   }
+
+private:
+
+   double m_sign;
+
+   void scale(std::vector<double> & derivs) const {
+      for (size_t i = 0; i < derivs.size(); i++) {
+         derivs[i] *= m_sign;
+      }
+   }
+
+};
+
+/// Presents a Statistic to Amoeba, which minimizes.
+class AmoebaObjective : public Functor {
+public:
+   AmoebaObjective(Statistic & stat) : m_stat(stat) {}
+   virtual double operator()(std::vector<double> & x) {
+      try {
+         m_stat.setFreeParamValues(x);
+      } catch (OutOfBounds &) {
+         return std::numeric_limits<double>::max()/4.;
+      }
+      return -m_stat.value();
+   }
+private:
+   Statistic & m_stat;
+};
+
+/**
+ * @class Problem
+ *
+ * @brief A Statistic to be maximized, with the starting point that
+ * every optimizer is given.
+ */
+
+class Problem {
+public:
+   virtual ~Problem() {}
+   virtual Statistic & stat() = 0;
+   /// +1 if stat() is a log-likelihood, -1 if it is to be minimized.
+   virtual double sign() const = 0;
+   const std::string & name() const {
+      return m_name;
+   }
+   size_t ndata() const {
+      return m_ndata;
+   }
+   void reset() {
+      stat().setFreeParamValues(m_start);
+   }
+protected:
+   Problem(const std::string & name, size_t ndata)
+      : m_name(name), m_ndata(ndata) {}
+   std::vector<double> m_start;
+private:
+   std::string m_name;
+   size_t m_ndata;
+};
+
+class RosenProblem : public Problem {
+public:
+   RosenProblem(int ndim) : Problem("RosenND", 0), m_rosen(ndim) {
+      std::vector<Parameter> params;
+      m_rosen.getParams(params);
+      for (size_t i = 0; i < params.size(); i++) {
+         params[i].setBounds(-10., 10.);
+      }
+      m_rosen.setParams(params);
+// The customary starting point (-1.2, 1, -1.2, 1, ...).
+      for (int i = 0; i < ndim; i++) {
+         m_start.push_back(i % 2 ? 1. : -1.2);
+      }
+   }
+   virtual Statistic & stat() {
+      return m_rosen;
+   }
+   virtual double sign() const {
+      return 1;
+   }
+private:
+   RosenND m_rosen;
+};
+
+class ChiSqProblem : public Problem {
+public:
+   /// Fit a clone of model to synthetic data generated from it at the
+   /// given abscissae with 2% Gaussian scatter.  The fit starts with
+   /// each free parameter 20% away from its true value.
+   ChiSqProblem(const std::string & name, const Function & model,
+                const std::vector<double> & domain)
+      : Problem(name, domain.size()), m_model(model.clone()),
+        m_domain(domain), m_range(domain.size()) {
+      std::mt19937 engine(19780503);
+      std::normal_distribution<double> scatter(0, 0.02);
+      for (size_t i = 0; i < m_domain.size(); i++) {
+         dArg x(m_domain[i]);
+         m_range[i] = (*m_model)(x)*(1. + scatter(engine));
+      }
+      m_model->getFreeParamValues(m_start);
+      for (size_t i = 0; i < m_start.size(); i++) {
+         m_start[i] *= 1.2;
+      }
+      m_chisq.reset(new ChiSq(m_domain, m_range, m_model.get()));
+   }
+   virtual Statistic & stat() {
+      return *m_chisq;
+   }
+   virtual double sign() const {
+      return -1;
+   }
+private:
+   std::unique_ptr<Function> m_model;
+   std::vector<double> m_domain;
+   std::vector<double> m_range;
+   std::unique_ptr<ChiSq> m_chisq;
+};
+
+/// Keep the model positive during the fit: scale factors may vary
+/// by a factor of 100 and negative indices by a factor of 5 either
+/// way from their true values.
+void setBounds(Function & func) {
+   std::vector<Parameter> params;
+   func.getParams(params);
+   for (size_t i = 0; i < params.size(); i++) {
+      double value(params[i].getValue());
+      if (value > 0) {
+         params[i].setBounds(value/100., value*100.);
+      } else if (value < 0) {
+         params[i].setBounds(value*5., value/5.);
+      }
+   }
+   func.setParams(params);
+}
+
+std::vector<double> logDomain(size_t npts, double xmin, double xmax) {
+   std::vector<double> domain(npts);
+   double xstep(std::log(xmax/xmin)/(npts - 1));
+   for (size_t i = 0; i < npts; i++) {
+      domain[i] = xmin*std::exp(xstep*i);
+   }
+   return domain;
+}
+
+std::vector<double> linearDomain(size_t npts, double xmin, double xmax) {
+   std::vector<double> domain(npts);
+   double xstep((xmax - xmin)/(npts - 1));
+   for (size_t i = 0; i < npts; i++) {
+      domain[i] = xmin + xstep*i;
+   }
+   return domain;
+}
+
+void buildSuite(std::vector<Problem *> & suite, int maxDim, size_t maxData) {
+   int dims[] = {2, 10, 100, 1000, 10000};
+   for (size_t i = 0; i < sizeof(dims)/sizeof(int); i++) {
+      if (dims[i] <= maxDim) {
+         suite.push_back(new RosenProblem(dims[i]));
+      }
+   }
+
+   PowerLaw powerLaw(1000., -2., 1.);
+   setBounds(powerLaw);
+
+   Gaussian gaussian(1000., 5., 1.);
+   setBounds(gaussian);
+
+   BrokenPowerLaw brokenPowerLaw(1000., -1.5, -2.5, 3.);
+   setBounds(brokenPowerLaw);
+
+// A power-law continuum with an emission line, and the same seen
+// through an absorption edge.
+   PowerLaw continuum(1000., -2., 1.);
+   setBounds(continuum);
+   Gaussian line(100., 1., 0.1);
+   setBounds(line);
+   AbsEdge edge(5., 1.2);
+   setBounds(edge);
+   SumFunction spectrum(continuum, line);
+   ProductFunction absorbed(edge, spectrum);
+
+   size_t sizes[] = {100, 1000, 10000, 100000};
+   for (size_t i = 0; i < sizeof(sizes)/sizeof(size_t); i++) {
+      size_t npts(sizes[i]);
+      if (npts > maxData) {
+         continue;
+      }
+      std::vector<double> domain(logDomain(npts, 0.1, 10.));
+      suite.push_back(new ChiSqProblem("ChiSq_PowerLaw", powerLaw, domain));
+      suite.push_back(new ChiSqProblem("ChiSq_BrokenPowerLaw",
+                                       brokenPowerLaw, domain));
+      suite.push_back(new ChiSqProblem("ChiSq_PowerLaw+Gaussian",
+                                       spectrum, domain));
+      suite.push_back(new ChiSqProblem("ChiSq_AbsEdge*(PowerLaw+Gaussian)",
+                                       absorbed, domain));
+      suite.push_back(new ChiSqProblem("ChiSq_Gaussian", gaussian,
+                                       linearDomain(npts, 1., 9.)));
+   }
+}
+
+/// Gradient of the function being minimized, -sign*stat.
+void minusGradient(Statistic & stat, double sign, std::vector<double> & g) {
+   stat.getFreeDerivs(g);
+   for (size_t i = 0; i < g.size(); i++) {
+      g[i] *= -sign;
+   }
+}
+
+double computeEdm(Statistic & stat, double sign) {
+   std::vector<double> x;
+   stat.getFreeParamValues(x);
+   size_t npar(x.size());
+
+   std::vector<double> g0;
+   minusGradient(stat, sign, g0);
+
+// Forward-difference Hessian, stepping away from a bound if need be.
+   std::vector<double> hess(npar*npar);
+   std::vector<double> xp(x);
+   std::vector<double> g;
+   for (size_t j = 0; j < npar; j++) {
+      double step(1e-6*std::max(std::fabs(x[j]), 1e-3));
+      xp[j] = x[j] + step;
+      try {
+         stat.setFreeParamValues(xp);
+      } catch (OutOfBounds &) {
+         step = -step;
+         xp[j] = x[j] + step;
+         stat.setFreeParamValues(xp);
+      }
+      minusGradient(stat, sign, g);
+      for (size_t i = 0; i < npar; i++) {
+         hess[i*npar + j] = (g[i] - g0[i])/step;
+      }
+      xp[j] = x[j];
+   }
+   stat.setFreeParamValues(x);
+   for (size_t i = 0; i < npar; i++) {
+      for (size_t j = 0; j < i; j++) {
+         hess[i*npar + j] = hess[j*npar + i]
+            = 0.5*(hess[i*npar + j] + hess[j*npar + i]);
+      }
+   }
+
+// Cholesky factorization in place (lower triangle), then solve
+// H y = g0 and return 0.5 g0.y.
+   for (size_t j = 0; j < npar; j++) {
+      double diag(hess[j*npar + j]);
+      for (size_t k = 0; k < j; k++) {
+         diag -= hess[j*npar + k]*hess[j*npar + k];
+      }
+      if (!(diag > 0)) {
+         return std::numeric_limits<double>::quiet_NaN();
+      }
+      diag = std::sqrt(diag);
+      hess[j*npar + j] = diag;
+      for (size_t i = j + 1; i < npar; i++) {
+         double sum(hess[i*npar + j]);
+         for (size_t k = 0; k < j; k++) {
+            sum -= hess[i*npar + k]*hess[j*npar + k];
+         }
+         hess[i*npar + j] = sum/diag;
+      }
+   }
+   std::vector<double> y(g0);
+   for (size_t i = 0; i < npar; i++) {
+      for (size_t k = 0; k < i; k++) {
+         y[i] -= hess[i*npar + k]*y[k];
+      }
+      y[i] /= hess[i*npar + i];
+   }
+// With L y = g0, g0^T H^{-1} g0 = y.y
+   double edm(0);
+   for (size_t i = 0; i < npar; i++) {
+      edm += y[i]*y[i];
+   }
+   return 0.5*edm;
+}
+
+struct Result {
+   std::string optimizer;
+   std::string problem;
+   size_t npar;
+   size_t ndata;
+   std::string status;
+   double wallTime;
+   unsigned long nvalue;
+   unsigned long ngrad;
+   double fval;
+   double edm;
+};
+
+Optimizer * createOptimizer(const std::string & name, Statistic & stat) {
+   if (name == "Minuit") {
+      return new Minuit(stat);
+   } else if (name == "NewMinuit") {
+      return new NewMinuit(stat);
+   } else if (name == "Lbfgs") {
+      return new Lbfgs(stat);
+   } else if (name.substr(0, 6) == "Lbfgs:") {
+      Lbfgs * lbfgs(new Lbfgs(stat));
+      lbfgs->setMaxVarMetCorr(std::atoi(name.substr(6).c_str()));
+      return lbfgs;
+   } else if (name == "LbfgsB") {
+      return new LbfgsB(stat);
+   } else if (name.substr(0, 7) == "LbfgsB:") {
+      LbfgsB * lbfgsb(new LbfgsB(stat));
+      lbfgsb->setMaxVarMetCorr(std::atoi(name.substr(7).c_str()));
+      return lbfgsb;
+   } else if (name == "ModNewton") {
+      return new ModNewton(stat, true);
+   } else if (name == "ModNewtonNoGrad") {
+      return new ModNewton(stat, false);
+   } else if (name == "Powell") {
+      return new Powell(stat);
+   }
+   throw std::runtime_error("bench_optimizers: unknown optimizer " + name);
+}
+
+Result run(const std::string & optName, Problem & problem,
+           int maxEval, double tol) {
+   problem.reset();
+   Statistic & stat(problem.stat());
+   SignedStatistic signedStat(stat, problem.sign());
+
+   Result result;
+   result.optimizer = optName;
+   result.problem = problem.name();
+   result.npar = stat.getNumFreeParams();
+   result.ndata = problem.ndata();
+   result.status = "ok";
+
+// The original Minuit is compiled for at most 50 variable parameters.
+   if (optName == "Minuit" && result.npar > 50) {
+      result.status = "skipped";
+      result.wallTime = 0;
+      result.nvalue = result.ngrad = 0;
+      result.fval = result.edm = std::numeric_limits<double>::quiet_NaN();
+      return result;
+   }
+
+// The evaluations are counted by the Optimizer's instrumentation,
+// or, for Amoeba, by the same decorator used directly.
+   Instrumentation amoebaRecord;
+   std::unique_ptr<Optimizer> optimizer;
+   std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+   try {
+      if (optName == "Amoeba") {
+         InstrumentedStatistic counted(signedStat, amoebaRecord);
+         AmoebaObjective objective(counted);
+         std::vector<double> params;
+         stat.getFreeParamValues(params);
+         Amoeba amoeba(objective, params);
+         amoeba.setMaxEval(maxEval);
+         amoeba.findMin(params, tol);
+         counted.setFreeParamValues(params);
+      } else {
+         optimizer.reset(createOptimizer(optName, signedStat));
+         optimizer->setInstrumentation(true);
+         optimizer->setMaxEval(maxEval);
+         optimizer->find_min(0, tol, ABSOLUTE);
+      }
+   } catch (std::exception & eObj) {
+      result.status = eObj.what();
+   }
+   std::chrono::duration<double> elapsed(std::chrono::steady_clock::now()
+                                         - start);
+   result.wallTime = elapsed.count();
+   const Instrumentation & record(optimizer ? *optimizer->instrumentation()
+                                  : amoebaRecord);
+   result.nvalue = record.calls(Instrumentation::VALUE)
+      + record.calls(Instrumentation::VALUE_AND_DERIVS);
+   result.ngrad = record.calls(Instrumentation::DERIVS)
+      + record.calls(Instrumentation::VALUE_AND_DERIVS);
+   result.fval = -problem.sign()*stat.value();
+// The dense Hessian of the EDM would cost far more than the fit
+// itself for the largest problems.
+   result.edm = std::numeric_limits<double>::quiet_NaN();
+   if (result.npar <= 1000) {
+      try {
+         result.edm = computeEdm(stat, problem.sign());
+      } catch (std::exception &) {
+      }
+   }
+   return result;
+}
+
+/// Collapse a status message onto one line, free of the CSV and
+/// JSON delimiters.
+std::string sanitize(const std::string & message) {
+   std::string clean;
+   for (size_t i = 0; i < message.size(); i++) {
+      char c(message[i]);
+      if (c == '\n' || c == '\r' || c == '\t' || c == ',') {
+         c = ' ';
+      } else if (c == '"' || c == '\\') {
+         c = '\'';
+      }
+      clean += c;
+   }
+   return clean;
+}
+
+std::string number(double value, bool json) {
+   if (std::isnan(value) || std::isinf(value)) {
+      return json ? "null" : "nan";
+   }
+   std::ostringstream formatted;
+   formatted.precision(10);
+   formatted << value;
+   return formatted.str();
+}
+
+void writeCsv(std::ostream & out, const std::vector<Result> & results) {
+   out << "optimizer,problem,npar,ndata,status,wall_time,nvalue,ngrad,"
+       << "fval,edm\n";
+   for (size_t i = 0; i < results.size(); i++) {
+      const Result & r(results[i]);
+      out << r.optimizer << ","
+          << r.problem << ","
+          << r.npar << ","
+          << r.ndata << ","
+          << sanitize(r.status) << ","
+          << number(r.wallTime, false) << ","
+          << r.nvalue << ","
+          << r.ngrad << ","
+          << number(r.fval, false) << ","
+          << number(r.edm, false) << "\n";
+   }
+}
+
+void writeJson(std::ostream & out, const std::vector<Result> & results) {
+   out << "[\n";
+   for (size_t i = 0; i < results.size(); i++) {
+      const Result & r(results[i]);
+      out << "  {\"optimizer\": \"" << r.optimizer << "\", "
+          << "\"problem\": \"" << r.problem << "\", "
+          << "\"npar\": " << r.npar << ", "
+          << "\"ndata\": " << r.ndata << ", "
+          << "\"status\": \"" << sanitize(r.status) << "\", "
+          << "\"wall_time\": " << number(r.wallTime, true) << ", "
+          << "\"nvalue\": " << r.nvalue << ", "
+          << "\"ngrad\": " << r.ngrad << ", "
+          << "\"fval\": " << number(r.fval, true) << ", "
+          << "\"edm\": " << number(r.edm, true) << "}"
+          << (i + 1 < results.size() ? ",\n" : "\n");
+   }
+   out << "]\n";
+}
+
+void split(const std::string & list, std::vector<std::string> & names) {
+   names.clear();
+   std::istringstream stream(list);
+   std::string name;
+   while (std::getline(stream, name, ',')) {
+      if (!name.empty()) {
+         names.push_back(name);
+      }
+   }
+}
+
+void usage() {
+   std::cerr << "usage: bench_optimizers [--json] [--output file] "
+             << "[--max-dim n] [--max-data n]\n"
+             << "                        [--max-eval n] [--tol x] "
+             << "[--optimizers name1,name2,...]\n";
+}
+
+} // anonymous namespace
+
+int main(int iargc, char * argv[]) {
+   bool json(false);
+   std::string outfile;
+   int maxDim(1000);
+   size_t maxData(100000);
+   int maxEval(10000);
+   double tol(1e-5);
+   std::vector<std::string> optNames;
+   split("Minuit,NewMinuit,Lbfgs,LbfgsB,ModNewton,ModNewtonNoGrad,Powell,Amoeba",
+         optNames);
+
+   for (int i = 1; i < iargc; i++) {
+      std::string arg(argv[i]);
+      bool hasValue(i + 1 < iargc);
+      if (arg == "--json") {
+         json = true;
+      } else if (arg == "--output" && hasValue) {
+         outfile = argv[++i];
+      } else if (arg == "--max-dim" && hasValue) {
+         maxDim = std::atoi(argv[++i]);
+      } else if (arg == "--max-data" && hasValue) {
+         maxData = std::strtoul(argv[++i], 0, 10);
+      } else if (arg == "--max-eval" && hasValue) {
+         maxEval = std::atoi(argv[++i]);
+      } else if (arg == "--tol" && hasValue) {
+         tol = std::atof(argv[++i]);
+      } else if (arg == "--optimizers" && hasValue) {
+         split(argv[++i], optNames);
+      } else {
+         usage();
+         return 1;
+      }
+   }
+   if (outfile.empty()) {
+      outfile = json ? "bench_optimizers.json" : "bench_optimizers.csv";
+   }
+
+   std::vector<Problem *> suite;
+   std::vector<Result> results;
+   try {
+      buildSuite(suite, maxDim, maxData);
+      for (size_t i = 0; i < suite.size(); i++) {
+         for (size_t j = 0; j < optNames.size(); j++) {
+            Result result(run(optNames[j], *suite[i], maxEval, tol));
+            std::cerr << result.optimizer << "  " << result.problem << "  "
+                      << result.npar << "  " << result.ndata << "  "
+                      << result.wallTime << " s  " << result.status
+                      << std::endl;
+            results.push_back(result);
+         }
+      }
+   } catch (std::exception & eObj) {
+      std::cerr << eObj.what() << std::endl;
+      for (size_t i = 0; i < suite.size(); i++) {
+         delete suite[i];
+      }
+      return 1;
+   }
+   for (size_t i = 0; i < suite.size(); i++) {
+      delete suite[i];
+   }
+
+   std::ofstream out(outfile.c_str());
+   if (json) {
+      writeJson(out, results);
+   } else {
+      writeCsv(out, results);
+   }
+   return 0;
+}
@@ -12,32 +12,51 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
+#include <atomic>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 
 #include "Minuit2/MnPrint.h"
 
 #include "optimizers/Amoeba.h"
+#include "optimizers/CachedStatistic.h"
 #include "optimizers/ChiSq.h"
+#include "optimizers/CovarianceMatrix.h"
 #include "optimizers/dArg.h"
 #include "optimizers/Drmngb.h"
 #include "optimizers/Exception.h"
+#include "optimizers/FitsSampleSink.h"
 #include "optimizers/Function.h"
 #include "optimizers/FunctionFactory.h"
 #include "optimizers/FunctionTest.h"
+#include "optimizers/InstrumentedStatistic.h"
 #include "optimizers/Gaussian.h"
 #include "optimizers/Lbfgs.h"
+#include "optimizers/LbfgsB.h"
 #include "optimizers/Minuit.h"
+#include "optimizers/ModNewton.h"
 #include "optimizers/Mcmc.h"
+#include "optimizers/MultiStart.h"
 #include "optimizers/Optimizer.h"
 #include "optimizers/OptimizerFactory.h"
 #include "optimizers/OutOfBounds.h"
 #include "optimizers/Parameter.h"
+#include "optimizers/ParameterNotFound.h"
+#include "optimizers/Powell.h"
 #include "optimizers/ProductFunction.h"
+#include "optimizers/Simplex.h"
+#include "optimizers/SparseHessian.h"
 #include "optimizers/SumFunction.h"
+#include "optimizers/TraceWriter.h"
 
 #include "optimizers/NewMinuit.h"
 
@@ -62,6 +81,25 @@
 
 using namespace optimizers;
 
+// Count heap allocations so that test_allocations can check the
+// evaluation hot paths.
+namespace {
+   std::atomic<unsigned long> allocationCount(0);
+}
+
+void * operator new(size_t size) {
+   allocationCount++;
+   void * ptr = std::malloc(size > 0 ? size : 1);
+   if (ptr == 0) {
+      throw std::bad_alloc();
+   }
+   return ptr;
+}
+
+void operator delete(void * ptr) noexcept {
+   std::free(ptr);
+}
+
 void test_FunctionFactory();
 void test_Parameter_class();
 void test_Function_class();
@@ -74,6 +112,26 @@ void test_ChiSq();
 void test_Amoeba();
 void test_rescaling();
 void test_scalingFunction();
+void test_batchEvaluation();
+void test_Minuit_threads();
+void test_Minuit2_threads();
+void test_parallelHessian();
+void test_mcmcChains();
+void test_sampleBuffer();
+void test_evaluationCache();
+void test_allocations();
+void test_instrumentation();
+void test_iterationTrace();
+void test_NewMinuit_warmStart();
+void test_MinosAll();
+void test_contours();
+void test_multiStart();
+void test_simplex();
+void test_parallelPowell();
+void test_lbfgsBounds();
+void test_lbfgsB();
+void test_sparseHessian();
+void test_covarianceMatrix();
 
 std::string test_path;
 
@@ -93,6 +151,28 @@ int main() {
    test_Amoeba();
    test_rescaling();
    test_scalingFunction();
+   test_batchEvaluation();
+   test_mcmcChains();
+   test_sampleBuffer();
+   test_evaluationCache();
+   test_allocations();
+   test_instrumentation();
+   test_iterationTrace();
+   test_NewMinuit_warmStart();
+   test_MinosAll();
+   test_contours();
+   test_multiStart();
+   test_simplex();
+   test_parallelPowell();
+   test_lbfgsB();
+   test_sparseHessian();
+   test_covarianceMatrix();
+#ifndef DARWIN_F2C_FAILURE
+   test_lbfgsBounds();
+   test_Minuit_threads();
+   test_Minuit2_threads();
+   test_parallelHessian();
+#endif
    return 0;
 }
 
@@ -216,6 +296,16 @@ void test_Mcmc() {
 
       myMcmcObj.writeSamples("Mc.fits", mcmc_samples);
 
+// Stream samples straight to a FITS file in small blocks.
+      std::vector<std::string> names;
+      myMcmcObj.getColumnNames(names);
+      assert(names.size() == params.size() + 1);
+      assert(names[0] == params[0].getName());
+      FitsSampleSink fitsSink("Mc_stream.fits", names, true, 1000);
+      myMcmcObj.generateSamples(fitsSink, 2500);
+      fitsSink.close();
+      assert(fitsSink.nrows() == 2500);
+
       std::cout << "MCMC results for " << nsamp << " trials:" << std::endl;
       for (unsigned int j = 0; j < params.size(); j++) {
          double mc_avg = 0;
@@ -280,6 +370,8 @@ void test_Optimizers() {
 
    std::vector<std::string> optimizers;
    optimizers.push_back("NewMinuit");
+   optimizers.push_back("Simplex");
+   optimizers.push_back("LbfgsB");
 #ifndef DARWIN_F2C_FAILURE
    optimizers.push_back("Minuit");
    optimizers.push_back("Drmngb");
@@ -309,6 +401,22 @@ void test_Optimizers() {
    }
    rosenND.setParams(params);
 
+// check the fused value and gradient against the separate calls
+   std::vector<double> freeParams, derivs, fusedDerivs;
+   rosenND.getFreeParamValues(freeParams);
+   freeParams[2] = 0.3;
+   double fusedValue;
+   rosenND.valueAndFreeDerivs(freeParams, fusedValue, fusedDerivs);
+   rosenND.getFreeDerivs(derivs);
+   assert(std::fabs(fusedValue - rosenND.value()) 
+          <= 1e-12*std::fabs(fusedValue));
+   assert(fusedDerivs.size() == derivs.size());
+   for (size_t i = 0; i < derivs.size(); i++) {
+      assert(std::fabs(fusedDerivs[i] - derivs[i]) 
+             <= 1e-12*(std::fabs(derivs[i]) + 1.));
+   }
+   rosenND.setParams(params);
+
    for (size_t i = 0; i < optimizers.size(); i++) {
       std::cout << "Testing " << optimizers[i] 
                 << " using 5-D Rosenbrock function..." 
@@ -509,6 +617,18 @@ void test_CompositeFunction() {
    absorbed_spec.getDerivs(xarg, derivs);
 
    double eps = 1e-7;
+   for (unsigned int i = 0; i < params.size(); i++) {
+      assert(std::fabs(absorbed_spec.derivByParamIndex(xarg, i) - derivs[i])
+             <= 1e-12*std::fabs(derivs[i]));
+   }
+   std::vector<double> fused_derivs;
+   double fused_value = absorbed_spec.getValueAndDerivs(xarg, fused_derivs);
+   assert(std::fabs(fused_value - spec_value) <= 1e-12*std::fabs(spec_value));
+   assert(fused_derivs.size() == derivs.size());
+   for (unsigned int i = 0; i < derivs.size(); i++) {
+      assert(std::fabs(fused_derivs[i] - derivs[i]) 
+             <= 1e-12*std::fabs(derivs[i]));
+   }
    for (unsigned int i = 0; i < params.size(); i++) {
       std::vector<double> new_params = params;
       double dparam = eps*new_params[i];
@@ -736,6 +856,25 @@ void test_Function_class() {
       assert(f.derivByParam(x, paramNames[i]) == pow(2., static_cast<int>(i)));
    }
 
+// by index:
+   for (unsigned int i = 0; i < paramNames.size(); i++) {
+      assert(f.parameterIndex(paramNames[i]) == i);
+      assert(f.derivByParamIndex(x, i) == f.derivByParam(x, paramNames[i]));
+   }
+   try {
+      f.parameterIndex("Joan");
+      assert(false);
+   } catch(optimizers::Exception &eObj) {
+      std::cout << eObj.what() << std::endl;
+   }
+   Rosen rosen;
+   try {
+      rosen.derivByParamIndex(x, 2);
+      assert(false);
+   } catch(ParameterNotFound &eObj) {
+      std::cout << eObj.what() << std::endl;
+   }
+
 // all derivatives in one shot:
    std::vector<double> derivs;
    f.getDerivs(x, derivs);
@@ -968,6 +1107,28 @@ void test_ChiSq() {
       }
    }
 
+   // The fused evaluation should agree with the separate calls.
+   std::vector<double> free_params;
+   chi_sq.getFreeParamValues(free_params);
+   double fused_value;
+   ChiSq::DataCont_t fused_deriv;
+   chi_sq.valueAndFreeDerivs(free_params, fused_value, fused_deriv);
+   if (fabs((fused_value - chi_sq.value()) / correct_value) > 1.e-12) {
+      passed = false;
+      std::cerr << "ChiSq::valueAndFreeDerivs returned " << fused_value
+                << ", not " << chi_sq.value() << ", as expected."
+                << std::endl;
+   }
+   for (std::size_t ii = 0; ii < deriv.size(); ++ii) {
+      if (fabs((fused_deriv.at(ii) - deriv[ii]) / deriv[ii]) > 1.e-12) {
+         passed = false;
+         std::cerr << "ChiSq::valueAndFreeDerivs deriv[" << ii
+                   << "] has value " << fused_deriv.at(ii) << ", not "
+                   << deriv[ii] << ", as expected."
+                   << std::endl;
+      }
+   }
+
    if (passed)
       std::cout << "*** test_ChiSq: all tests passed ***\n" 
                 << std::endl;
@@ -985,6 +1146,9 @@ public:
 //                 << value << std::endl;
       return value;
    }
+   virtual Functor * clone() const {
+      return new Paraboloid(*this);
+   }
 private:
    double m_x0;
    double m_y0;
@@ -1001,6 +1165,30 @@ void test_Amoeba() {
    my_amoeba.findMin(pars, tol=1e-15);
    assert(std::fabs(pars.at(0) - 1.) < 1e-7);
    assert(std::fabs(pars.at(1) - 2.) < 1e-7);
+   int nevals(my_amoeba.numEvals());
+   assert(nevals > 0);
+
+// The speculative parallel steps follow the same path, at the cost
+// of extra evaluations.
+   pars.at(0) = 3.;
+   pars.at(1) = 1.;
+   Amoeba parallel_amoeba(func, pars);
+   parallel_amoeba.setThreads(4);
+   parallel_amoeba.findMin(pars, 1e-15);
+   assert(std::fabs(pars.at(0) - 1.) < 1e-7);
+   assert(std::fabs(pars.at(1) - 2.) < 1e-7);
+   assert(parallel_amoeba.numEvals() >= nevals);
+
+   pars.at(0) = 3.;
+   pars.at(1) = 1.;
+   Amoeba limited_amoeba(func, pars);
+   limited_amoeba.setMaxEval(20);
+   try {
+      limited_amoeba.findMin(pars, 1e-15);
+      assert(false);
+   } catch (std::runtime_error &) {
+      assert(limited_amoeba.numEvals() >= 20);
+   }
 }
 
 void test_rescaling() {
@@ -1040,3 +1228,1595 @@ void test_scalingFunction() {
    delete original;
    delete copy;
 }
+
+void test_batchEvaluation() {
+   std::cout << "*** test_batchEvaluation ***" << std::endl;
+
+   std::vector<Function *> my_functions;
+   my_functions.push_back(new BrokenPowerLaw(2., -1.5, -2.5, 3.));
+   my_functions.push_back(new Gaussian(10., 2., 0.7));
+   my_functions.push_back(new PowerLaw(2., -2.1, 1.5));
+   my_functions.push_back(new AbsEdge(5., 1.2));
+   my_functions.push_back(new MyFun());
+
+// scaled version of a batched model
+   BrokenPowerLaw scaled(2., -1.5, -2.5, 3.);
+   scaled.setScalingFunction(ConstantValue(3.));
+   my_functions.push_back(scaled.clone());
+
+   std::vector<double> xx;
+   for (size_t i(0); i < 40; i++) {
+      xx.push_back(0.1 + 0.15*i);
+   }
+   size_t npts(xx.size());
+
+   for (size_t k(0); k < my_functions.size(); k++) {
+      const Function & func(*my_functions.at(k));
+      std::vector<double> values(npts);
+      func.values(&xx[0], &values[0], npts);
+
+      for (int getFree(0); getFree < 2; getFree++) {
+         size_t npars(getFree ? func.getNumFreeParams() : func.getNumParams());
+         std::vector<double> derivs(npars*npts);
+         func.derivs(&xx[0], &derivs[0], npts, getFree == 1);
+         for (size_t i(0); i < npts; i++) {
+            dArg arg(xx[i]);
+            double value(func(arg));
+            assert(std::fabs(values[i] - value) <= 1e-12*std::fabs(value));
+            std::vector<double> my_derivs;
+            if (getFree) {
+               func.getFreeDerivs(arg, my_derivs);
+            } else {
+               func.getDerivs(arg, my_derivs);
+            }
+            assert(my_derivs.size() == npars);
+            for (size_t j(0); j < npars; j++) {
+               assert(std::fabs(derivs[j*npts + i] - my_derivs[j])
+                      <= 1e-12*std::fabs(my_derivs[j]) + 1e-300);
+            }
+         }
+      }
+      delete my_functions[k];
+   }
+   std::cout << "*** test_batchEvaluation: all tests passed ***\n" 
+             << std::endl;
+}
+
+void setRosenNDStart(RosenND & rosen, double offset) {
+   std::vector<Parameter> params;
+   rosen.getParams(params);
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setValue(1.2 + offset + 0.05*i);
+      params[i].setBounds(-10., 10.);
+   }
+   rosen.setParams(params);
+}
+
+void fitRosenND(size_t ifit, std::vector<double> * results,
+                bool minuit2=false) {
+   RosenND rosen(4);
+   setRosenNDStart(rosen, 0.1*ifit);
+
+   Minuit my_opt(rosen);
+   my_opt.setUseMinuit2(minuit2);
+   my_opt.find_min(0, 1e-8);
+   rosen.getFreeParamValues(*results);
+   const std::vector<double> & sigmas(my_opt.getUncertainty());
+   results->insert(results->end(), sigmas.begin(), sigmas.end());
+   results->push_back(my_opt.getDistance());
+}
+
+void test_Minuit_threads() {
+   std::cout << "*** test_Minuit_threads ***" << std::endl;
+
+   const size_t nfits(8);
+
+// reference results from serial fits
+   std::vector< std::vector<double> > serial(nfits);
+   for (size_t k = 0; k < nfits; k++) {
+      fitRosenND(k, &serial[k]);
+   }
+
+// the same fits from several threads, each with its own Minuit
+// instance, which Minuit serializes
+   std::vector< std::vector<double> > threaded(nfits);
+   std::vector<std::thread> threads;
+   for (size_t k = 0; k < nfits; k++) {
+      threads.push_back(std::thread(fitRosenND, k, &threaded[k], false));
+   }
+   for (size_t k = 0; k < nfits; k++) {
+      threads[k].join();
+   }
+
+   for (size_t k = 0; k < nfits; k++) {
+      assert(threaded[k] == serial[k]);
+      assert(std::fabs(serial[k][0] - 1.) < 1e-3);
+   }
+
+// two instances whose calls are interleaved in one thread
+   RosenND rosen_a(3), rosen_b(3);
+   setRosenNDStart(rosen_a, 0);
+   setRosenNDStart(rosen_b, 0.5);
+   Minuit opt_a(rosen_a);
+   Minuit opt_b(rosen_b);
+   opt_a.find_min(0, 1e-8);
+   std::vector<std::vector<double> > cov_a(opt_a.covarianceMatrix());
+   opt_b.find_min(0, 1e-8);
+   assert(opt_a.covarianceMatrix() == cov_a);
+
+   std::cout << "*** test_Minuit_threads: all tests passed ***\n" 
+             << std::endl;
+}
+
+void test_Minuit2_threads() {
+   std::cout << "*** test_Minuit2_threads ***" << std::endl;
+
+   const size_t nfits(8);
+
+// reference results from serial fits
+   std::vector< std::vector<double> > serial(nfits);
+   for (size_t k = 0; k < nfits; k++) {
+      fitRosenND(k, &serial[k], true);
+   }
+
+// the same fits run concurrently, each with its own Minuit instance
+// routed through Minuit2
+   std::vector< std::vector<double> > threaded(nfits);
+   std::vector<std::thread> threads;
+   for (size_t k = 0; k < nfits; k++) {
+      threads.push_back(std::thread(fitRosenND, k, &threaded[k], true));
+   }
+   for (size_t k = 0; k < nfits; k++) {
+      threads[k].join();
+   }
+
+   for (size_t k = 0; k < nfits; k++) {
+      assert(threaded[k] == serial[k]);
+      assert(std::fabs(serial[k][0] - 1.) < 1e-3);
+   }
+
+// the commands that Minuit issues itself
+   RosenND rosen(3);
+   setRosenNDStart(rosen, 0);
+   Minuit my_opt(rosen);
+   my_opt.setUseMinuit2(true);
+   assert(my_opt.doCmd("SET PRINT -1") == 0);
+   assert(my_opt.doCmd("set strategy 2") == 0);
+   assert(my_opt.getStrategy() == 2);
+   assert(my_opt.doCmd("MIGRAD 1000 0.001") == 0);
+   assert(my_opt.doCmd("HESSE") == 0);
+   assert(my_opt.getUncertainty().size() == 3);
+   assert(my_opt.doCmd("MINOS 1000 1") == 0);
+   assert(my_opt.doCmd("SCAN") == 3);
+   assert(std::fabs(rosen.getParamValue("x0") - 1.) < 1e-3);
+
+   std::cout << "*** test_Minuit2_threads: all tests passed ***\n" 
+             << std::endl;
+}
+
+void checkParallelHessian(Statistic & stat) {
+   OptimizerFactory & optFactory(OptimizerFactory::instance());
+   Optimizer * my_opt(optFactory.create("Lbfgs", stat));
+
+   std::vector<double> params;
+   stat.getFreeParamValues(params);
+   std::vector<double> serial(my_opt->getUncertainty());
+
+   my_opt->setHessianThreads(4, STATIC);
+   assert(my_opt->getUncertainty() == serial);
+   my_opt->setHessianThreads(3, DYNAMIC);
+   assert(my_opt->getUncertainty() == serial);
+   my_opt->setHessianThreads(0);
+   assert(my_opt->getUncertainty() == serial);
+
+// the Statistic must be left at its original point
+   std::vector<double> new_params;
+   stat.getFreeParamValues(new_params);
+   assert(new_params == params);
+   delete my_opt;
+}
+
+void test_parallelHessian() {
+   std::cout << "*** test_parallelHessian ***" << std::endl;
+
+   RosenND rosen(6);
+   std::vector<Parameter> params;
+   rosen.getParams(params);
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setBounds(-10., 10.);
+   }
+   rosen.setParams(params);
+   checkParallelHessian(rosen);
+
+// ChiSq copies must evaluate independently of the original.
+   Gaussian gauss(10., 1., 0.5);
+   std::vector<double> domain, range;
+   for (size_t i = 0; i < 50; i++) {
+      domain.push_back(0.05*i);
+      range.push_back(1.1*gauss(dArg(domain.back())));
+   }
+   ChiSq chi_sq(domain, range, &gauss);
+   double value(chi_sq.value());
+   Statistic * chi_sq_copy(dynamic_cast<Statistic *>(chi_sq.clone()));
+   std::vector<double> free_params;
+   chi_sq_copy->getFreeParamValues(free_params);
+   free_params[0] *= 2.;
+   chi_sq_copy->setFreeParamValues(free_params);
+   assert(chi_sq.value() == value);
+   assert(chi_sq_copy->value() != value);
+   delete chi_sq_copy;
+   assert(chi_sq.value() == value);
+
+   std::cout << "*** test_parallelHessian: all tests passed ***\n" 
+             << std::endl;
+}
+
+void test_mcmcChains() {
+   std::cout << "*** test_mcmcChains ***" << std::endl;
+
+   Rosen my_rosen(1.);
+   std::vector<Parameter> params;
+   my_rosen.getParams(params);
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setValue(1.);
+      params[i].setBounds(-5., 5.);
+   }
+   my_rosen.setParams(params);
+
+   Mcmc myMcmcObj(my_rosen, false);
+   std::vector<double> widths(2, 0.7);
+   myMcmcObj.setTransitionWidths(widths);
+
+   unsigned long nsamp(20000);
+   unsigned int nchains(4);
+   Mcmc::Proposal proposals[] = {Mcmc::VARIABLE_AT_A_TIME, Mcmc::BLOCK,
+                                 Mcmc::ADAPTIVE};
+   std::vector<double> startValues;
+   my_rosen.getFreeParamValues(startValues);
+   for (size_t ip = 0; ip < 3; ip++) {
+      std::vector< std::vector< std::vector<double> > > chains;
+      myMcmcObj.generateChains(chains, nsamp, nchains, proposals[ip]);
+      assert(chains.size() == nchains);
+      for (size_t k = 0; k < nchains; k++) {
+         assert(chains[k].size() == nsamp);
+         assert(chains[k][0].size() == params.size() + 1);
+      }
+// The Function itself is not touched by the chains.
+      std::vector<double> values;
+      my_rosen.getFreeParamValues(values);
+      assert(values == startValues);
+
+      std::vector<double> rhat = Mcmc::gelmanRubin(chains, nsamp/2);
+      assert(rhat.size() == params.size());
+      for (size_t i = 0; i < rhat.size(); i++) {
+         std::cout << "proposal " << ip << ", R-hat " << i << ": "
+                   << rhat[i] << std::endl;
+         assert(rhat[i] < 1.1);
+      }
+
+// Chains are reproducible for a given seed.
+      std::vector< std::vector< std::vector<double> > > chains2;
+      myMcmcObj.generateChains(chains2, 1000, nchains, proposals[ip]);
+      for (size_t k = 0; k < nchains; k++) {
+         for (size_t j = 0; j < chains2[k].size(); j++) {
+            assert(chains2[k][j] == chains[k][j]);
+         }
+      }
+   }
+
+// Widely separated chains are flagged as unconverged.
+   std::vector< std::vector< std::vector<double> > > chains(2);
+   for (size_t j = 0; j < 100; j++) {
+      chains[0].push_back(std::vector<double>(3, 0.01*(j % 10)));
+      chains[1].push_back(std::vector<double>(3, 10. + 0.01*(j % 10)));
+   }
+   assert(Mcmc::gelmanRubin(chains)[0] > 10.);
+
+// A parameter that never moves has no R-hat.
+   for (size_t j = 0; j < 100; j++) {
+      chains[0][j][1] = 1.;
+      chains[1][j][1] = 2.;
+   }
+   try {
+      Mcmc::gelmanRubin(chains);
+      assert(false);
+   } catch (optimizers::Exception &) {
+   }
+   chains.resize(1);
+   try {
+      Mcmc::gelmanRubin(chains);
+      assert(false);
+   } catch (optimizers::Exception &) {
+   }
+
+// Samples can be streamed to a sink instead of being accumulated.
+   class CountingSink : public SampleSink {
+   public:
+      CountingSink() : m_count(0), m_flushed(false) {}
+      virtual void write(const std::vector<double> & sample) {
+         assert(sample.size() == 3);
+         m_count++;
+      }
+      virtual void flush() {
+         m_flushed = true;
+      }
+      unsigned long m_count;
+      bool m_flushed;
+   } countingSink;
+   myMcmcObj.generateSamples(countingSink, 1001);
+   assert(countingSink.m_count >= 1001 && countingSink.m_flushed);
+
+// Fewer samples than the number of progress dots still works.
+   Mcmc verboseMcmc(my_rosen, true);
+   std::vector< std::vector<double> > samples;
+   verboseMcmc.generateSamples(samples, 10, true);
+   assert(samples.size() == 10);
+
+   std::cout << "*** test_mcmcChains: all tests passed ***\n" << std::endl;
+}
+
+void test_sampleBuffer() {
+   std::cout << "*** test_sampleBuffer ***" << std::endl;
+
+   SampleBuffer buffer;
+   std::vector<double> row(3);
+   for (size_t i = 0; i < 2000; i++) {
+      row[0] = i;
+      row[1] = 2.*i;
+      row[2] = -1.*i;
+      buffer.write(row);
+   }
+   assert(buffer.ncols() == 3 && buffer.size() == 2000);
+   assert(buffer.capacity() >= 2000);
+// Columns are contiguous and survive reallocation.
+   const double * col1 = buffer.column(1);
+   for (size_t i = 0; i < buffer.size(); i++) {
+      assert(col1[i] == 2.*i);
+      assert(buffer(i, 2) == -1.*i);
+   }
+   buffer.reserve(10000);
+   assert(buffer.capacity() == 10000 && buffer(1999, 0) == 1999.);
+   buffer.resize(2500);
+   assert(buffer(2499, 1) == 0 && buffer(1000, 1) == 2000.);
+
+   std::vector< std::vector<double> > nested;
+   buffer.appendTo(nested);
+   assert(nested.size() == 2500 && nested[10][2] == -10.);
+
+   row.resize(2);
+   try {
+      buffer.write(row);
+      assert(false);
+   } catch (optimizers::Exception &) {
+   }
+
+// Mcmc samples go straight into the buffer, which is reserved
+// up front.
+   Rosen my_rosen(1.);
+   std::vector<Parameter> params;
+   my_rosen.getParams(params);
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setValue(1.);
+      params[i].setBounds(-5., 5.);
+   }
+   my_rosen.setParams(params);
+   Mcmc myMcmcObj(my_rosen, false);
+   SampleBuffer samples;
+   myMcmcObj.generateSamples(samples, 5000, true);
+   assert(samples.ncols() == 3 && samples.size() == 5000);
+   size_t capacity(samples.capacity());
+   myMcmcObj.generateSamples(samples, 5000, true);
+   assert(samples.size() == 5000 && samples.capacity() == capacity);
+   for (size_t i = 0; i < samples.size(); i++) {
+      assert(samples(i, 0) >= -5. && samples(i, 0) <= 5.);
+   }
+   SampleBuffer wide(5);
+   wide.write(std::vector<double>(5, 0));
+   try {
+      myMcmcObj.generateSamples(wide, 10);
+      assert(false);
+   } catch (optimizers::Exception &) {
+   }
+
+   std::cout << "*** test_sampleBuffer: all tests passed ***\n" << std::endl;
+}
+
+void test_evaluationCache() {
+   std::cout << "*** test_evaluationCache ***" << std::endl;
+
+   RosenND rosen(4);
+   std::vector<Parameter> params;
+   rosen.getParams(params);
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setValue(1.2 + 0.1*i);
+      params[i].setBounds(-10., 10.);
+   }
+   rosen.setParams(params);
+
+   CachedStatistic cache(rosen, 2);
+   std::vector<double> x0, x1, x2;
+   rosen.getFreeParamValues(x0);
+   x1 = x0;
+   x1[0] += 0.1;
+   x2 = x0;
+   x2[1] += 0.1;
+
+   double f0(rosen.value());
+   std::vector<double> g0;
+   rosen.getFreeDerivs(g0);
+   assert(cache.value() == f0);
+   assert(cache.hits() == 0 && cache.misses() == 1);
+   assert(cache.value() == f0);
+   assert(cache.hits() == 1);
+
+// Fused requests fill in what is missing.
+   double f;
+   std::vector<double> g;
+   cache.valueAndFreeDerivs(x0, f, g);
+   assert(f == f0 && g == g0);
+   assert(cache.hits() == 1 && cache.misses() == 2);
+   cache.valueAndFreeDerivs(x0, f, g);
+   assert(cache.hits() == 2);
+
+// Least recently used points are evicted.
+   cache.setFreeParamValues(x1);
+   double f1(cache.value());
+   assert(f1 != f0);
+   std::vector<double> values;
+   rosen.getFreeParamValues(values);
+   assert(values == x1);
+   cache.getFreeParamValues(values);
+   assert(values == x1);
+   std::vector<Parameter> cachedParams;
+   cache.getParams(cachedParams);
+   for (size_t i = 0; i < cachedParams.size(); i++) {
+      assert(cachedParams[i].getValue() == x1[i]);
+   }
+   cache.setFreeParamValues(x0);
+   assert(cache.value() == f0);
+   cache.setFreeParamValues(x2);
+   cache.value();
+   cache.resetCounters();
+   cache.setFreeParamValues(x0);
+   cache.value();
+   assert(cache.hits() == 1);
+   cache.setFreeParamValues(x1);
+   assert(cache.value() == f1);
+   assert(cache.misses() == 1);
+
+// Fixing and freeing Parameters of the wrapped Statistic directly
+// changes the key.
+   cache.setFreeParamValues(x0);
+   cache.getFreeDerivs(g);
+   assert(g.size() == 4);
+   std::vector<Parameter> fixed(params);
+   fixed[1].setFree(false);
+   rosen.setParams(fixed);
+   cache.resetCounters();
+   cache.getFreeDerivs(g);
+   assert(g.size() == 3 && cache.misses() == 1);
+   assert(cache.value() == f0);
+   rosen.setParams(params);
+   cache.getFreeDerivs(g);
+   assert(g.size() == 4 && cache.hits() == 1);
+
+// Changing Parameters through the cache clears it.
+   cache.setParam(params[3].getName(), 1.5);
+   cache.resetCounters();
+   cache.setFreeParamValues(x1);
+   cache.value();
+   assert(cache.misses() == 1);
+   rosen.setParams(params);
+   cache.setParams(params);
+
+// Fits with and without the cache agree, and the cache absorbs the
+// repeated evaluations.
+   std::vector<std::string> names;
+   names.push_back("LbfgsB");
+#ifndef DARWIN_F2C_FAILURE
+   names.push_back("Lbfgs");
+   names.push_back("Minuit");
+   names.push_back("Drmngb");
+#endif
+   OptimizerFactory & optFactory(OptimizerFactory::instance());
+   for (size_t i = 0; i < names.size(); i++) {
+      rosen.setParams(params);
+      Optimizer * my_opt(optFactory.create(names[i], rosen));
+      my_opt->find_min(0, 1e-8);
+      std::vector<double> fitted, sig(my_opt->getUncertainty());
+      rosen.getFreeParamValues(fitted);
+      delete my_opt;
+
+      rosen.setParams(params);
+      my_opt = optFactory.create(names[i], rosen);
+      my_opt->setEvaluationCache(4);
+      assert(&my_opt->stat() == &rosen);
+      my_opt->find_min(0, 1e-8);
+      std::vector<double> cached_fitted, 
+         cached_sig(my_opt->getUncertainty());
+      rosen.getFreeParamValues(cached_fitted);
+// The Statistic's fused and separate evaluations may differ in
+// the last bits, so a cached value can differ from a recomputed one.
+      for (size_t j = 0; j < fitted.size(); j++) {
+         assert(fabs(cached_fitted[j] - fitted[j]) < 1e-8);
+         assert(fabs(cached_sig[j]/sig[j] - 1.) < 1e-6);
+      }
+      assert(my_opt->evaluationCache()->misses() > 0);
+      std::cout << names[i] << " cache hits: " 
+                << my_opt->evaluationCache()->hits() << ", misses: "
+                << my_opt->evaluationCache()->misses() << std::endl;
+      my_opt->evaluationCache()->resetCounters();
+      my_opt->clearEvaluationCache();
+      my_opt->evaluationCache()->value();
+      assert(my_opt->evaluationCache()->misses() == 1);
+      my_opt->setEvaluationCache(0);
+      assert(my_opt->evaluationCache() == 0);
+      assert(&my_opt->stat() == &rosen);
+      delete my_opt;
+   }
+
+   std::cout << "*** test_evaluationCache: all tests passed ***\n" 
+             << std::endl;
+}
+
+template <typename Evaluator>
+double allocationsPerCall(const std::string & label, Evaluator evaluate,
+                          size_t ncalls=100) {
+// The first call may size the caller's and the Function's buffers.
+   evaluate();
+   unsigned long start(allocationCount);
+   for (size_t i = 0; i < ncalls; i++) {
+      evaluate();
+   }
+   double perCall = double(allocationCount - start)/ncalls;
+   std::cout << label << ": " << perCall << " allocations per call" 
+             << std::endl;
+   return perCall;
+}
+
+void test_allocations() {
+   std::cout << "*** test_allocations ***" << std::endl;
+
+   dArg x(1.5);
+   std::vector<double> derivs;
+   double value(0);
+
+   PowerLaw pl(1., -2.1, 1.);
+   assert(allocationsPerCall("PowerLaw value", 
+                             [&]() {value += pl(x);}) == 0);
+   assert(allocationsPerCall("PowerLaw getFreeDerivs", 
+                             [&]() {pl.getFreeDerivs(x, derivs);}) == 0);
+
+   Gaussian gauss(10., 1., 0.5);
+   SumFunction sum(pl, gauss);
+   assert(allocationsPerCall("SumFunction getFreeDerivs", 
+                             [&]() {sum.getFreeDerivs(x, derivs);}) == 0);
+   assert(allocationsPerCall("SumFunction getValueAndFreeDerivs", 
+                             [&]() {
+                                value += sum.getValueAndFreeDerivs(x, derivs);
+                             }) == 0);
+   AbsEdge edge(5., 1.2);
+   ProductFunction product(pl, edge);
+   assert(allocationsPerCall("ProductFunction getFreeDerivs", 
+                             [&]() {product.getFreeDerivs(x, derivs);}) == 0);
+
+   RosenND rosen(6);
+   std::vector<double> params;
+   rosen.getFreeParamValues(params);
+   assert(allocationsPerCall("RosenND value", 
+                             [&]() {value += rosen.value();}) == 0);
+   assert(allocationsPerCall("RosenND getFreeDerivs", 
+                             [&]() {rosen.getFreeDerivs(derivs);}) == 0);
+   assert(allocationsPerCall("RosenND getFreeParamValues", 
+                             [&]() {rosen.getFreeParamValues(params);}) == 0);
+   assert(allocationsPerCall("RosenND setFreeParamValues", 
+                             [&]() {rosen.setFreeParamValues(params);}) == 0);
+   assert(allocationsPerCall("RosenND valueAndFreeDerivs", 
+                             [&]() {
+                                rosen.valueAndFreeDerivs(params, value, derivs);
+                             }) == 0);
+
+   std::vector<double> domain, range;
+   for (size_t i = 0; i < 100; i++) {
+      domain.push_back(0.05*i);
+      range.push_back(1.1*gauss(dArg(domain.back())));
+   }
+   ChiSq chi_sq(domain, range, &gauss);
+   assert(allocationsPerCall("ChiSq value", 
+                             [&]() {value += chi_sq.value();}) == 0);
+   assert(allocationsPerCall("ChiSq getFreeDerivs", 
+                             [&]() {chi_sq.getFreeDerivs(derivs);}) == 0);
+   chi_sq.getFreeParamValues(params);
+   assert(allocationsPerCall("ChiSq valueAndFreeDerivs", 
+                             [&]() {
+                                chi_sq.valueAndFreeDerivs(params, value, derivs);
+                             }) == 0);
+   assert(value != 0);
+
+   std::cout << "*** test_allocations: all tests passed ***\n" << std::endl;
+}
+
+unsigned long histogramTotal(const Instrumentation & instruments,
+                             Instrumentation::Phase phase) {
+   std::vector<unsigned long> counts(instruments.histogram(phase));
+   assert(counts.size() == Instrumentation::NBINS);
+   unsigned long total(0);
+   for (size_t k = 0; k < counts.size(); k++) {
+      total += counts[k];
+   }
+   return total;
+}
+
+void test_instrumentation() {
+   std::cout << "*** test_instrumentation ***" << std::endl;
+
+   RosenND rosen(4);
+   std::vector<Parameter> params;
+   rosen.getParams(params);
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setValue(1.2 + 0.1*i);
+      params[i].setBounds(-10., 10.);
+   }
+   rosen.setParams(params);
+
+// The decorator records each kind of call.
+   Instrumentation instruments;
+   InstrumentedStatistic timed(rosen, instruments);
+   std::vector<double> x, g;
+   rosen.getFreeParamValues(x);
+   assert(timed.value() == rosen.value());
+   timed.getFreeDerivs(g);
+   timed.setFreeParamValues(x);
+   double f;
+   timed.valueAndFreeDerivs(x, f, g);
+   assert(instruments.calls(Instrumentation::VALUE) == 1);
+   assert(instruments.calls(Instrumentation::DERIVS) == 1);
+   assert(instruments.calls(Instrumentation::VALUE_AND_DERIVS) == 1);
+   assert(instruments.calls(Instrumentation::SET_PARAMS) == 1);
+   assert(histogramTotal(instruments, Instrumentation::VALUE) == 1);
+   instruments.reset();
+   assert(instruments.calls(Instrumentation::VALUE) == 0);
+   assert(instruments.time(Instrumentation::VALUE) == 0);
+
+// Instrumented fits agree with plain ones.
+   std::vector<std::string> names;
+   names.push_back("LbfgsB");
+#ifndef DARWIN_F2C_FAILURE
+   names.push_back("Lbfgs");
+   names.push_back("Minuit");
+   names.push_back("Drmngb");
+#endif
+   OptimizerFactory & optFactory(OptimizerFactory::instance());
+   for (size_t i = 0; i < names.size(); i++) {
+      rosen.setParams(params);
+      Optimizer * my_opt(optFactory.create(names[i], rosen));
+      assert(my_opt->instrumentation() == 0);
+      my_opt->find_min(0, 1e-8);
+      std::vector<double> fitted;
+      rosen.getFreeParamValues(fitted);
+      delete my_opt;
+
+      rosen.setParams(params);
+      my_opt = optFactory.create(names[i], rosen);
+      my_opt->setInstrumentation(true);
+      assert(&my_opt->stat() == &rosen);
+      my_opt->find_min(0, 1e-8);
+      std::vector<double> timed_fitted;
+      rosen.getFreeParamValues(timed_fitted);
+      assert(timed_fitted == fitted);
+      my_opt->getUncertainty(true);
+
+      const Instrumentation & record(*my_opt->instrumentation());
+      assert(record.calls(Instrumentation::FIND_MIN) == 1);
+// Minuit also runs HESSE at the end of find_min.
+      assert(record.calls(Instrumentation::HESSIAN) >= 1);
+      assert(record.time(Instrumentation::FIND_MIN) > 0);
+      unsigned long nevals(record.calls(Instrumentation::VALUE) 
+                           + record.calls(Instrumentation::DERIVS)
+                           + record.calls(Instrumentation::VALUE_AND_DERIVS));
+      assert(nevals > 0);
+      for (int k = 0; k < Instrumentation::NPHASES; k++) {
+         Instrumentation::Phase phase(static_cast<Instrumentation::Phase>(k));
+         assert(histogramTotal(record, phase) == record.calls(phase));
+      }
+      std::cout << names[i] << ":" << std::endl;
+      record.report(std::cout);
+
+// With the cache enabled, only the misses reach the Statistic.
+      rosen.setParams(params);
+      my_opt->setEvaluationCache(4);
+      my_opt->resetInstrumentation();
+      my_opt->find_min(0, 1e-8);
+      nevals = record.calls(Instrumentation::VALUE) 
+         + record.calls(Instrumentation::DERIVS)
+         + record.calls(Instrumentation::VALUE_AND_DERIVS);
+      assert(nevals == my_opt->evaluationCache()->misses());
+
+      my_opt->setInstrumentation(false);
+      assert(my_opt->instrumentation() == 0);
+      assert(my_opt->evaluationCache() != 0);
+      assert(&my_opt->stat() == &rosen);
+      delete my_opt;
+   }
+
+   std::cout << "*** test_instrumentation: all tests passed ***\n" 
+             << std::endl;
+}
+
+void test_iterationTrace() {
+   std::cout << "*** test_iterationTrace ***" << std::endl;
+
+   RosenND rosen(4);
+   std::vector<Parameter> params;
+   rosen.getParams(params);
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setValue(1.2 + 0.1*i);
+      params[i].setBounds(-10., 10.);
+   }
+   rosen.setParams(params);
+
+   const std::string traceFile("iterationTrace.dat");
+   std::vector<std::string> names;
+   names.push_back("LbfgsB");
+#ifndef DARWIN_F2C_FAILURE
+   names.push_back("Lbfgs");
+   names.push_back("Drmngb");
+   names.push_back("Minuit");
+#endif
+   OptimizerFactory & optFactory(OptimizerFactory::instance());
+   for (size_t i = 0; i < names.size(); i++) {
+      rosen.setParams(params);
+      Optimizer * my_opt(optFactory.create(names[i], rosen));
+      my_opt->find_min(0, 1e-8);
+      std::vector<double> fitted;
+      rosen.getFreeParamValues(fitted);
+      delete my_opt;
+
+// Observing a fit does not change its result.
+      rosen.setParams(params);
+      my_opt = optFactory.create(names[i], rosen);
+      TraceWriter trace(traceFile, 4);
+      my_opt->setObserver(&trace);
+      my_opt->find_min(0, 1e-8);
+      std::vector<double> traced_fitted;
+      rosen.getFreeParamValues(traced_fitted);
+      assert(traced_fitted == fitted);
+      trace.close();
+      delete my_opt;
+
+      std::vector< std::vector<double> > records;
+      unsigned int npar;
+      TraceWriter::read(traceFile, records, npar);
+      std::remove(traceFile.c_str());
+      assert(npar == fitted.size());
+      assert(records.size() == trace.nrecords());
+      assert(records.size() >= 2);
+      for (size_t j = 0; j < records.size(); j++) {
+         assert(records[j].size() == TraceWriter::s_nfields + npar);
+         assert(records[j][0] == j);
+         assert(records[j][5] >= 0);
+         if (j == 0) {
+            assert(records[j][3] == 0);
+         } else {
+            assert(records[j][3] > 0);
+// Minuit only reports its starting and final points.
+            if (names[i] != "Minuit") {
+               assert(records[j][1] >= records[j-1][1]);
+            }
+         }
+      }
+      std::vector<double> start(records.front().begin() 
+                                + TraceWriter::s_nfields,
+                                records.front().end());
+      std::vector<double> last(records.back().begin() 
+                               + TraceWriter::s_nfields,
+                               records.back().end());
+      for (size_t k = 0; k < npar; k++) {
+         assert(start[k] == params[k].getValue());
+      }
+      assert(last == fitted);
+      std::cout << names[i] << ": " << records.size() 
+                << " iterations, final value " << records.back()[1]
+                << std::endl;
+   }
+
+   std::cout << "*** test_iterationTrace: all tests passed ***\n" 
+             << std::endl;
+}
+
+void test_NewMinuit_warmStart() {
+   std::cout << "*** test_NewMinuit_warmStart ***" << std::endl;
+
+   Rosen my_rosen;
+   std::vector<Parameter> params;
+   my_rosen.getParams(params);
+   params[0].setValue(0.5);
+   params[0].setBounds(-10., 10.);
+   params[1].setValue(0.5);
+   params[1].setBounds(-10., 10.);
+   my_rosen.setParams(params);
+
+   NewMinuit cold(my_rosen);
+   cold.find_min(0, 1e-5);
+   std::vector<double> fitted;
+   my_rosen.getFreeParamValues(fitted);
+
+// Refit from a nearby point, with and without the seed from the
+// previous fit.
+   std::vector<double> start(fitted);
+   start[0] *= 1.05;
+   start[1] *= 0.95;
+   my_rosen.setFreeParamValues(start);
+   cold.find_min(0, 1e-5);
+   unsigned int cold_nfcn(cold.userNFcn());
+   std::vector<double> cold_fitted;
+   my_rosen.getFreeParamValues(cold_fitted);
+
+   NewMinuit warm(cold);
+   warm.setWarmStart(true);
+   assert(warm.warmStart());
+   my_rosen.setFreeParamValues(start);
+   warm.find_min(0, 1e-5);
+   std::vector<double> warm_fitted;
+   my_rosen.getFreeParamValues(warm_fitted);
+   for (size_t i = 0; i < fitted.size(); i++) {
+      assert(std::fabs(warm_fitted[i] - cold_fitted[i]) < 1e-3);
+   }
+   std::cout << "function calls, cold: " << cold_nfcn 
+             << ", warm: " << warm.userNFcn() << std::endl;
+
+// Round trip through a state file.
+   const std::string stateFile("newMinuitState.txt");
+   warm.writeState(stateFile);
+   my_rosen.setFreeParamValues(start);
+   NewMinuit restarted(my_rosen);
+   restarted.setWarmStart(true);
+   restarted.readState(stateFile);
+   std::vector<double> restored;
+   my_rosen.getFreeParamValues(restored);
+   assert(restored == warm_fitted);
+   restarted.find_min(0, 1e-5);
+   my_rosen.getFreeParamValues(restored);
+   for (size_t i = 0; i < fitted.size(); i++) {
+      assert(std::fabs(restored[i] - warm_fitted[i]) < 1e-3);
+   }
+
+// The state only applies to a Statistic with the same free parameters.
+   RosenND rosen3(3);
+   NewMinuit other(rosen3);
+   try {
+      other.readState(stateFile);
+      assert(false);
+   } catch (Exception & eObj) {
+      std::cout << eObj.what() << std::endl;
+   }
+   std::remove(stateFile.c_str());
+
+   std::cout << "*** test_NewMinuit_warmStart: all tests passed ***\n" 
+             << std::endl;
+}
+
+void test_MinosAll() {
+   std::cout << "*** test_MinosAll ***" << std::endl;
+
+   RosenND rosen(4);
+   std::vector<Parameter> params;
+   rosen.getParams(params);
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setValue(0.5);
+      params[i].setBounds(-10., 10.);
+   }
+   rosen.setParams(params);
+
+   NewMinuit my_minuit(rosen);
+   my_minuit.find_min(0, 1e-5);
+   std::vector<double> fitted;
+   rosen.getFreeParamValues(fitted);
+
+   std::vector<double> errors(my_minuit.getUncertainty());
+   std::vector<unsigned int> pars;
+   std::vector< std::pair<double, double> > 
+      serial(my_minuit.MinosAll(pars, 2., false));
+   assert(serial.size() == fitted.size());
+   std::vector< std::pair<double, double> > 
+      concurrent(my_minuit.MinosAll(pars, 2.));
+   assert(concurrent.size() == fitted.size());
+   for (size_t i = 0; i < serial.size(); i++) {
+      assert(serial[i].first < 0 && serial[i].second > 0);
+      assert(std::fabs(concurrent[i].first - serial[i].first) 
+             < 1e-6*std::fabs(serial[i].first));
+      assert(std::fabs(concurrent[i].second - serial[i].second) 
+             < 1e-6*std::fabs(serial[i].second));
+      std::cout << i << "  " << fitted[i] << "  " << concurrent[i].first
+                << "  " << concurrent[i].second << std::endl;
+   }
+// The error definition is restored for the parabolic errors.
+   assert(my_minuit.getUncertainty() == errors);
+
+// A subset of the parameters, and the fitted values are kept.
+   pars.push_back(2);
+   pars.push_back(0);
+   concurrent = my_minuit.MinosAll(pars);
+   assert(concurrent.size() == 2);
+   double lower(my_minuit.minos_lower_error(2));
+   assert(std::fabs(concurrent[0].first - lower) < 1e-6*std::fabs(lower));
+   std::vector<double> current;
+   rosen.getFreeParamValues(current);
+   assert(current == fitted);
+
+   std::cout << "*** test_MinosAll: all tests passed ***\n" 
+             << std::endl;
+}
+
+void check_contours(Statistic & stat, Optimizer & my_opt, bool parallel) {
+   double maxValue(stat.value());
+   std::vector<double> fitted;
+   stat.getFreeParamValues(fitted);
+
+   std::vector< std::pair<unsigned int, unsigned int> > pairs;
+   pairs.push_back(std::make_pair(0, 1));
+   std::vector<double> levels;
+   levels.push_back(1.);
+   levels.push_back(4.);
+   std::vector<Contour> results(my_opt.contours(pairs, levels, 12, parallel));
+   assert(results.size() == 2);
+
+// With only two parameters, nothing is profiled out, so each point
+// is on the level itself.
+   std::vector<double> meanRadius;
+   for (size_t i = 0; i < results.size(); i++) {
+      assert(results[i].par1 == 0 && results[i].par2 == 1);
+      assert(results[i].level == levels[i]);
+      assert(results[i].points.size() >= 4);
+      double radius(0);
+      std::vector<double> point(2);
+      for (size_t k = 0; k < results[i].points.size(); k++) {
+         point[0] = results[i].points[k].first;
+         point[1] = results[i].points[k].second;
+         stat.setFreeParamValues(point);
+         double dlogL(maxValue - stat.value());
+         assert(std::fabs(dlogL - levels[i]/2.) < 0.1*levels[i]/2.);
+         radius += std::sqrt(std::pow(point[0] - fitted[0], 2)
+                             + std::pow(point[1] - fitted[1], 2));
+      }
+      meanRadius.push_back(radius/results[i].points.size());
+   }
+   assert(meanRadius[1] > meanRadius[0]);
+   stat.setFreeParamValues(fitted);
+}
+
+void test_contours() {
+   std::cout << "*** test_contours ***" << std::endl;
+
+// MNCONT fails to find the first points for the default, steeper
+// Rosenbrock valley.
+   Rosen my_rosen(0.1);
+   std::vector<Parameter> params;
+   my_rosen.getParams(params);
+   params[0].setValue(0.5);
+   params[0].setBounds(-10., 10.);
+   params[1].setValue(0.5);
+   params[1].setBounds(-10., 10.);
+   my_rosen.setParams(params);
+
+   NewMinuit new_minuit(my_rosen);
+   new_minuit.find_min(0, 1e-8);
+   check_contours(my_rosen, new_minuit, false);
+   check_contours(my_rosen, new_minuit, true);
+
+#ifndef DARWIN_F2C_FAILURE
+   my_rosen.setParams(params);
+   Minuit my_minuit(my_rosen);
+   my_minuit.find_min(0, 1e-8);
+   check_contours(my_rosen, my_minuit, false);
+#endif
+
+   std::cout << "*** test_contours: all tests passed ***\n" 
+             << std::endl;
+}
+
+void test_multiStart() {
+   std::cout << "*** test_multiStart ***" << std::endl;
+
+// The 4D Rosenbrock function has a local maximum near
+// (-0.78, 0.61, 0.38, 0.15) as well as the global one at (1, 1, 1, 1).
+// Powell ignores bounds, so the parameters are left unbounded and
+// sampled within a unit distance of the starting values.
+   RosenND rosen(4);
+   std::vector<Parameter> params;
+   rosen.getParams(params);
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setValue(i == 0 ? -1. : 1.);
+   }
+   rosen.setParams(params);
+
+   Powell single(rosen);
+   single.find_min(0, 1e-8);
+   double singleValue(rosen.value());
+
+   rosen.setParams(params);
+   MultiStart multi(rosen, "Powell");
+   multi.setNumStarts(24);
+   multi.setThreads(4);
+   multi.setClusterTolerance(1e-2);
+   multi.find_min(0, 1e-8);
+
+   const std::vector<MultiStart::Minimum> & minima(multi.minima());
+   assert(!minima.empty());
+   assert(minima.front().value >= singleValue);
+   assert(std::fabs(rosen.value() - minima.front().value) < 1e-10);
+   assert(std::fabs(minima.front().value) < 1e-4);
+   unsigned int nstarts(0);
+   for (size_t k = 0; k < minima.size(); k++) {
+      if (k > 0) {
+         assert(minima[k].value <= minima[k - 1].value);
+      }
+      nstarts += minima[k].nstarts;
+   }
+   assert(nstarts + multi.numCancelled() + multi.numFailed() == 24);
+   assert(minima.size() > 1 || singleValue > -1e-4);
+
+// Runs with the same seed give the same maxima.
+   rosen.setParams(params);
+   MultiStart again(rosen, "Powell");
+   again.setNumStarts(24);
+   again.setClusterTolerance(1e-2);
+   again.setCancellation(0);
+   again.find_min(0, 1e-8);
+   assert(again.numCancelled() == 0);
+   assert(std::fabs(again.minima().front().value
+                    - minima.front().value) < 1e-8);
+
+// Bounds of (0, 0) mean unbounded, so they are sampled the same way.
+   std::vector<Parameter> zeroBounded(params);
+   for (size_t i = 0; i < zeroBounded.size(); i++) {
+      zeroBounded[i].setBounds(0, 0);
+   }
+   rosen.setParams(zeroBounded);
+   MultiStart zeroBounds(rosen, "Powell");
+   zeroBounds.setNumStarts(24);
+   zeroBounds.setClusterTolerance(1e-2);
+   zeroBounds.setCancellation(0);
+   zeroBounds.find_min(0, 1e-8);
+   assert(zeroBounds.minima().size() == again.minima().size());
+   assert(std::fabs(zeroBounds.minima().front().value
+                    - again.minima().front().value) < 1e-8);
+
+// Starts heading for the lower maximum are abandoned once the
+// global one has been found.
+   rosen.setParams(params);
+   MultiStart cancelling(rosen, "Powell");
+   cancelling.setNumStarts(24);
+   cancelling.setThreads(1);
+   cancelling.setClusterTolerance(1e-2);
+   cancelling.setCancellation(1., 3);
+   cancelling.find_min(0, 1e-8);
+   assert(cancelling.numCancelled() > 0);
+   assert(std::fabs(cancelling.minima().front().value) < 1e-4);
+
+// The factory's Lbfgs is the C++ L-BFGS-B, so its starts also run
+// concurrently.
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setBounds(-2., 2.);
+   }
+   rosen.setParams(params);
+   Optimizer * factoryMulti = 
+      OptimizerFactory::instance().create("MultiStart:Lbfgs", rosen);
+   assert(dynamic_cast<MultiStart *>(factoryMulti) != 0);
+   assert(dynamic_cast<MultiStart *>(factoryMulti)->localOptimizer()
+          == "Lbfgs");
+   dynamic_cast<MultiStart *>(factoryMulti)->setNumStarts(8);
+   factoryMulti->find_min(0, 1e-8);
+   assert(rosen.value() >= singleValue - 1e-4);
+   delete factoryMulti;
+
+   std::cout << "*** test_multiStart: all tests passed ***\n" 
+             << std::endl;
+}
+
+void test_simplex() {
+   std::cout << "*** test_simplex ***" << std::endl;
+
+// The upper bound on x excludes the maximum at (1, 1), so the fit
+// should end on the bound at (0.5, 0.25).
+   Rosen my_rosen(1.);
+   std::vector<Parameter> params;
+   my_rosen.getParams(params);
+   params[0].setValue(-1.);
+   params[0].setBounds(-2., 0.5);
+   params[1].setValue(2.);
+   params[1].setBounds(-3., std::numeric_limits<double>::infinity());
+   my_rosen.setParams(params);
+
+   Optimizer * my_opt = 
+      OptimizerFactory::instance().create("Simplex", my_rosen);
+   Simplex * simplex = dynamic_cast<Simplex *>(my_opt);
+   assert(simplex != 0);
+   simplex->setMaxEval(2000);
+   int retCode = simplex->find_min(0, 1e-12, ABSOLUTE);
+   assert(retCode == Simplex::SIMPLEX_NORMAL);
+   assert(simplex->numEvals() > 0 && simplex->numEvals() <= 2000);
+   std::vector<double> x;
+   my_rosen.getFreeParamValues(x);
+   assert(x[0] <= 0.5 && std::fabs(x[0] - 0.5) < 1e-4);
+   assert(std::fabs(x[1] - 0.25) < 1e-3);
+
+// The same fit with concurrent evaluations, RELATIVE tolerance and
+// a lower bound on y that excludes the constrained maximum.
+   my_rosen.setParams(params);
+   my_rosen.getParams(params);
+   params[1].setBounds(0.5, std::numeric_limits<double>::infinity());
+   my_rosen.setParams(params);
+   simplex->setThreads(4);
+   simplex->find_min(0, 1e-10, RELATIVE);
+   my_rosen.getFreeParamValues(x);
+   assert(x[1] >= 0.5 && std::fabs(x[1] - 0.5) < 1e-3);
+   assert(x[0] <= 0.5 && std::fabs(x[0] - 0.5) < 1e-3);
+
+// Bounds of (0, 0) leave the parameters unbounded.
+   std::vector<Parameter> unbounded(params);
+   for (size_t i = 0; i < unbounded.size(); i++) {
+      unbounded[i].setBounds(0, 0);
+   }
+   my_rosen.setParams(unbounded);
+   simplex->find_min(0, 1e-12, ABSOLUTE);
+   my_rosen.getFreeParamValues(x);
+   assert(std::fabs(x[0] - 1.) < 1e-3);
+   assert(std::fabs(x[1] - 1.) < 1e-3);
+
+// Running out of evaluations leaves the best point found.
+   my_rosen.setParams(params);
+   double startValue = my_rosen.value();
+   simplex->setThreads(1);
+   simplex->setMaxEval(10);
+   retCode = simplex->find_min(0, 1e-12);
+   assert(retCode == Simplex::SIMPLEX_TOOMANY);
+   assert(my_rosen.value() >= startValue);
+   delete my_opt;
+
+   std::cout << "*** test_simplex: all tests passed ***\n" 
+             << std::endl;
+}
+
+void test_parallelPowell() {
+   std::cout << "*** test_parallelPowell ***" << std::endl;
+
+   RosenND rosen(6, 10.);
+   std::vector<Parameter> params;
+   rosen.getParams(params);
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setValue(1.5);
+   }
+   rosen.setParams(params);
+
+   Powell serial(rosen);
+   serial.find_min(0, 1e-10);
+   double serialValue(rosen.value());
+
+   rosen.setParams(params);
+   Powell parallel(rosen);
+   parallel.setThreads(4);
+   assert(parallel.threads() == 4);
+   parallel.find_min(0, 1e-10);
+   std::vector<double> x;
+   rosen.getFreeParamValues(x);
+   for (size_t i = 0; i < x.size(); i++) {
+      assert(std::fabs(x[i] - 1.) < 1e-3);
+   }
+   assert(std::fabs(rosen.value() - serialValue) < 1e-6);
+
+   std::cout << "*** test_parallelPowell: all tests passed ***\n" 
+             << std::endl;
+}
+
+void test_lbfgsBounds() {
+   std::cout << "*** test_lbfgsBounds ***" << std::endl;
+
+// Unbounded parameters
+   RosenND rosen(4, 10.);
+   std::vector<Parameter> params;
+   rosen.getParams(params);
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setValue(1.5);
+   }
+   rosen.setParams(params);
+   Lbfgs lbfgs(rosen);
+   lbfgs.find_min(0, 1e-12);
+   assert(lbfgs.getRetCode() == Lbfgs::LBFGS_NORMAL);
+   std::vector<double> x;
+   rosen.getFreeParamValues(x);
+   for (size_t i = 0; i < x.size(); i++) {
+      assert(std::fabs(x[i] - 1.) < 1e-3);
+   }
+
+// A lower bound only, and an upper bound only, that each exclude
+// the unconstrained maximum.  The same Lbfgs reuses its workspace.
+   double inf(std::numeric_limits<double>::infinity());
+   params[0].setBounds(1.2, inf);
+   rosen.setParams(params);
+   lbfgs.find_min(0, 1e-12);
+   rosen.getFreeParamValues(x);
+   assert(std::fabs(x[0] - 1.2) < 1e-8);
+
+   params[0].setBounds(-inf, inf);
+   params[0].setValue(0.5);
+   params[0].setBounds(-inf, 0.8);
+   rosen.setParams(params);
+   lbfgs.setMaxVarMetCorr(10);
+   assert(lbfgs.getMaxVarMetCorr() == 10);
+   lbfgs.find_min(0, 1e-12);
+   rosen.getFreeParamValues(x);
+   assert(std::fabs(x[0] - 0.8) < 1e-8);
+
+// Bounds of (0, 0) leave the parameter unbounded.
+   params[0].setBounds(0, 0);
+   params[0].setValue(1.5);
+   rosen.setParams(params);
+   lbfgs.find_min(0, 1e-12);
+   assert(lbfgs.getRetCode() == Lbfgs::LBFGS_NORMAL);
+   rosen.getFreeParamValues(x);
+   assert(std::fabs(x[0] - 1.) < 1e-3);
+
+   std::cout << "*** test_lbfgsBounds: all tests passed ***\n" 
+             << std::endl;
+}
+
+void test_lbfgsB() {
+   std::cout << "*** test_lbfgsB ***" << std::endl;
+
+// Unbounded parameters
+   RosenND rosen(4, 10.);
+   std::vector<Parameter> params;
+   rosen.getParams(params);
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setValue(1.5);
+   }
+   rosen.setParams(params);
+   LbfgsB lbfgs(rosen);
+   int retCode = lbfgs.find_min(0, 1e-12);
+   assert(retCode == LbfgsB::LBFGS_NORMAL);
+   std::vector<double> x;
+   rosen.getFreeParamValues(x);
+   for (size_t i = 0; i < x.size(); i++) {
+      assert(std::fabs(x[i] - 1.) < 1e-3);
+   }
+   assert(lbfgs.iterations() > 0);
+   assert(lbfgs.numEvals() >= lbfgs.iterations());
+   assert(lbfgs.numFree() == 4);
+   assert(lbfgs.numCorrections() > 0 
+          && lbfgs.numCorrections() <= lbfgs.getMaxVarMetCorr());
+   std::vector<double> s, y;
+   for (int i = 0; i < lbfgs.numCorrections(); i++) {
+      lbfgs.getCorrection(i, s, y);
+      double sy(0);
+      for (size_t j = 0; j < s.size(); j++) {
+         sy += s[j]*y[j];
+      }
+      assert(sy > 0);
+   }
+
+// A lower bound only, and an upper bound only, that each exclude
+// the unconstrained maximum.
+   double inf(std::numeric_limits<double>::infinity());
+   params[0].setBounds(1.2, inf);
+   rosen.setParams(params);
+   lbfgs.find_min(0, 1e-12);
+   rosen.getFreeParamValues(x);
+   assert(std::fabs(x[0] - 1.2) < 1e-8);
+
+   params[0].setBounds(-inf, inf);
+   params[0].setValue(0.5);
+   params[0].setBounds(-inf, 0.8);
+   rosen.setParams(params);
+   lbfgs.setMaxVarMetCorr(10);
+   lbfgs.find_min(0, 1e-12);
+   rosen.getFreeParamValues(x);
+   assert(std::fabs(x[0] - 0.8) < 1e-8);
+   assert(lbfgs.numFree() == 3);
+
+// Bounds of (0, 0) leave the parameter unbounded.
+   params[0].setBounds(0, 0);
+   params[0].setValue(1.5);
+   rosen.setParams(params);
+   lbfgs.find_min(0, 1e-12);
+   assert(lbfgs.getRetCode() == LbfgsB::LBFGS_NORMAL);
+   rosen.getFreeParamValues(x);
+   assert(std::fabs(x[0] - 1.) < 1e-3);
+   assert(lbfgs.numFree() == 4);
+
+// A larger boxed problem from the customary starting point, through
+// the factory.
+   RosenND rosen100(100);
+   rosen100.getParams(params);
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setValue(i % 2 ? 1. : -1.2);
+      params[i].setBounds(-10., 10.);
+   }
+   rosen100.setParams(params);
+   Optimizer * my_opt(OptimizerFactory::instance().create("LbfgsB",
+                                                          rosen100));
+   my_opt->setMaxEval(100000);
+   my_opt->find_min(0, 1e-12);
+   assert(my_opt->getRetCode() == LbfgsB::LBFGS_NORMAL);
+   assert(rosen100.value() > -1e-6);
+   delete my_opt;
+
+// "Lbfgs" from the factory is also this implementation.
+   my_opt = OptimizerFactory::instance().create("Lbfgs", rosen100);
+   assert(dynamic_cast<LbfgsB *>(my_opt) != 0);
+   delete my_opt;
+
+   std::cout << "*** test_lbfgsB: all tests passed ***\n" 
+             << std::endl;
+}
+
+namespace {
+   class DenseRosenND : public RosenND {
+   public:
+      DenseRosenND(int dim) : RosenND(dim) {}
+      virtual bool 
+      getFreeHessianPattern(std::vector< std::vector<size_t> > &) const {
+         return false;
+      }
+   };
+}
+
+void test_sparseHessian() {
+   std::cout << "*** test_sparseHessian ***" << std::endl;
+
+// A tridiagonal matrix with its rows and columns shuffled.
+   size_t npars(12);
+   std::vector<size_t> shuffled(npars);
+   for (size_t i = 0; i < npars; i++) {
+      shuffled[i] = (5*i + 3) % npars;
+   }
+   std::vector< std::vector<double> > matrix(npars, 
+                                             std::vector<double>(npars, 0));
+   std::vector< std::vector<size_t> > pattern(npars);
+   for (size_t i = 0; i < npars; i++) {
+      matrix[shuffled[i]][shuffled[i]] = 4. + 0.1*i;
+      if (i + 1 < npars) {
+         matrix[shuffled[i]][shuffled[i+1]] = -1. - 0.05*i;
+         matrix[shuffled[i+1]][shuffled[i]] = -1. - 0.05*i;
+         pattern[shuffled[i]].push_back(shuffled[i+1]);
+      }
+   }
+   SparseHessian hess(pattern);
+   assert(hess.size() == npars);
+   assert(hess.nonZeros() == 3*npars - 2);
+   assert(hess.numGroups() <= 5);
+
+// Fill it in from the products with the grouped steps.
+   std::vector<double> steps(npars);
+   for (size_t j = 0; j < npars; j++) {
+      steps[j] = 0.5 + 0.1*j;
+   }
+   for (size_t igroup = 0; igroup < hess.numGroups(); igroup++) {
+      const std::vector<size_t> & columns(hess.group(igroup));
+      std::vector<double> diff(npars, 0);
+      for (size_t k = 0; k < columns.size(); k++) {
+         for (size_t i = 0; i < npars; i++) {
+            diff[i] += matrix[i][columns[k]]*steps[columns[k]];
+         }
+      }
+      hess.setGroup(igroup, diff, steps);
+   }
+   for (size_t i = 0; i < npars; i++) {
+      for (size_t j = 0; j < npars; j++) {
+         assert(std::fabs(hess(i, j) - matrix[i][j]) < 1e-12);
+      }
+   }
+
+// The reordering recovers the band.
+   hess.choleskyDecompose();
+   assert(hess.envelopeSize() == 2*npars - 1);
+
+   std::vector<double> b(npars), x;
+   for (size_t i = 0; i < npars; i++) {
+      b[i] = 1. + i;
+   }
+   x = b;
+   hess.solve(x);
+   for (size_t i = 0; i < npars; i++) {
+      double sum(0);
+      for (size_t j = 0; j < npars; j++) {
+         sum += matrix[i][j]*x[j];
+      }
+      assert(std::fabs(sum - b[i]) < 1e-10);
+   }
+
+// Compare the diagonal of the inverse with Gauss-Jordan elimination.
+   std::vector< std::vector<double> > inverse(npars, 
+                                              std::vector<double>(npars, 0));
+   std::vector< std::vector<double> > work(matrix);
+   for (size_t i = 0; i < npars; i++) {
+      inverse[i][i] = 1;
+   }
+   for (size_t k = 0; k < npars; k++) {
+      double pivot(work[k][k]);
+      for (size_t j = 0; j < npars; j++) {
+         work[k][j] /= pivot;
+         inverse[k][j] /= pivot;
+      }
+      for (size_t i = 0; i < npars; i++) {
+         if (i != k) {
+            double factor(work[i][k]);
+            for (size_t j = 0; j < npars; j++) {
+               work[i][j] -= factor*work[k][j];
+               inverse[i][j] -= factor*inverse[k][j];
+            }
+         }
+      }
+   }
+   std::vector<double> diag;
+   hess.inverseDiagonal(diag);
+   for (size_t i = 0; i < npars; i++) {
+      assert(std::fabs(diag[i] - inverse[i][i]) < 1e-12);
+   }
+
+// An indefinite matrix cannot be factored.
+   std::vector<double> flipped(npars, 0);
+   flipped[0] = -1;
+   for (size_t igroup = 0; igroup < hess.numGroups(); igroup++) {
+      if (hess.group(igroup)[0] == 0) {
+         hess.setGroup(igroup, flipped, steps);
+      }
+   }
+   try {
+      hess.choleskyDecompose();
+      assert(false);
+   } catch (optimizers::Exception &) {
+   }
+
+// A parameter coupled to all of the others needs a group per column.
+   std::vector< std::vector<size_t> > star(npars);
+   for (size_t j = 1; j < npars; j++) {
+      star[0].push_back(j);
+   }
+   assert(SparseHessian(star).numGroups() == npars);
+
+// RosenND has a tridiagonal Hessian, so three gradient evaluations
+// fill it at any size.
+   RosenND rosen(50);
+   std::vector<Parameter> params;
+   rosen.getParams(params);
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setValue(1.);
+   }
+   rosen.setParams(params);
+   rosen.getFreeHessianPattern(pattern);
+   assert(SparseHessian(pattern).numGroups() == 3);
+
+   LbfgsB opt(rosen);
+   std::vector<double> errors(opt.getUncertainty());
+   assert(errors.size() == params.size());
+   opt.setHessianThreads(3);
+   assert(opt.getUncertainty() == errors);
+
+// Fixing a parameter splits the pattern.
+   params[20].setFree(false);
+   rosen.setParams(params);
+   rosen.getFreeHessianPattern(pattern);
+   assert(pattern.size() == params.size() - 1);
+   assert(pattern[19].size() == 2 && pattern[20].size() == 2);
+   params[20].setFree(true);
+   rosen.setParams(params);
+
+// The dense Hessian gives the same errors.
+   DenseRosenND dense(50);
+   dense.setParams(params);
+   LbfgsB denseOpt(dense);
+   std::vector<double> denseErrors(denseOpt.getUncertainty());
+   for (size_t i = 0; i < errors.size(); i++) {
+      assert(std::fabs(errors[i]/denseErrors[i] - 1.) < 1e-4);
+   }
+
+   std::cout << "*** test_sparseHessian: all tests passed ***\n" 
+             << std::endl;
+}
+
+void test_covarianceMatrix() {
+   std::cout << "*** test_covarianceMatrix ***" << std::endl;
+
+// Enough parameters for several blocks of the dense factorization.
+   size_t npars(150);
+   DenseRosenND dense(npars);
+   std::vector<Parameter> params;
+   dense.getParams(params);
+   for (size_t i = 0; i < params.size(); i++) {
+      params[i].setValue(1.);
+   }
+   dense.setParams(params);
+   LbfgsB denseOpt(dense);
+   try {
+      denseOpt.covarianceMatrix();
+      assert(false);
+   } catch (optimizers::Exception &) {
+   }
+   std::vector<double> errors(denseOpt.getUncertainty());
+   std::vector< std::vector<double> > cov(denseOpt.covarianceMatrix());
+   assert(cov.size() == npars);
+   for (size_t i = 0; i < npars; i++) {
+      assert(cov[i].size() == npars);
+      assert(std::sqrt(cov[i][i]) == errors[i]);
+      for (size_t j = 0; j < i; j++) {
+         assert(cov[i][j] == cov[j][i]);
+      }
+   }
+
+// The covariance from the sparse factor agrees.
+   RosenND rosen(npars);
+   rosen.setParams(params);
+   LbfgsB opt(rosen);
+   opt.getUncertainty();
+   std::vector< std::vector<double> > sparseCov(opt.covarianceMatrix());
+   assert(sparseCov.size() == npars);
+   for (size_t i = 0; i < npars; i++) {
+      for (size_t j = 0; j < npars; j++) {
+         double scale(std::sqrt(cov[i][i]*cov[j][j]));
+         assert(std::fabs(sparseCov[i][j] - cov[i][j]) < 1e-4*scale);
+      }
+   }
+
+// Contiguous storage.
+   CovarianceMatrix matrix(opt.covariance());
+   assert(matrix.size() == npars);
+   assert(matrix.rows() == sparseCov);
+   for (size_t i = 0; i < npars; i++) {
+      assert(matrix.row(i) == matrix.data() + i*npars);
+      assert(std::fabs(matrix.correlation(i, i) - 1.) < 1e-12);
+   }
+   assert(CovarianceMatrix(cov).rows() == cov);
+   try {
+      std::vector< std::vector<double> > ragged(2, std::vector<double>(3));
+      CovarianceMatrix bad(ragged);
+      assert(false);
+   } catch (optimizers::Exception &) {
+   }
+   double packedValues[] = {1., 2., 3., 4., 5., 6.};
+   std::vector<double> packed(packedValues, packedValues + 6);
+   matrix.setPacked(3, packed);
+   assert(matrix.size() == 3);
+   assert(matrix(0, 0) == 1. && matrix(0, 1) == 2. && matrix(1, 1) == 3.);
+   assert(matrix(0, 2) == 4. && matrix(1, 2) == 5. && matrix(2, 2) == 6.);
+   assert(matrix(2, 0) == 4. && matrix(2, 1) == 5.);
+   assert(matrix.uncertainty(2) == std::sqrt(6.));
+
+#ifndef DARWIN_F2C_FAILURE
+// The PORT optimizers keep the covariance from their own fit, without
+// another Hessian.
+   const char * portOptimizers[] = {"Drmngb", "Drmnfb", "ModNewton"};
+   for (size_t k = 0; k < 3; k++) {
+      RosenND rosen4(4);
+      setRosenNDStart(rosen4, 0.1);
+      Optimizer * portOpt(0);
+      if (k < 2) {
+         portOpt = OptimizerFactory::instance().create(portOptimizers[k],
+                                                       rosen4);
+      } else {
+         portOpt = new ModNewton(rosen4);
+      }
+      try {
+         portOpt->covariance();
+         assert(false);
+      } catch (optimizers::Exception &) {
+      }
+      portOpt->find_min(0, 1e-8);
+      CovarianceMatrix portCov(portOpt->covariance());
+      assert(portCov.size() == 4);
+      assert(portOpt->covarianceMatrix() == portCov.rows());
+// The fit's Hessian is close to the finite-difference one.
+      std::vector<double> errors4(portOpt->getUncertainty());
+      for (size_t i = 0; i < 4; i++) {
+         assert(std::fabs(portCov.uncertainty(i)/errors4[i] - 1.) < 0.1);
+         for (size_t j = 0; j < i; j++) {
+            assert(portCov(i, j) == portCov(j, i));
+         }
+      }
+      delete portOpt;
+   }
+#endif
+
+   std::cout << "*** test_covarianceMatrix: all tests passed ***\n" 
+             << std::endl;
+}